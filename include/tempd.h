@@ -66,6 +66,86 @@
  *                                  (default: /var/log/openvswitch/ops-tempd.log)
  *          --syslog-target=HOST:PORT  also send syslog msgs to HOST:PORT via UDP
  *
+ *     Emergency confirmation options:
+ *          --emergency-samples=N      samples taken to confirm an emergency
+ *          --emergency-votes=M        samples that must agree to shut down
+ *                                     (by default, no more than N)
+ *          --emergency-interval=MSEC  spacing between samples
+ *          --emergency-correlate      require another sensor in the subsystem
+ *                                     to be at or above critical
+ *
+ *     Emergency watchdog options:
+ *          --watchdog                 read shutdown-capable sensors in a
+ *                                     separate thread
+ *          --watchdog-period=MSEC     watchdog read period
+ *          --watchdog-priority=N      watchdog SCHED_FIFO priority, 0 for none
+ *          --watchdog-cpu=N           pin the watchdog thread to cpu N
+ *
+ *     Bus arbitration options:
+ *          --bus-lock-dir=DIR         flock DIR/BUS.lock around each device
+ *                                     access, shared with other daemons
+ *          --i2c-dev=BUS=DEVICE       access the devices on BUS through
+ *                                     i2c-dev DEVICE (/dev/i2c-N), batching
+ *                                     reads with I2C_RDWR (may be repeated)
+ *
+ *     LM75 options:
+ *          --lm75-resolution=BITS     set parts with selectable resolution
+ *                                     to 9 to 12 bits
+ *          --lm75-oneshot             keep parts that support it in
+ *                                     shutdown, converting once per read
+ *
+ *     Staleness options:
+ *          --stale-periods=N          polling periods without a good reading
+ *                                     before a sensor is reported stale
+ *                                     (default: 3)
+ *
+ *     Filter options:
+ *          --filter=SPEC              noise filter for all sensors: none,
+ *                                     median3, median5, ema:PERCENT or
+ *                                     slew:MILIDEGREES (default: none)
+ *
+ *     Trend options:
+ *          --trend-window=N           readings in the trend fit (default: 12)
+ *          --trend-lead=SEC           raise the fan demand if the next fan
+ *                                     threshold is predicted within SEC
+ *                                     (default: 0, disabled)
+ *
+ *     Rolling statistics options:
+ *          --windows=LIST             windows to keep the minimum, maximum
+ *                                     and average temperature over, as
+ *                                     lengths with an s, m, h or d suffix,
+ *                                     or none (default: 5m,1h,24h)
+ *
+ *     Simulation options:
+ *          --sim=FILE                 simulate the sensors described in
+ *                                     scenario FILE, instead of using the
+ *                                     h/w description files and i2c
+ *
+ *     Virtual sensor options:
+ *          --virtual=FILE             add the virtual sensors defined in FILE
+ *
+ *     Record and replay options:
+ *          --record=FILE              append every raw sensor sample to FILE
+ *          --record-size=MB           size at which FILE is rotated to
+ *                                     FILE.1 (default: 16)
+ *          --replay=FILE              replay the samples recorded in FILE,
+ *                                     then exit
+ *          --replay-output=FILE       write the replay transcript to FILE
+ *                                     (default: stdout)
+ *
+ *     Metrics options:
+ *          --metrics=PATH             serve OpenMetrics text on unix
+ *                                     socket PATH
+ *
+ *     Standby options:
+ *          --mirror=PATH              without the lock, stand by mirroring
+ *                                     the active process on unix socket
+ *                                     PATH; with it, serve PATH
+ *
+ *     Sharding options:
+ *          --subsystems=GLOB[,GLOB...]  only handle the subsystems matching
+ *                                     a GLOB, with a lock of their own
+ *
  *     Other options:
  *          --unixctl=SOCKET        override default control socket name
  *          -h, --help              display this help message
@@ -75,6 +155,11 @@
  * ovs-apptcl options:
  *
  *      Support dump: ovs-appctl -t ops-tempd ops-tempd/dump
+ *                    [--format=text|json] [--subsystem=GLOB]
+ *                    [--sensor=GLOB] [--status=STATUS]
+ *      Set filter: ovs-appctl -t ops-tempd ops-tempd/filter SENSOR|all SPEC
+ *      Statistics: ovs-appctl -t ops-tempd ops-tempd/stats [reset|json]
+ *      Memory usage: ovs-appctl -t ops-tempd ops-tempd/memory [json]
  *
  *
  * OVSDB elements usage
@@ -93,6 +178,14 @@
  *              Temp_sensor:temperature
  *              Temp_sensor:fan_state
  *              Temp_sensor:status
+ *              Temp_sensor:external_ids:trend_slope
+ *              Temp_sensor:external_ids:trend_next_alarm
+ *              Temp_sensor:external_ids:trend_time_to_alarm
+ *              Temp_sensor:external_ids:min_<window>
+ *              Temp_sensor:external_ids:max_<window>
+ *              Temp_sensor:external_ids:avg_<window>
+ *              Temp_sensor:external_ids:seq
+ *              Temp_sensor:external_ids:stale
  *              daemon["ops-tempd"]:cur_hw
  *              subsystem:temp_sensors
  *
@@ -114,16 +207,41 @@
 #ifndef _TEMPD_H_
 #define _TEMPD_H_
 
-VLOG_DEFINE_THIS_MODULE(ops_tempd);
+#include <stdbool.h>
+#include <stdint.h>
 
-COVERAGE_DEFINE(tempd_reconfigure);
+#include "config-yaml.h"
+#include "heap.h"
+#include "shash.h"
+#include "tempd_breaker.h"
+#include "tempd_filter.h"
+#include "tempd_lm75.h"
+#include "tempd_trend.h"
+#include "tempd_window.h"
 
 #define NAME_IN_DAEMON_TABLE "ops-tempd"
 
 #define POLLING_PERIOD  5
 #define MSEC_PER_SEC    1000
 
+// each sensor is read once per polling period, at its own phase in the
+// period. Sensors due within SCHEDULE_SLACK_MS of each other are read in
+// the same pass.
+#define SCHEDULE_SLACK_MS   50
+
+// the rows of the sensors read are written at most once in this long,
+// unless a status or fan demand changes
+#define PUBLISH_COALESCE_MS 1000
+
+// polling periods without a good reading before a sensor is reported stale
+#define STALE_PERIODS       3
+
 #define DEFAULT_TEMP    35
+
+// trend values are rounded before they are published, to avoid writing
+// insignificant changes: milidegrees per minute, and seconds
+#define TREND_SLOPE_QUANTUM     100
+#define TREND_TIME_QUANTUM      10
 #define MILI_DEGREES    1000
 #define MILI_DEGREES_FLOAT  1000.0
 
@@ -147,53 +265,105 @@ enum fanspeed {
     SENSOR_FAN_MAX = 3
 };
 
-// must match sensorstatus enum
-const char *sensor_status[] =
-{
-    "uninitialized",
-    "normal",
-    "min",
-    "max",
-    "low_critical",
-    "critical",
-    "fault",
-    "emergency"
-};
+// status and fan speed strings (tempd_sensor.c)
+extern const char *sensor_status[];     // must match sensorstatus enum
+extern const char *fan_speed[];         // must match fanspeed enum
 
-// must match fanspeed enum
-const char *fan_speed[] = {
-    "normal",
-    "medium",
-    "fast",
-    "max"
-};
+struct ovsrec_temp_sensor;
+struct tempd_arena;
+struct tempd_buslock;
+struct tempd_i2cdev;
+struct virtual_sensor;
+struct virtual_users;
 
 // structure to represent subsystem
 struct locl_subsystem {
+    struct tempd_arena *arena;  // holds the subsystem and its sensors
     char *name;             // name of subsystem
     bool marked;            // flag for calculating "in use" status
     bool valid;            // flag to know if this subsystem is valid
+    bool rows_pending;      // Temp_sensor rows not created yet
+    bool claimed;           // ours to read and publish: we hold its claim
+                            // and the ops-tempd lock (see tempd_claim.h)
     struct locl_subsystem *parent_subsystem;    // pointer to parent (if any)
     struct shash subsystem_sensors;     // sensors in this subsystem
     bool emergency_shutdown;            // flag - shutdown if emergency overtemp
 };
 
+// structure to represent an i2c bus shared by sensors
+struct locl_bus {
+    char *name;             // bus name (from the device description)
+    int n_sensors;          // sensors using this bus
+    struct tempd_breaker breaker;       // fault circuit breaker for the bus
+    struct tempd_buslock *lock;         // advisory lock shared with other
+                                        // daemons (NULL if not used)
+    struct tempd_i2cdev *i2cdev;        // native access (--i2c-dev), or
+                                        // NULL to go through config-yaml
+};
+
 struct locl_sensor {
     char *name;             // name of sensor ([subsystem name]-[sensor number])
     struct locl_subsystem *subsystem;   // containing subsystem
     const YamlSensor *yaml_sensor;      // sensor information
+    const YamlDevice *yaml_device;      // device information (may be NULL)
+    struct locl_bus *bus;               // bus the device is on (may be NULL)
+    struct tempd_breaker breaker;       // fault circuit breaker
     enum sensorstatus status;           // current status result
     enum fanspeed fan_speed;            // current speed result
-    int temp;               // milidegrees (C)
+    enum fanspeed fan_demand;           // published speed (may lead fan_speed)
+    struct tempd_trend trend;           // temperature trend
+    struct tempd_window *windows;       // rolling statistics (--windows)
+    int n_windows;
+    int temp;               // milidegrees (C), filtered
+    int raw_temp;           // milidegrees (C), last raw reading
+    struct tempd_filter filter;         // noise filter for readings
     int min;                // milidegrees (C)
     int max;                // milidegrees (C)
     int fault_count;
+    long long sample_time;  // time_msec() of the last good reading, 0 if none
+    bool stale;             // no good reading for --stale-periods
+    long long publish_seq;  // bumped whenever its row is written
+    const struct ovsrec_temp_sensor *row;   // its row (or NULL), as of the
+                                            // last database change
+    bool dirty;             // read since its row was last published
     int test_temp;          // -1 or milidegrees (C)
+    bool started;           // set up, in the read schedule and (if it can
+                            // shut down) owned by the watchdog: only while
+                            // holding the lock, never in a standby
+    struct heap_node schedule_node;     // place in the read schedule
+    long long next_read;    // time_msec() of the next scheduled read
+    int read_phase;         // offset of its reads in the polling period (ms)
+    struct tempd_lm75 lm75; // device configuration (lm75-class sensors)
+    int watchdog_slot;      // -1 or slot owned by the watchdog thread
+    uint32_t watchdog_count;    // last watchdog reading applied
+    int replay_status;      // latest replayed sample (--replay): 0 or errno
+    char replay_raw[2];     // and its raw register contents
+    int batch_status;       // -1, or the result of its batched read
+                            // (--i2c-dev): 0 or errno
+    char batch_raw[2];      // and its raw register contents
+    char *dump_thresholds;  // thresholds, formatted for ops-tempd/dump
+    char *dump_thresholds_json;         // and for ops-tempd/dump json
+    struct virtual_sensor *virtual;     // expression, if this is a virtual
+                                        // sensor (--virtual)
+    struct virtual_users *virtual_users;    // virtual sensors reading this
+                                            // one (NULL if none)
 };
 
 // i2c operation failure retry
 #define MAX_FAIL_RETRY  2
 
+// consecutive faults before a sensor's circuit breaker opens: this is the
+// point at which the sensor is marked as failed
+#define SENSOR_BREAKER_TRIP (MAX_FAIL_RETRY + 2)
+
+// emergency confirmation: number of raw samples taken in a burst, how many
+// of them must be over the emergency threshold, and the spacing between them
+#define EMERGENCY_CONFIRM_SAMPLES           5
+#define EMERGENCY_CONFIRM_VOTES             3
+#define EMERGENCY_CONFIRM_INTERVAL_MS       5
+#define EMERGENCY_CONFIRM_MAX_SAMPLES       32
+#define EMERGENCY_CONFIRM_MAX_INTERVAL_MS   100
+
 // command to execute if emergency threshold temperature is reached
 // CAUTION: "off" is not an implemented power state for some switches:
 // this may result in a system needing to be powered off completely,
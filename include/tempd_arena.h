@@ -0,0 +1,60 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Arena allocator for subsystem data
+ *
+ * Each subsystem keeps its own objects (the subsystem, its sensors, their
+ * names and formatted thresholds) in an arena that is sized for them when
+ * the subsystem is added, and released in one go when it's removed. The
+ * heap then sees one large block per subsystem instead of many small ones,
+ * which keeps it from fragmenting as line cards come and go.
+ *
+ * Allocations can't be freed individually. If the initial size turns out
+ * to be too small, more chunks are added as needed.
+ ***************************************************************************/
+
+#ifndef _TEMPD_ARENA_H_
+#define _TEMPD_ARENA_H_
+
+#include <stddef.h>
+
+#include "compiler.h"
+
+#define ARENA_ALIGN     16      // alignment (and size granularity) of blocks
+
+struct tempd_arena;
+
+struct tempd_arena_usage {
+    size_t size;            // bytes reserved, in all chunks
+    size_t used;            // bytes allocated (including alignment)
+    size_t n_chunks;        // chunks (1 if the initial size was enough)
+    size_t n_allocs;        // allocations
+};
+
+struct tempd_arena *tempd_arena_create(size_t size);
+void tempd_arena_destroy(struct tempd_arena *);
+void *tempd_arena_alloc(struct tempd_arena *, size_t size);
+char *tempd_arena_strdup(struct tempd_arena *, const char *);
+char *tempd_arena_asprintf(struct tempd_arena *, const char *format, ...)
+    OVS_PRINTF_FORMAT(2, 3);
+void tempd_arena_usage(const struct tempd_arena *, struct tempd_arena_usage *);
+void tempd_arena_totals(size_t *n_created, size_t *n_live);
+
+#endif /* _TEMPD_ARENA_H_ */
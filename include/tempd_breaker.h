@@ -0,0 +1,72 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Fault circuit breaker for sensors and i2c buses
+ *
+ * A breaker is "closed" while its device responds. After a number of
+ * consecutive faults it "opens", and the device isn't touched again until
+ * a probe is due. Probe intervals double after each failed probe, up to a
+ * maximum. The first successful read closes the breaker again.
+ ***************************************************************************/
+
+#ifndef _TEMPD_BREAKER_H_
+#define _TEMPD_BREAKER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// consecutive faults before a bus breaker opens (sensor breakers open when
+// the sensor is marked as failed)
+#define BREAKER_BUS_TRIP            8
+
+// probe interval bounds (milliseconds)
+#define BREAKER_MIN_BACKOFF_MS      10000
+#define BREAKER_MAX_BACKOFF_MS      320000
+
+enum tempd_breaker_state {
+    BREAKER_CLOSED = 0,     // device is read normally
+    BREAKER_OPEN = 1,       // device is left alone until the next probe
+    BREAKER_PROBING = 2     // a probe is allowed, waiting for its result
+};
+
+struct tempd_breaker {
+    enum tempd_breaker_state state;
+    int trip;               // consecutive faults that open the breaker
+    int failures;           // current consecutive faults
+    int backoff;            // current probe interval (milliseconds)
+    long long next_probe;   // time_msec() when the next probe is allowed
+
+    // counters
+    uint64_t n_reads;       // device accesses
+    uint64_t n_faults;      // failed device accesses
+    uint64_t n_skipped;     // accesses avoided while open
+    uint64_t n_trips;       // times the breaker opened
+    uint64_t n_probes;      // probes while open
+
+    int last_error;         // last failure code (0 if none yet)
+    long long last_error_time;  // time_msec() of the last failure
+};
+
+void tempd_breaker_init(struct tempd_breaker *, int trip);
+bool tempd_breaker_allow(struct tempd_breaker *, long long now);
+bool tempd_breaker_record(struct tempd_breaker *, int rc, long long now);
+const char *tempd_breaker_state_to_string(enum tempd_breaker_state);
+
+#endif /* _TEMPD_BREAKER_H_ */
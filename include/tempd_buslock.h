@@ -0,0 +1,52 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Advisory i2c bus locks shared with other daemons
+ *
+ * With --bus-lock-dir=DIR, every device access on a bus is made while
+ * holding an exclusive flock() on DIR/BUS.lock (any '/' in the bus name is
+ * replaced with '_'). Other platform daemons that take the same lock
+ * around their own transfers on that bus won't collide with ours. The
+ * lock is only advisory: a daemon that doesn't use it isn't held back.
+ *
+ * The lock is held for a single transfer. If another process holds it for
+ * longer than BUSLOCK_TIMEOUT_MS, the access goes ahead anyway (and is
+ * counted): a stuck daemon must not stop sensors from being read.
+ * Threads of ops-tempd (the main loop and the watchdog) share one file
+ * description per bus, which flock() doesn't arbitrate between, so they
+ * also take a mutex.
+ ***************************************************************************/
+
+#ifndef _TEMPD_BUSLOCK_H_
+#define _TEMPD_BUSLOCK_H_
+
+#include <stdbool.h>
+
+#define BUSLOCK_TIMEOUT_MS  100     // longest wait for another process
+#define BUSLOCK_RETRY_US    500     // polling interval while waiting
+
+struct tempd_buslock;
+
+struct tempd_buslock *tempd_buslock_open(const char *dir, const char *bus);
+void tempd_buslock_close(struct tempd_buslock *);
+bool tempd_buslock_acquire(struct tempd_buslock *);
+void tempd_buslock_release(struct tempd_buslock *);
+
+#endif /* _TEMPD_BUSLOCK_H_ */
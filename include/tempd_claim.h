@@ -0,0 +1,64 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Subsystem claims: an OVSDB lock for each subsystem handled
+ *
+ * Whether it handles every subsystem or only some (--subsystems), the
+ * instance holding its ops-tempd lock claims each of its subsystems, and
+ * only touches the devices and Temp_sensor rows of those it has claimed:
+ * a claim is the OVSDB lock ops_tempd_subsystem_<SHA-1 of the name>,
+ * taken on a second connection to the database (the IDL connection only
+ * takes one lock). Two instances whose subsystems overlap, whether two
+ * shards or a shard and an instance handling everything, never handle the
+ * same subsystem: the first to claim it does, and the other logs an error
+ * and waits for the claim, taking the subsystem over if the first goes
+ * away. Nothing waits for one claim while holding another back, so
+ * overlapping instances can't deadlock.
+ *
+ * The instance holding the ops-tempd lock also asks for ops_tempd_cur_hw:
+ * whichever instance holds that one sets Daemon:cur_hw, once the rows of
+ * its sensors have been created.
+ *
+ * The server drops the claims if the connection goes, and they're taken
+ * again when it comes back.
+ ***************************************************************************/
+
+#ifndef _TEMPD_CLAIM_H_
+#define _TEMPD_CLAIM_H_
+
+#include <stdbool.h>
+
+struct ds;
+
+void tempd_claim_open(const char *remote);
+void tempd_claim_close(void);
+void tempd_claim_run(bool enabled);
+void tempd_claim_wait(void);
+
+void tempd_claim_begin(void);
+void tempd_claim_want(const char *subsystem);
+void tempd_claim_end(void);
+
+bool tempd_claim_held(const char *subsystem);
+bool tempd_claim_cur_hw(void);
+unsigned int tempd_claim_seqno(void);
+void tempd_claim_dump(struct ds *);
+
+#endif /* _TEMPD_CLAIM_H_ */
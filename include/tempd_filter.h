@@ -0,0 +1,74 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor noise filters
+ *
+ * Raw readings are passed through a per-sensor filter before they are
+ * compared to the alarm and fan thresholds. All filters use integer
+ * arithmetic on milidegrees and a small history kept inside the filter.
+ *
+ * Filter specifications (as given to --filter and ops-tempd/filter):
+ *     none            no filtering
+ *     median3         median of the last 3 readings
+ *     median5         median of the last 5 readings
+ *     ema:PERCENT     exponential moving average, weight of new reading
+ *                     in percent (1-100)
+ *     slew:MILIDEG    limit the change between readings to MILIDEG
+ ***************************************************************************/
+
+#ifndef _TEMPD_FILTER_H_
+#define _TEMPD_FILTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FILTER_HISTORY  5
+
+enum tempd_filter_type {
+    FILTER_NONE = 0,
+    FILTER_MEDIAN3 = 1,
+    FILTER_MEDIAN5 = 2,
+    FILTER_EMA = 3,
+    FILTER_SLEW = 4
+};
+
+struct tempd_filter_config {
+    enum tempd_filter_type type;
+    int param;              // EMA weight (1/256ths) or slew limit (milidegrees)
+};
+
+struct tempd_filter {
+    struct tempd_filter_config config;
+    int history[FILTER_HISTORY];    // last readings (ring)
+    int n_history;          // readings in history
+    int next;               // next history slot
+    long long ema;          // EMA state, milidegrees * 256
+    int value;              // last filtered value
+    bool primed;            // at least one reading has been filtered
+};
+
+void tempd_filter_init(struct tempd_filter *,
+                       const struct tempd_filter_config *);
+int tempd_filter_apply(struct tempd_filter *, int raw);
+bool tempd_filter_parse(const char *spec, struct tempd_filter_config *);
+void tempd_filter_format(const struct tempd_filter_config *,
+                         char *buf, size_t size);
+
+#endif /* _TEMPD_FILTER_H_ */
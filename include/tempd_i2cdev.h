@@ -0,0 +1,66 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Native i2c-dev access, batching register reads with I2C_RDWR
+ *
+ * With --i2c-dev=BUS=DEVICE, the devices on the h/w description's bus BUS
+ * are accessed through the i2c-dev character device DEVICE (/dev/i2c-N),
+ * opened once, instead of through config-yaml. A register read is a
+ * single I2C_RDWR ioctl holding two messages, the register pointer write
+ * and the read, with a repeated start between them. A batch of register
+ * reads from different devices on the bus goes in one ioctl, as many
+ * reads as fit in I2C_RDWR_IOCTL_MAX_MSGS messages.
+ *
+ * An I2C_RDWR transfer stops at the first message that isn't
+ * acknowledged, and the ioctl only reports that one of them failed, so a
+ * failed batch is retried one read at a time to find out which.
+ *
+ * Adapters that only do SMBus (including the i2c-stub test module) are
+ * accessed with SMBus byte and word transfers instead, one per register,
+ * so the daemon can be tested against i2c-stub: words are byte-swapped,
+ * as SMBus sends the low byte first and LM75-class registers the high.
+ ***************************************************************************/
+
+#ifndef _TEMPD_I2CDEV_H_
+#define _TEMPD_I2CDEV_H_
+
+#include <stddef.h>
+
+struct tempd_i2cdev;
+
+// a register read, in a batch
+struct tempd_i2cdev_read {
+    int address;            // 7-bit device address
+    int reg;                // register pointer
+    int length;             // bytes to read into buf
+    char *buf;
+    int rc;                 // result: 0 or an errno value
+};
+
+struct tempd_i2cdev *tempd_i2cdev_open(const char *path);
+void tempd_i2cdev_close(struct tempd_i2cdev *);
+void tempd_i2cdev_read_batch(struct tempd_i2cdev *,
+                             struct tempd_i2cdev_read *, size_t n);
+int tempd_i2cdev_read(struct tempd_i2cdev *, int address, int reg,
+                      int length, char *buf);
+int tempd_i2cdev_write(struct tempd_i2cdev *, int address, int reg,
+                       int length, const char *buf);
+
+#endif /* _TEMPD_I2CDEV_H_ */
@@ -0,0 +1,92 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * LM75-class device configuration: resolution and one-shot conversion
+ *
+ * LM75-class sensors share the register layout: temperature (0),
+ * configuration (1), hysteresis (2) and overtemperature (3). The parts
+ * differ in what the configuration register offers, so the part is looked
+ * up by the device's dev_type in the h/w description:
+ *
+ *     part        resolution      one-shot    conversion (9 bits, max)
+ *     lm75        9 bits          no
+ *     lm75a/b     11 bits         no
+ *     ds75        9 to 12 bits    no
+ *     ds7505      9 to 12 bits    yes         25 ms
+ *     tmp75/175/275  9 to 12      yes         37.5 ms
+ *
+ * Unknown types are handled as a plain LM75. Conversion time doubles with
+ * each bit of resolution.
+ *
+ * With --lm75-resolution=BITS, parts with selectable resolution are set to
+ * it; otherwise they're read at whatever resolution they're set to. With
+ * --lm75-oneshot, parts that support it are kept in shutdown, and a single
+ * conversion is started ahead of each scheduled read, long enough before
+ * for it to complete. All of the one-shot sensors in a subsystem share a
+ * read phase, so they sample at the same instant. Sensors in subsystems
+ * that can shut down the system keep converting continuously: the
+ * emergency confirmation and the watchdog read them back to back.
+ ***************************************************************************/
+
+#ifndef _TEMPD_LM75_H_
+#define _TEMPD_LM75_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// registers
+#define LM75_REG_TEMP           0
+#define LM75_REG_CONFIG         1
+
+// configuration register bits
+#define LM75_CONFIG_SHUTDOWN    0x01
+#define LM75_CONFIG_RES_SHIFT   5       // resolution - 9, on parts that have it
+#define LM75_CONFIG_RES_MASK    0x60
+#define LM75_CONFIG_ONESHOT     0x80
+
+#define LM75_MIN_RESOLUTION     9
+#define LM75_MAX_RESOLUTION     12
+
+struct tempd_lm75_part {
+    const char *type;           // dev_type in the h/w description
+    int resolution;             // fixed resolution, or 0 if selectable
+    bool oneshot;               // one-shot conversion in shutdown
+    int conversion_us;          // max conversion time at 9 bits
+};
+
+// a sensor's device configuration
+struct tempd_lm75 {
+    const struct tempd_lm75_part *part;
+    int resolution;             // bits in the temperature register
+    uint8_t config;             // configuration register, as written
+    bool oneshot;               // kept in shutdown, converting on demand
+    bool converting;            // a conversion was started for the next read
+    bool allowed;               // the circuit breakers let it (and so the
+                                // read) through
+    long long ready;            // time_msec() when it's done
+};
+
+const struct tempd_lm75_part *tempd_lm75_find_part(const char *type);
+void tempd_lm75_init(struct tempd_lm75 *, const struct tempd_lm75_part *);
+bool tempd_lm75_configure(struct tempd_lm75 *, uint8_t config,
+                          int resolution, bool oneshot);
+int tempd_lm75_conversion_ms(const struct tempd_lm75 *);
+
+#endif /* _TEMPD_LM75_H_ */
@@ -0,0 +1,63 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Deduplicated, rate-limited logging of sensor events
+ *
+ * Events that can happen for every sensor on every pass (a sensor or bus
+ * not responding, an unknown sensor type, a row without a sensor) are
+ * checked with tempd_log_check() before they're logged:
+ *
+ *     static struct tempd_log_event ev = TEMPD_LOG_EVENT_INIT("Bus down");
+ *
+ *     if (tempd_log_check(&ev, bus->name)) {
+ *         VLOG_WARN(...);
+ *     }
+ *
+ * The first occurrence of an event for a key (usually a sensor or bus
+ * name) is logged. Later ones are only counted, and tempd_log_run() logs
+ * them as "N more in T s" once a minute. A key that has been quiet
+ * for a whole minute is forgotten, so its next occurrence is logged again.
+ *
+ * The volume is bounded however many sensors misbehave: at most
+ * LOG_BURST first occurrences and LOG_MAX_SUMMARIES summaries are logged
+ * per minute (the rest are folded into a single line), and no more than
+ * LOG_MAX_KEYS keys are tracked.
+ ***************************************************************************/
+
+#ifndef _TEMPD_LOG_H_
+#define _TEMPD_LOG_H_
+
+#include <stdbool.h>
+
+struct shash;
+
+struct tempd_log_event {
+    const char *name;               // what happened, e.g. "Bus down"
+    struct tempd_log_event *next;   // next registered event
+    struct shash *keys;             // struct log_key, by key (NULL until
+                                    // first checked)
+};
+
+#define TEMPD_LOG_EVENT_INIT(NAME) { NAME, NULL, NULL }
+
+bool tempd_log_check(struct tempd_log_event *, const char *key);
+void tempd_log_run(void);
+
+#endif /* _TEMPD_LOG_H_ */
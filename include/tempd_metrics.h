@@ -0,0 +1,51 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * OpenMetrics exposition on a unix domain socket
+ *
+ * With --metrics=PATH, ops-tempd listens on a unix socket and answers each
+ * connection with the current metrics in OpenMetrics text format, then
+ * closes it. A client that sends an HTTP GET request gets an HTTP response
+ * (e.g. "curl --unix-socket PATH http://localhost/metrics"). A client that
+ * sends any other line, or just shuts down its side of the connection,
+ * gets the bare exposition text.
+ *
+ * The socket is served from the main poll loop. The text for each sensor
+ * is kept between scrapes and only formatted again when one of its values
+ * changes, so a scrape mostly copies cached text.
+ ***************************************************************************/
+
+#ifndef _TEMPD_METRICS_H_
+#define _TEMPD_METRICS_H_
+
+#include "tempd.h"
+
+struct ds;
+
+int tempd_metrics_open(const char *path);
+void tempd_metrics_close(void);
+void tempd_metrics_run(void);
+void tempd_metrics_wait(void);
+
+void tempd_metrics_update(const struct locl_sensor *);
+void tempd_metrics_remove(const char *name);
+void tempd_metrics_format(struct ds *);
+
+#endif /* _TEMPD_METRICS_H_ */
@@ -0,0 +1,75 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor state mirroring for a hot standby
+ *
+ * With --mirror=PATH, an instance that doesn't hold the ops_tempd lock
+ * doesn't sit idle: it keeps its subsystems parsed from the database, as
+ * the active instance does, and connects to the active instance on the
+ * unix socket at PATH. The active instance sends it the state of every
+ * sensor when it connects, and with each publish the state of the sensors
+ * that changed:
+ *
+ *     {"method":"state","params":[[NAME, TEMP, RAW_TEMP, MIN, MAX,
+ *                                  FAULT_COUNT, SAMPLE_TIME, STATUS,
+ *                                  FAN_SPEED, FAN_DEMAND, FILTER_VALUE,
+ *                                  FILTER_EMA, FILTER_PRIMED, [HISTORY...],
+ *                                  [WHEN, TEMP, ...],
+ *                                  [[LENGTH, START, MIN, MAX, SUM, COUNT,
+ *                                    ...], ...]], ...],"id":null}
+ *     {"method":"remove","params":[NAME, ...],"id":null}
+ *
+ * (filter history, trend readings and window buckets are oldest first,
+ * and the sample, trend and bucket times are time_msec(), which is the
+ * same monotonic clock in both processes). The last field, each rolling
+ * statistics window's buckets, may be left out by an older peer.
+ *
+ * When the standby gets the lock, it copies the mirrored state into its
+ * sensors, starts listening on PATH in turn, and carries on from the next
+ * pass: min/max, the status and fan hysteresis, the noise filter, the
+ * trend and the rolling statistics windows (those of the same length as
+ * one of the active instance's) continue where the active instance left
+ * them. Circuit breakers
+ * aren't mirrored, and start closed.
+ ***************************************************************************/
+
+#ifndef _TEMPD_MIRROR_H_
+#define _TEMPD_MIRROR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "shash.h"
+
+struct ds;
+struct locl_sensor;
+
+void tempd_mirror_open(const char *path);
+void tempd_mirror_close(void);
+void tempd_mirror_run(void);
+void tempd_mirror_wait(void);
+
+bool tempd_mirror_is_active(void);
+void tempd_mirror_activate(const struct shash *sensors);
+void tempd_mirror_publish(struct locl_sensor *const *sensors, size_t n);
+void tempd_mirror_remove(const char *name);
+void tempd_mirror_dump(struct ds *);
+
+#endif /* _TEMPD_MIRROR_H_ */
@@ -0,0 +1,75 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * USDT (user level statically defined tracing) probes
+ *
+ * Built with -DTEMPD_USDT=ON, the probes below are compiled in with
+ * sys/sdt.h. Each one is a single nop in the code until a tracer (bpftrace,
+ * perf, systemtap) attaches to it, so they can stay in production builds.
+ * Otherwise they're compiled out completely. All probes belong to the
+ * "ops_tempd" provider:
+ *
+ *     read_start(name)                 device read of a sensor starting
+ *     read_end(name, rc, raw)          and done: 0 or errno, and the raw
+ *                                      LM75 register (first byte high)
+ *     batch_start(bus, count)          batch of temperature reads on an
+ *                                      i2c-dev bus starting (--i2c-dev)
+ *     batch_end(bus, count)            and done
+ *     batch_read(name, rc, raw)        a sensor's result from a batch, as
+ *                                      read_end (its reads don't fire
+ *                                      read_start and read_end)
+ *     status(name, old, new)           sensor status change (sensorstatus)
+ *     fan(name, old, new)              fan demand change (fanspeed)
+ *     confirm_start(name)              emergency confirmation starting
+ *     confirm_end(name, votes, confirmed)
+ *     commit_start()                   OVSDB transaction commit starting
+ *     commit_end(status)               and done (ovsdb_idl_txn_status)
+ *     reconfigure_start(seqno)         database change processing starting
+ *     reconfigure_end(subsystems)      and done, with the subsystem count
+ *
+ * Scripts using them are in utilities/bpftrace.
+ ***************************************************************************/
+
+#ifndef _TEMPD_PROBES_H_
+#define _TEMPD_PROBES_H_
+
+#ifdef TEMPD_USDT
+
+#include <sys/sdt.h>
+
+#define TEMPD_PROBE(NAME)                                               \
+    DTRACE_PROBE(ops_tempd, NAME)
+#define TEMPD_PROBE1(NAME, ARG1)                                        \
+    DTRACE_PROBE1(ops_tempd, NAME, ARG1)
+#define TEMPD_PROBE2(NAME, ARG1, ARG2)                                  \
+    DTRACE_PROBE2(ops_tempd, NAME, ARG1, ARG2)
+#define TEMPD_PROBE3(NAME, ARG1, ARG2, ARG3)                            \
+    DTRACE_PROBE3(ops_tempd, NAME, ARG1, ARG2, ARG3)
+
+#else
+
+#define TEMPD_PROBE(NAME)
+#define TEMPD_PROBE1(NAME, ARG1)
+#define TEMPD_PROBE2(NAME, ARG1, ARG2)
+#define TEMPD_PROBE3(NAME, ARG1, ARG2, ARG3)
+
+#endif /* TEMPD_USDT */
+
+#endif /* _TEMPD_PROBES_H_ */
@@ -0,0 +1,36 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Publishing sensor state to the Temp_sensor table
+ ***************************************************************************/
+
+#ifndef _TEMPD_PUBLISH_H_
+#define _TEMPD_PUBLISH_H_
+
+#include <stdbool.h>
+
+#include "tempd.h"
+
+struct ovsrec_temp_sensor;
+
+bool tempd_publish_sensor(const struct ovsrec_temp_sensor *,
+                          struct locl_sensor *, long long now);
+
+#endif /* _TEMPD_PUBLISH_H_ */
@@ -0,0 +1,76 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Recording and replay of raw sensor samples
+ *
+ * With --record=FILE, every raw sensor read (from the main loop, the
+ * emergency confirmation and the watchdog thread) is appended to a binary
+ * log. When the log reaches its size limit it's renamed to FILE.1,
+ * replacing any older one, and a new log is started, so at most twice the
+ * limit is used on disk.
+ *
+ * Log format (all integers little endian): a header, then records that
+ * each start with a type byte.
+ *
+ *     header:  "TEMPDREC" u32 version u64 base (monotonic milliseconds)
+ *     define:  u8 1, u16 id, u8 length, name[length]
+ *     sample:  u8 2, u16 id, u32 delta (milliseconds since the previous
+ *              sample, or the base), u8 raw[2], u8 status (errno, 0 = ok)
+ *
+ * Sensor ids are defined in each file before they're first used, so every
+ * file can be replayed on its own. A header can also appear in the middle
+ * of a log, which allows a rotated pair to be replayed in order with
+ * "cat FILE.1 FILE".
+ ***************************************************************************/
+
+#ifndef _TEMPD_RECORD_H_
+#define _TEMPD_RECORD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RECORD_MAX_SIZE_MB  16      // default size limit of a log file
+
+struct ds;
+struct tempd_recorder;
+struct tempd_replay;
+
+// a sample read back from a log
+struct tempd_record {
+    const char *name;       // sensor name (valid until the next record)
+    long long when;         // monotonic milliseconds
+    char raw[2];            // raw LM75 register contents
+    int status;             // 0, or the errno of a failed read
+};
+
+struct tempd_recorder *tempd_recorder_open(const char *file_name,
+                                           size_t max_size, char **errorp);
+void tempd_recorder_close(struct tempd_recorder *);
+void tempd_recorder_sample(struct tempd_recorder *, const char *name,
+                           long long when, const char raw[2], int status);
+void tempd_recorder_flush(struct tempd_recorder *);
+void tempd_recorder_dump(struct tempd_recorder *, struct ds *);
+
+struct tempd_replay *tempd_replay_open(const char *file_name, char **errorp);
+void tempd_replay_close(struct tempd_replay *);
+bool tempd_replay_next(struct tempd_replay *, struct tempd_record *);
+const char *tempd_replay_error(const struct tempd_replay *);
+
+#endif /* _TEMPD_RECORD_H_ */
@@ -0,0 +1,54 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor state machine
+ *
+ * Everything that happens to a sensor between a raw sample and the values
+ * published in the database, independent of how the sample was read. This
+ * is shared by the daemon and tempd-bench.
+ ***************************************************************************/
+
+#ifndef _TEMPD_SENSOR_H_
+#define _TEMPD_SENSOR_H_
+
+#include <stdbool.h>
+
+#include "tempd.h"
+
+const char *sensor_status_to_string(enum sensorstatus status);
+const char *sensor_speed_to_string(enum fanspeed speed);
+int lm75_decode(const char *buf, int resolution);
+int tempd_take_batch(struct locl_sensor *, char buf[2]);
+
+void tempd_init_sensor(struct locl_sensor *, char *name,
+                       struct locl_subsystem *, const YamlSensor *,
+                       const struct tempd_filter_config *, int trend_window);
+void tempd_init_windows(struct locl_sensor *, struct tempd_window *,
+                        const struct tempd_window_config *);
+void tempd_add_to_windows(struct locl_sensor *, long long when);
+void tempd_apply_sample(struct locl_sensor *, int rc, int temp,
+                        long long when);
+void tempd_evaluate_sensor(struct locl_sensor *, int trend_lead);
+bool tempd_check_stale(struct locl_sensor *, long long now, long long max_age);
+bool tempd_next_alarm(const struct locl_sensor *, int *threshold,
+                      enum sensorstatus *level);
+bool tempd_next_fan_threshold(const struct locl_sensor *, int *threshold);
+
+#endif /* _TEMPD_SENSOR_H_ */
@@ -0,0 +1,76 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Simulated i2c sensor backend
+ *
+ * With --sim=FILE, ops-tempd doesn't use the h/w description files or the
+ * i2c bus. Subsystems (from the Subsystem table, as usual) are matched
+ * against the scenario file, which describes their sensors, and sensor
+ * reads return LM75 register contents computed from the scenario. Reads
+ * can be given a latency, fail at random, or hang for a while.
+ *
+ * Scenario file: one rule per line, '#' starts a comment. For each
+ * subsystem or sensor, the last matching rule of each kind wins. GLOB is a
+ * shell pattern matched against subsystem names (subsystem rules) or
+ * sensor names, i.e. "[subsystem name]-[sensor number]" (all other rules).
+ * Temperatures are in milidegrees, except for alarm and fan thresholds,
+ * which are in degrees like the h/w description files.
+ *
+ *     seed N
+ *     subsystem GLOB SENSORS [shutdown]
+ *     alarm GLOB EMERG_ON EMERG_OFF CRIT_ON CRIT_OFF MAX_ON MAX_OFF MIN LOWCRIT
+ *     fan GLOB MAX_ON MAX_OFF FAST_ON FAST_OFF MEDIUM_ON MEDIUM_OFF
+ *     temp GLOB BASE [ramp RATE LIMIT] [step SEC TEMP] [noise AMPLITUDE]
+ *     latency GLOB USEC
+ *     error GLOB PERCENT
+ *     hang GLOB START_SEC DURATION_SEC TIMEOUT_USEC
+ *
+ * "ramp" moves the temperature by RATE milidegrees per second from BASE
+ * until it reaches LIMIT; "step" jumps to TEMP after SEC seconds; "noise"
+ * adds a uniformly distributed offset of up to +/- AMPLITUDE. A hung
+ * sensor blocks for TIMEOUT_USEC and fails, like an i2c bus timeout.
+ ***************************************************************************/
+
+#ifndef _TEMPD_SIM_H_
+#define _TEMPD_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config-yaml.h"
+
+struct ds;
+struct tempd_sim;
+
+struct tempd_sim *tempd_sim_load(const char *file_name, char **errorp);
+void tempd_sim_destroy(struct tempd_sim *);
+
+int tempd_sim_add_subsystem(struct tempd_sim *, const char *name,
+                            bool *emergency_shutdown);
+void tempd_sim_remove_subsystem(struct tempd_sim *, const char *name);
+const YamlSensor *tempd_sim_get_sensor(struct tempd_sim *, const char *name,
+                                       int idx);
+const YamlDevice *tempd_sim_get_device(struct tempd_sim *, const char *name);
+
+int tempd_sim_read(struct tempd_sim *, const YamlSensor *, int len, void *buf);
+void tempd_sim_shutdown(struct tempd_sim *);
+void tempd_sim_dump(const struct tempd_sim *, struct ds *);
+
+#endif /* _TEMPD_SIM_H_ */
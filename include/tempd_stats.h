@@ -0,0 +1,88 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Pipeline counters and latency histograms
+ *
+ * Each thread that records statistics gets its own block of counters the
+ * first time it does so, and is the only writer of that block, so updates
+ * are plain relaxed atomic stores without any locking. Readers add up the
+ * blocks of all threads.
+ *
+ * Latencies are kept in log2 buckets of microseconds: bucket 0 counts
+ * times under 1 us, bucket N times from 2^(N-1) up to 2^N us. The last
+ * bucket also counts anything longer.
+ *
+ * A reset doesn't touch the blocks (they belong to other threads): it
+ * takes a snapshot of the totals, which is subtracted from later reports.
+ ***************************************************************************/
+
+#ifndef _TEMPD_STATS_H_
+#define _TEMPD_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct ds;
+
+// must match the counter names in tempd_stats.c
+enum tempd_counter {
+    STATS_READS = 0,            // device reads
+    STATS_FAULTS,               // failed device reads
+    STATS_RETRIES,              // failed reads that will be retried
+    STATS_STATUS_CHANGES,       // alarm status transitions
+    STATS_FAN_CHANGES,          // fan speed demand transitions
+    STATS_ROWS_WRITTEN,         // Temp_sensor rows updated
+    STATS_ROWS_DELETED,         // Temp_sensor rows of removed subsystems
+    STATS_EVENTS_LOGGED,        // sensor events logged (tempd_log.c)
+    STATS_EVENTS_COALESCED,     // and only counted in a summary
+    STATS_BUS_LOCK_TIMEOUTS,    // bus accesses made without the bus lock
+    STATS_I2C_TRANSFERS,        // i2c-dev ioctls (tempd_i2cdev.c)
+    STATS_N_COUNTERS
+};
+
+// must match the histogram names in tempd_stats.c
+enum tempd_histogram {
+    STATS_READ_TIME = 0,        // a single device read (not in a batch)
+    STATS_PASS_TIME,            // a whole sampling and publishing pass
+    STATS_COMMIT_TIME,          // an OVSDB transaction commit
+    STATS_RECONFIGURE_TIME,     // processing a database change
+    STATS_BUS_LOCK_TIME,        // waiting for a bus lock (tempd_buslock.c)
+    STATS_BATCH_TIME,           // a batch of reads on a bus (--i2c-dev)
+    STATS_N_HISTOGRAMS
+};
+
+#define STATS_N_BUCKETS     32
+
+struct tempd_stats_histogram {
+    uint64_t count;
+    uint64_t sum;                       // microseconds
+    uint64_t buckets[STATS_N_BUCKETS];
+};
+
+void tempd_stats_count(enum tempd_counter, unsigned int n);
+long long tempd_stats_start(void);
+void tempd_stats_record(enum tempd_histogram, long long start);
+void tempd_stats_reset(void);
+void tempd_stats_format(struct ds *, bool json);
+void tempd_stats_get_histogram(enum tempd_histogram,
+                               struct tempd_stats_histogram *);
+const char *tempd_stats_histogram_name(enum tempd_histogram);
+
+#endif /* _TEMPD_STATS_H_ */
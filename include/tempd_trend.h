@@ -0,0 +1,59 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Temperature trend estimation
+ *
+ * Keeps a least-squares fit of temperature against time over a sliding
+ * window of readings. The sums needed for the fit are updated as readings
+ * enter and leave the window, so each reading costs O(1) whatever the
+ * window size.
+ ***************************************************************************/
+
+#ifndef _TEMPD_TREND_H_
+#define _TEMPD_TREND_H_
+
+#include <stdbool.h>
+
+#define TREND_WINDOW        12      // default readings in the window
+#define TREND_MIN_WINDOW    3
+#define TREND_MAX_WINDOW    32
+
+struct tempd_trend {
+    int window;             // readings kept in the fit
+    int n;                  // readings currently in the window
+    int next;               // next slot in the ring
+    long long when[TREND_MAX_WINDOW];   // reading times (milliseconds)
+    int temp[TREND_MAX_WINDOW];         // readings (milidegrees)
+
+    // running sums, with times relative to base
+    long long base;
+    long long sum_t;
+    long long sum_y;
+    long long sum_tt;
+    long long sum_ty;
+};
+
+void tempd_trend_init(struct tempd_trend *, int window);
+void tempd_trend_add(struct tempd_trend *, long long when, int temp);
+bool tempd_trend_slope(const struct tempd_trend *, int *slope);
+bool tempd_trend_time_to(const struct tempd_trend *, int temp, int threshold,
+                         long long *msec);
+
+#endif /* _TEMPD_TREND_H_ */
@@ -0,0 +1,92 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Virtual sensors
+ *
+ * With --virtual=FILE, ops-tempd adds sensors whose temperature is an
+ * expression over physical sensors, like the hottest ASIC sensor or the
+ * difference between the inlet and outlet sensors. A virtual sensor
+ * belongs to a subsystem and is added and removed with it. It gets a
+ * Temp_sensor row, alarm and fan thresholds, a status and a fan demand
+ * like any other sensor, but never triggers an emergency shutdown.
+ *
+ * Definitions file: one rule per line, '#' starts a comment. GLOB is a
+ * shell pattern matched against virtual sensor names; for each sensor,
+ * the last matching rule of each kind wins. Thresholds are in degrees,
+ * like the h/w description files. A virtual sensor without an alarm or
+ * fan rule never raises an alarm or a fan demand.
+ *
+ *     virtual SUBSYSTEM NAME EXPR
+ *     location GLOB TEXT
+ *     alarm GLOB EMERG_ON EMERG_OFF CRIT_ON CRIT_OFF MAX_ON MAX_OFF MIN LOWCRIT
+ *     fan GLOB MAX_ON MAX_OFF FAST_ON FAST_OFF MEDIUM_ON MEDIUM_OFF
+ *
+ * An expression is a sensor name, a number (milidegrees), or a function
+ * of one or more expressions:
+ *
+ *     max(...)  min(...)  avg(...)   largest, smallest and mean value
+ *     sum(...)                       sum of the values
+ *     diff(A, B)                     A minus B
+ *
+ * An argument can be preceded by a weight ("sum(0.7 base-1, 0.3 base-2)")
+ * and a sensor name can be a glob over the physical sensors, which gives
+ * the functions one argument per matching sensor ("max(card-3-*)"). For
+ * example:
+ *
+ *     virtual base base-asic max(base-2, base-3, base-4)
+ *     virtual base base-airflow diff(base-5, base-1)
+ *     virtual card-3 card-3-avg avg(card-3-*)
+ *     alarm base-asic 100 95 90 85 80 75 -100 -100
+ *
+ * Each expression is compiled into a flat program of stack operations
+ * when the physical sensors change, with the sensors it reads resolved,
+ * and only evaluated again when one of them has a new reading. Failed
+ * sensors are left out of max, min and avg; any other use of a failed or
+ * missing sensor makes the virtual sensor fail.
+ ***************************************************************************/
+
+#ifndef _TEMPD_VIRTUAL_H_
+#define _TEMPD_VIRTUAL_H_
+
+#include "config-yaml.h"
+#include "tempd.h"
+
+struct ds;
+struct tempd_virtual;
+
+struct tempd_virtual *tempd_virtual_load(const char *file_name,
+                                         char **errorp);
+void tempd_virtual_destroy(struct tempd_virtual *);
+
+int tempd_virtual_count(const struct tempd_virtual *, const char *subsystem);
+const YamlSensor *tempd_virtual_get_sensor(const struct tempd_virtual *,
+                                           const char *subsystem, int idx,
+                                           const char **namep);
+void tempd_virtual_attach(struct tempd_virtual *, const YamlSensor *,
+                          struct locl_sensor *);
+void tempd_virtual_detach(struct locl_sensor *);
+
+void tempd_virtual_bind(struct tempd_virtual *, const struct shash *sensors);
+void tempd_virtual_unbind(struct tempd_virtual *);
+void tempd_virtual_touch(const struct locl_sensor *);
+void tempd_virtual_run(struct tempd_virtual *, long long now, int trend_lead,
+                       void (*evaluated)(struct locl_sensor *));
+
+#endif /* _TEMPD_VIRTUAL_H_ */
@@ -0,0 +1,75 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Emergency watchdog thread for the platform Temperature daemon
+ *
+ * The watchdog thread owns the sensors of subsystems that are allowed to
+ * perform an emergency shutdown. It reads them on its own (short) period,
+ * independently of the OVSDB main loop, and hands each reading to a check
+ * callback that decides whether to shut the system down. Readings are
+ * shared with the main loop through a per-sensor sequence-locked buffer:
+ * the watchdog thread is the only writer and the main loop never blocks
+ * on it. The slot table lock is never held across a read or an emergency
+ * confirmation, so adding sensors doesn't wait for the watchdog; removing
+ * one only waits if the watchdog is busy with that very sensor, since its
+ * memory is about to be freed.
+ ***************************************************************************/
+
+#ifndef _TEMPD_WATCHDOG_H_
+#define _TEMPD_WATCHDOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// default watchdog settings
+#define WATCHDOG_PERIOD_MS      500
+#define WATCHDOG_PRIORITY       50
+#define WATCHDOG_MIN_PERIOD_MS  10
+
+// latest reading taken by the watchdog for one sensor
+struct tempd_watchdog_sample {
+    int rc;                 // 0 or error from the raw read
+    int temp;               // milidegrees (C), valid if rc is 0
+    long long when;         // time_msec() of the read
+    uint32_t count;         // number of reads taken so far
+};
+
+// take a raw sample of a sensor without changing its state
+typedef int tempd_watchdog_read_func(void *sensor, int *temp);
+// examine a good reading; may confirm an emergency and shut down
+typedef void tempd_watchdog_check_func(void *sensor, int temp);
+
+struct tempd_watchdog_settings {
+    int period;             // milliseconds between reads
+    int priority;           // SCHED_FIFO priority, 0 for normal scheduling
+    int cpu;                // cpu to pin the thread to, -1 for any
+    tempd_watchdog_read_func *read;
+    tempd_watchdog_check_func *check;
+};
+
+void tempd_watchdog_start(const struct tempd_watchdog_settings *);
+void tempd_watchdog_stop(void);
+bool tempd_watchdog_is_running(void);
+
+int tempd_watchdog_add(void *sensor);
+void tempd_watchdog_remove(int slot);
+bool tempd_watchdog_get(int slot, struct tempd_watchdog_sample *);
+
+#endif /* _TEMPD_WATCHDOG_H_ */
@@ -0,0 +1,103 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Rolling minimum, maximum and average over time windows
+ *
+ * Each window is split into WINDOW_BUCKETS buckets of equal length, which
+ * keep the minimum, maximum, sum and count of the readings in them. The
+ * closed buckets still in the window are kept in a ring, along with the
+ * running sum and count over them, and two monotonic deques of ring slots:
+ * one with decreasing maximums, whose front is the window's maximum, and
+ * one with increasing minimums. Closing a bucket pushes it onto the deques
+ * (dropping the buckets it dominates) and expiring one pops it off their
+ * fronts, so each reading costs O(1) amortized whatever the window length,
+ * and the statistics are read in O(1).
+ *
+ * The window covers the current bucket and the closed buckets that started
+ * less than the window length before it, so its span varies by up to one
+ * bucket (a thirtieth of its length).
+ ***************************************************************************/
+
+#ifndef _TEMPD_WINDOW_H_
+#define _TEMPD_WINDOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define WINDOW_BUCKETS      30      // buckets in a window
+#define WINDOW_MAX          4       // windows per sensor
+#define WINDOW_DEFAULT      "5m,1h,24h"
+#define WINDOW_AVG_QUANTUM  100     // published averages are rounded to
+                                    // this many milidegrees
+
+struct window_bucket {
+    long long start;        // time (msec) the bucket starts
+    int min;                // milidegrees
+    int max;                // milidegrees
+    long long sum;          // of the readings (milidegrees)
+    int count;              // readings
+};
+
+struct tempd_window {
+    long long length;       // window length (msec)
+    long long bucket_ms;    // bucket length (msec)
+    struct window_bucket current;       // bucket being filled
+
+    // closed buckets in the window, oldest first from head
+    struct window_bucket ring[WINDOW_BUCKETS];
+    int head;
+    int n;
+    long long sum;          // of the readings in the closed buckets
+    int count;
+
+    // ring slots, oldest first: decreasing maximums, increasing minimums
+    int max_q[WINDOW_BUCKETS];
+    int max_head;
+    int max_n;
+    int min_q[WINDOW_BUCKETS];
+    int min_head;
+    int min_n;
+};
+
+struct tempd_window_stats {
+    int min;                // milidegrees
+    int max;                // milidegrees
+    int avg;                // milidegrees
+    int count;              // readings in the window
+};
+
+// windows kept for each sensor (--windows)
+struct tempd_window_config {
+    int n;
+    long long length[WINDOW_MAX];       // msec
+};
+
+void tempd_window_init(struct tempd_window *, long long length);
+void tempd_window_add(struct tempd_window *, long long when, int temp);
+bool tempd_window_get(struct tempd_window *, long long now,
+                      struct tempd_window_stats *);
+int tempd_window_buckets(const struct tempd_window *,
+                         struct window_bucket buckets[WINDOW_BUCKETS + 1]);
+void tempd_window_add_bucket(struct tempd_window *,
+                             const struct window_bucket *);
+bool tempd_window_parse(const char *spec, struct tempd_window_config *);
+void tempd_window_label(long long length, char *buf, size_t size);
+
+#endif /* _TEMPD_WINDOW_H_ */
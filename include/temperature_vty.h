@@ -30,6 +30,22 @@
 
 #define TEMP_STR "Temperature sensor information\n"
 #define TEMP_DETAIL_STR "Detailed temperature sensor information\n"
+#define TEMP_SUBSYSTEM_STR "Temperature sensors of one subsystem\n"
+#define TEMP_SUBSYSTEM_NAME_STR "Subsystem name\n"
+#define TEMP_STATUS_STR "Temperature sensors with a given status\n"
+#define TEMP_STATUS_VALUES_STR "Not read yet\n" \
+                               "Normal\n" \
+                               "Below the minimum threshold\n" \
+                               "Above the maximum threshold\n" \
+                               "Below the low critical threshold\n" \
+                               "Above the critical threshold\n" \
+                               "Failed\n" \
+                               "Above the emergency threshold\n"
+#define TEMP_ABOVE_STR "Temperature sensors at or above a temperature\n"
+#define TEMP_ABOVE_VALUE_STR "Temperature (in C)\n"
+#define TEMP_TOP_STR "Hottest temperature sensors\n"
+#define TEMP_TOP_VALUE_STR "Number of sensors\n"
+#define TEMP_SUMMARY_STR "Temperature summary per subsystem\n"
 
 void cli_pri_init(void);
 void cli_post_init(void);
@@ -29,6 +29,7 @@ TOPOLOGY = """
 
 
 def init_temp_sensor_table(sw1):
+    subsystem = None
     output = sw1('list subsystem', shell='vsctl')
     lines = output.split('\n')
     for line in lines:
@@ -36,12 +37,19 @@ def init_temp_sensor_table(sw1):
             _id = line.split(':')
             uuid = _id[1].strip()
             output = sw1('ovs-vsctl -- set Subsystem {} '
-                         ' temp_sensors=@fan1 -- --id=@fan1 '
+                         ' temp_sensors=@fan1,@fan2 -- --id=@fan1 '
                          ' create Temp_sensor name=base-1 '
                          ' location=Faceplate_side_of_switch_chip_U16 '
                          ' status=normal fan-state=normal min=0 '
-                         ' max=21000 temperature=20500'.format(uuid),
+                         ' max=21000 temperature=20500 -- --id=@fan2 '
+                         ' create Temp_sensor name=base-2 '
+                         ' location=Rear_side_of_switch_chip_U20 '
+                         ' status=max min=0 '
+                         ' max=56000 temperature=55000'.format(uuid),
                          shell='bash')
+        if line.startswith('name'):
+            subsystem = line.split(':')[1].strip().strip('"')
+    return subsystem
 
 
 def show_system_temperature(sw1, step):
@@ -59,10 +67,48 @@ def show_system_temperature(sw1, step):
     assert counter is 3
 
 
+def sensor_names(output):
+    names = []
+    for line in output.split('\n'):
+        fields = line.split()
+        if fields and fields[0].startswith('base-'):
+            names.append(fields[0])
+    return names
+
+
+def show_system_temperature_filters(sw1, step, subsystem):
+    step('Test to verify \'show system temperature\' filters')
+    output = sw1('show system temperature subsystem {}'.format(subsystem))
+    assert sensor_names(output) == ['base-1', 'base-2']
+    output = sw1('show system temperature subsystem no-such-subsystem')
+    assert sensor_names(output) == []
+    output = sw1('show system temperature status max')
+    assert sensor_names(output) == ['base-2']
+    output = sw1('show system temperature above 50')
+    assert sensor_names(output) == ['base-2']
+    output = sw1('show system temperature top 1')
+    assert sensor_names(output) == ['base-2']
+
+
+def show_system_temperature_summary(sw1, step, subsystem):
+    step('Test to verify \'show system temperature summary\' command')
+    output = sw1('show system temperature summary')
+    for line in output.split('\n'):
+        fields = line.split()
+        if fields and fields[0] == subsystem:
+            assert fields[1:] == ['2', 'max', '55.00', 'base-2']
+            break
+    else:
+        assert False, 'no summary line for subsystem ' + subsystem
+
+
 def test_tempd_ct_tempsensor(topology, step):
     sw1 = topology.get("sw1")
     assert sw1 is not None
     step("Initializing temperature sensor table with dummy data")
-    init_temp_sensor_table(sw1)
+    subsystem = init_temp_sensor_table(sw1)
+    assert subsystem is not None
     step('Test to verify \'show system temperature\' command')
     show_system_temperature(sw1, step)
+    show_system_temperature_filters(sw1, step, subsystem)
+    show_system_temperature_summary(sw1, step, subsystem)
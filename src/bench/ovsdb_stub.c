@@ -0,0 +1,140 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * In-process stand-in for the Temp_sensor table, for tempd-bench
+ *
+ * Provides the Temp_sensor column setters used by tempd_publish.c. Instead
+ * of building a transaction, they update the row in place and count the
+ * rows and columns written.
+ ***************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "smap.h"
+#include "util.h"
+#include "vswitch-idl.h"
+#include "ovsdb_stub.h"
+
+static struct ovsdb_stub_stats stats;
+static const struct ovsrec_temp_sensor *last_row;
+
+// count a column write to row
+static struct ovsrec_temp_sensor *
+stub_write(const struct ovsrec_temp_sensor *row)
+{
+    if (row != last_row) {
+        stats.n_rows++;
+        last_row = row;
+    }
+    stats.n_columns++;
+    return(CONST_CAST(struct ovsrec_temp_sensor *, row));
+}
+
+static void
+stub_set_string(char **column, const char *value)
+{
+    free(*column);
+    *column = xstrdup(value);
+}
+
+struct ovsrec_temp_sensor *
+ovsdb_stub_temp_sensor_create(const char *name)
+{
+    struct ovsrec_temp_sensor *row = xzalloc(sizeof(*row));
+
+    row->name = xstrdup(name);
+    row->location = xstrdup("");
+    row->status = xstrdup("");
+    row->fan_state = xstrdup("");
+    smap_init(&row->external_ids);
+    return(row);
+}
+
+void
+ovsdb_stub_temp_sensor_destroy(struct ovsrec_temp_sensor *row)
+{
+    free(row->name);
+    free(row->location);
+    free(row->status);
+    free(row->fan_state);
+    smap_destroy(&row->external_ids);
+    free(row);
+}
+
+// get the counters, and start counting again
+void
+ovsdb_stub_get_stats(struct ovsdb_stub_stats *result)
+{
+    *result = stats;
+    memset(&stats, 0, sizeof(stats));
+    last_row = NULL;
+}
+
+void
+ovsrec_temp_sensor_set_status(const struct ovsrec_temp_sensor *row,
+                              const char *status)
+{
+    stub_set_string(&stub_write(row)->status, status);
+}
+
+void
+ovsrec_temp_sensor_set_fan_state(const struct ovsrec_temp_sensor *row,
+                                 const char *fan_state)
+{
+    stub_set_string(&stub_write(row)->fan_state, fan_state);
+}
+
+void
+ovsrec_temp_sensor_set_location(const struct ovsrec_temp_sensor *row,
+                                const char *location)
+{
+    stub_set_string(&stub_write(row)->location, location);
+}
+
+void
+ovsrec_temp_sensor_set_temperature(const struct ovsrec_temp_sensor *row,
+                                   int64_t temperature)
+{
+    stub_write(row)->temperature = temperature;
+}
+
+void
+ovsrec_temp_sensor_set_min(const struct ovsrec_temp_sensor *row, int64_t min)
+{
+    stub_write(row)->min = min;
+}
+
+void
+ovsrec_temp_sensor_set_max(const struct ovsrec_temp_sensor *row, int64_t max)
+{
+    stub_write(row)->max = max;
+}
+
+void
+ovsrec_temp_sensor_set_external_ids(const struct ovsrec_temp_sensor *row,
+                                    const struct smap *external_ids)
+{
+    struct ovsrec_temp_sensor *w = stub_write(row);
+
+    smap_destroy(&w->external_ids);
+    smap_clone(&w->external_ids, external_ids);
+}
@@ -0,0 +1,40 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * In-process stand-in for the Temp_sensor table, for tempd-bench
+ ***************************************************************************/
+
+#ifndef _OVSDB_STUB_H_
+#define _OVSDB_STUB_H_
+
+#include <stdint.h>
+
+struct ovsrec_temp_sensor;
+
+struct ovsdb_stub_stats {
+    uint64_t n_rows;        // rows written
+    uint64_t n_columns;     // column writes
+};
+
+struct ovsrec_temp_sensor *ovsdb_stub_temp_sensor_create(const char *name);
+void ovsdb_stub_temp_sensor_destroy(struct ovsrec_temp_sensor *);
+void ovsdb_stub_get_stats(struct ovsdb_stub_stats *);
+
+#endif /* _OVSDB_STUB_H_ */
@@ -0,0 +1,425 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * tempd-bench: benchmark of the sensor sampling and publishing pipeline
+ *
+ * Runs the sensor state machine (tempd_sensor.c), with the daemon's
+ * default rolling statistics windows, and the Temp_sensor publish diff
+ * (tempd_publish.c) over simulated sensors (tempd_sim.c), without the
+ * daemon main loop or a database. For each sensor count it
+ * reports, as one JSON object per line:
+ *
+ *     {"benchmark": "evaluate", ...}  ns per sensor to apply a sample and
+ *                                     recalculate status and fan speed
+ *     {"benchmark": "pass", ...}      time for a full pass (read, evaluate
+ *                                     and publish every sensor), heap
+ *                                     allocations, and Temp_sensor rows
+ *                                     and columns written per pass
+ *
+ *     usage: tempd-bench [--sensors=N[,N...]] [--passes=N] [--output=FILE]
+ ***************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "vswitch-idl.h"
+#include "tempd_publish.h"
+#include "tempd_sensor.h"
+#include "tempd_sim.h"
+#include "ovsdb_stub.h"
+
+#define BENCH_SENSORS           "10,100,1000,10000"
+#define BENCH_PASSES            20
+#define BENCH_EVALUATE_ROUNDS   50
+#define BENCH_SUBSYSTEM_SIZE    100     // sensors per simulated subsystem
+#define BENCH_TREND_LEAD        60
+
+// sensors oscillate around the fan thresholds (defaults: medium 50/45,
+// fast 60/55), so that status and fan changes get published
+static const char bench_scenario[] =
+    "seed 1\n"
+    "subsystem bench-* " OVS_STRINGIZE(BENCH_SUBSYSTEM_SIZE) "\n"
+    "temp *-* 50000 noise 3000\n";
+
+static const struct tempd_filter_config bench_filter = { FILTER_NONE, 0 };
+
+// heap allocations. malloc, calloc and realloc are interposed so that
+// allocations made inside the OVS libraries are counted too.
+static uint64_t n_allocs = 0;
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+void *
+malloc(size_t size)
+{
+    n_allocs++;
+    return(__libc_malloc(size));
+}
+
+void *
+calloc(size_t count, size_t size)
+{
+    n_allocs++;
+    return(__libc_calloc(count, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    n_allocs++;
+    return(__libc_realloc(ptr, size));
+}
+
+struct bench {
+    struct tempd_sim *sim;
+    struct locl_subsystem *subsystems;
+    int n_subsystems;
+    struct locl_sensor **sensors;
+    struct ovsrec_temp_sensor **rows;
+    int n_sensors;
+};
+
+static long long
+bench_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+// load the simulation scenario from a temporary file
+static struct tempd_sim *
+bench_load_scenario(void)
+{
+    char file_name[] = "/tmp/tempd-bench.XXXXXX";
+    struct tempd_sim *sim;
+    char *error = NULL;
+    int fd;
+
+    fd = mkstemp(file_name);
+    if (fd < 0 || write(fd, bench_scenario, strlen(bench_scenario)) < 0) {
+        ovs_fatal(errno, "%s: can't write scenario", file_name);
+    }
+    close(fd);
+
+    sim = tempd_sim_load(file_name, &error);
+    unlink(file_name);
+    if (sim == NULL) {
+        ovs_fatal(0, "%s", error);
+    }
+    return(sim);
+}
+
+// create n simulated sensors, and a Temp_sensor row for each
+static void
+bench_create(struct bench *bench, int n)
+{
+    struct tempd_window_config windows;
+    int idx;
+
+    memset(bench, 0, sizeof(*bench));
+    (void)tempd_window_parse(WINDOW_DEFAULT, &windows);
+    bench->sim = bench_load_scenario();
+    bench->n_subsystems = (n + BENCH_SUBSYSTEM_SIZE - 1) / BENCH_SUBSYSTEM_SIZE;
+    bench->subsystems = xcalloc(bench->n_subsystems,
+                                sizeof(*bench->subsystems));
+    bench->sensors = xcalloc(n, sizeof(*bench->sensors));
+    bench->rows = xcalloc(n, sizeof(*bench->rows));
+
+    for (idx = 0; idx < n; idx++) {
+        int subsys_idx = idx / BENCH_SUBSYSTEM_SIZE;
+        struct locl_subsystem *subsystem = &bench->subsystems[subsys_idx];
+        struct locl_sensor *sensor = xmalloc(sizeof(*sensor));
+        const YamlSensor *yaml_sensor;
+        bool shutdown;
+
+        if (idx % BENCH_SUBSYSTEM_SIZE == 0) {
+            subsystem->name = xasprintf("bench-%d", subsys_idx);
+            subsystem->valid = true;
+            shash_init(&subsystem->subsystem_sensors);
+            tempd_sim_add_subsystem(bench->sim, subsystem->name, &shutdown);
+        }
+
+        yaml_sensor = tempd_sim_get_sensor(bench->sim, subsystem->name,
+                                           idx % BENCH_SUBSYSTEM_SIZE);
+        tempd_init_sensor(sensor, xasprintf("%s-%d", subsystem->name,
+                                            yaml_sensor->number),
+                          subsystem, yaml_sensor, &bench_filter, TREND_WINDOW);
+        tempd_init_windows(sensor, xcalloc(windows.n, sizeof(*sensor->windows)),
+                           &windows);
+        sensor->yaml_device = tempd_sim_get_device(bench->sim,
+                                                   subsystem->name);
+        shash_add(&subsystem->subsystem_sensors, sensor->name, sensor);
+
+        bench->sensors[idx] = sensor;
+        bench->rows[idx] = ovsdb_stub_temp_sensor_create(sensor->name);
+    }
+    bench->n_sensors = n;
+}
+
+static void
+bench_destroy(struct bench *bench)
+{
+    int idx;
+
+    for (idx = 0; idx < bench->n_sensors; idx++) {
+        ovsdb_stub_temp_sensor_destroy(bench->rows[idx]);
+        free(bench->sensors[idx]->name);
+        free(bench->sensors[idx]->windows);
+        free(bench->sensors[idx]);
+    }
+    for (idx = 0; idx < bench->n_subsystems; idx++) {
+        shash_destroy(&bench->subsystems[idx].subsystem_sensors);
+        free(bench->subsystems[idx].name);
+    }
+    free(bench->subsystems);
+    free(bench->sensors);
+    free(bench->rows);
+    tempd_sim_destroy(bench->sim);
+}
+
+// one polling pass: read, evaluate and publish every sensor
+static void
+bench_pass(struct bench *bench, long long when)
+{
+    int idx;
+
+    for (idx = 0; idx < bench->n_sensors; idx++) {
+        struct locl_sensor *sensor = bench->sensors[idx];
+        char buf[2];
+        int rc;
+
+        rc = tempd_sim_read(bench->sim, sensor->yaml_sensor, sizeof(buf), buf);
+        tempd_apply_sample(sensor, rc, rc == 0 ? lm75_decode(buf, LM75_MIN_RESOLUTION) : 0, when);
+        tempd_evaluate_sensor(sensor, BENCH_TREND_LEAD);
+    }
+
+    for (idx = 0; idx < bench->n_sensors; idx++) {
+        tempd_publish_sensor(bench->rows[idx], bench->sensors[idx], when);
+    }
+}
+
+// time the state machine alone, on pre-read temperatures
+static void
+bench_evaluate(FILE *output, int n)
+{
+    struct bench bench;
+    long long start;
+    long long elapsed;
+    int *temps;
+    int round;
+    int idx;
+
+    bench_create(&bench, n);
+
+    temps = xcalloc((size_t)n * BENCH_EVALUATE_ROUNDS, sizeof(*temps));
+    for (idx = 0; idx < n * BENCH_EVALUATE_ROUNDS; idx++) {
+        char buf[2];
+
+        tempd_sim_read(bench.sim, bench.sensors[idx % n]->yaml_sensor,
+                       sizeof(buf), buf);
+        temps[idx] = lm75_decode(buf, LM75_MIN_RESOLUTION);
+    }
+
+    start = bench_nsec();
+    for (round = 0; round < BENCH_EVALUATE_ROUNDS; round++) {
+        long long when = (long long)round * POLLING_PERIOD * MSEC_PER_SEC;
+
+        for (idx = 0; idx < n; idx++) {
+            struct locl_sensor *sensor = bench.sensors[idx];
+
+            tempd_apply_sample(sensor, 0, temps[round * n + idx], when);
+            tempd_evaluate_sensor(sensor, BENCH_TREND_LEAD);
+        }
+    }
+    elapsed = bench_nsec() - start;
+
+    fprintf(output, "{\"benchmark\": \"evaluate\", \"sensors\": %d, "
+            "\"rounds\": %d, \"ns_per_sensor\": %.1f}\n", n,
+            BENCH_EVALUATE_ROUNDS,
+            (double)elapsed / ((double)n * BENCH_EVALUATE_ROUNDS));
+
+    free(temps);
+    bench_destroy(&bench);
+}
+
+// time full passes
+static void
+bench_passes(FILE *output, int n, int passes)
+{
+    struct ovsdb_stub_stats stats;
+    struct bench bench;
+    long long total = 0;
+    long long min = LLONG_MAX;
+    long long max = 0;
+    uint64_t allocs = 0;
+    uint64_t rows = 0;
+    uint64_t columns = 0;
+    int pass;
+
+    bench_create(&bench, n);
+
+    // the first pass writes every row: don't count it
+    bench_pass(&bench, 0);
+    ovsdb_stub_get_stats(&stats);
+
+    for (pass = 1; pass <= passes; pass++) {
+        long long when = (long long)pass * POLLING_PERIOD * MSEC_PER_SEC;
+        uint64_t start_allocs = n_allocs;
+        long long start = bench_nsec();
+        long long elapsed;
+
+        bench_pass(&bench, when);
+
+        elapsed = bench_nsec() - start;
+        allocs += n_allocs - start_allocs;
+        total += elapsed;
+        min = elapsed < min ? elapsed : min;
+        max = elapsed > max ? elapsed : max;
+
+        ovsdb_stub_get_stats(&stats);
+        rows += stats.n_rows;
+        columns += stats.n_columns;
+    }
+
+    fprintf(output, "{\"benchmark\": \"pass\", \"sensors\": %d, "
+            "\"passes\": %d, \"pass_ns_mean\": %lld, \"pass_ns_min\": %lld, "
+            "\"pass_ns_max\": %lld, \"ns_per_sensor\": %.1f, "
+            "\"allocs_per_pass\": %.1f, \"rows_touched_per_pass\": %.1f, "
+            "\"columns_written_per_pass\": %.1f}\n",
+            n, passes, total / passes, min, max,
+            (double)total / ((double)n * passes),
+            (double)allocs / passes, (double)rows / passes,
+            (double)columns / passes);
+
+    bench_destroy(&bench);
+}
+
+static void
+usage(void)
+{
+    printf("%s: benchmark of the ops-tempd sensor pipeline\n"
+           "usage: %s [OPTIONS]\n"
+           "\nOptions:\n"
+           "  --sensors=N[,N...]      sensor counts to run "
+           "(default: %s)\n"
+           "  --passes=N              passes timed per sensor count "
+           "(default: %d)\n"
+           "  --output=FILE           write results to FILE "
+           "(default: stdout)\n"
+           "  -h, --help              display this help message\n",
+           program_name, program_name, BENCH_SENSORS, BENCH_PASSES);
+    exit(EXIT_SUCCESS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    enum {
+        OPT_SENSORS = UCHAR_MAX + 1,
+        OPT_PASSES,
+        OPT_OUTPUT,
+    };
+    static const struct option long_options[] = {
+        {"help",        no_argument, NULL, 'h'},
+        {"sensors",     required_argument, NULL, OPT_SENSORS},
+        {"passes",      required_argument, NULL, OPT_PASSES},
+        {"output",      required_argument, NULL, OPT_OUTPUT},
+        {NULL, 0, NULL, 0},
+    };
+    char *sensors = xstrdup(BENCH_SENSORS);
+    int passes = BENCH_PASSES;
+    FILE *output = stdout;
+    char *save = NULL;
+    char *token;
+
+    set_program_name(argv[0]);
+    vlog_set_levels(NULL, VLF_ANY_DESTINATION, VLL_WARN);
+
+    for (;;) {
+        int c = getopt_long(argc, argv, "h", long_options, NULL);
+
+        if (c == -1) {
+            break;
+        }
+
+        switch (c) {
+        case 'h':
+            usage();
+
+        case OPT_SENSORS:
+            free(sensors);
+            sensors = xstrdup(optarg);
+            break;
+
+        case OPT_PASSES:
+            if (!str_to_int(optarg, 10, &passes) || passes < 1) {
+                ovs_fatal(0, "--passes must be a positive number");
+            }
+            break;
+
+        case OPT_OUTPUT:
+            output = fopen(optarg, "w");
+            if (output == NULL) {
+                ovs_fatal(errno, "%s: open failed", optarg);
+            }
+            break;
+
+        case '?':
+            exit(EXIT_FAILURE);
+
+        default:
+            abort();
+        }
+    }
+
+    for (token = strtok_r(sensors, ",", &save); token != NULL;
+            token = strtok_r(NULL, ",", &save)) {
+        int n;
+
+        if (!str_to_int(token, 10, &n) || n < 1) {
+            ovs_fatal(0, "invalid sensor count \"%s\"", token);
+        }
+        bench_evaluate(output, n);
+        bench_passes(output, n, passes);
+        fflush(output);
+    }
+
+    free(sensors);
+    if (output != stdout) {
+        fclose(output);
+    }
+    return(0);
+}
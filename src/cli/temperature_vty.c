@@ -24,6 +24,12 @@
  */
 
 #include <sys/wait.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "vtysh/command.h"
 #include "memory.h"
 #include "vtysh/vtysh.h"
@@ -38,54 +44,388 @@
 VLOG_DEFINE_THIS_MODULE(vtysh_temperature_cli);
 extern struct ovsdb_idl *idl;
 
+/*
+ * Function     : vtysh_ovsdb_show_temp_windows
+ * Responsibility : display the rolling minimum, maximum and average
+ *                  temperatures that ops-tempd publishes for a sensor
+ *                  (external_ids min_<window>, max_<window>, avg_<window>)
+ */
+
+static void
+vtysh_ovsdb_show_temp_windows (const struct ovsrec_temp_sensor *row)
+{
+    const struct smap_node **nodes;
+    size_t idx;
+
+    nodes = smap_sort(&row->external_ids);
+    for (idx = 0; idx < smap_count(&row->external_ids); idx++)
+    {
+        const char *window;
+        const char *min;
+        const char *avg;
+        char key[32];
+        char title[32];
+
+        if (strncmp(nodes[idx]->key, "max_", 4) != 0)
+        {
+            continue;
+        }
+        window = nodes[idx]->key + 4;
+        snprintf(key, sizeof(key), "min_%s", window);
+        min = smap_get(&row->external_ids, key);
+        snprintf(key, sizeof(key), "avg_%s", window);
+        avg = smap_get(&row->external_ids, key);
+        if (min == NULL || avg == NULL)
+        {
+            continue;
+        }
+
+        snprintf(title, sizeof(title), "Last %s min/max/avg(in C)", window);
+        vty_out(vty,"%-26s:%.2f/%.2f/%.2f%s", title,
+                (atoi(min)/1000.0), (atoi(nodes[idx]->value)/1000.0),
+                (atoi(avg)/1000.0), VTY_NEWLINE);
+    }
+    free(nodes);
+}
+
+/* Sensor statuses written by ops-tempd, least to most severe */
+static const char *temp_status_severity[] = {
+    "uninitialized",
+    "normal",
+    "min",
+    "max",
+    "low_critical",
+    "critical",
+    "fault",
+    "emergency"
+};
+
+#define TEMP_STATUS_COUNT \
+    (sizeof(temp_status_severity)/sizeof(temp_status_severity[0]))
+
+/* Which sensors to display, and in what order */
+struct temp_sensor_filter {
+    const char *subsystem;      /* subsystem name, or NULL for all */
+    const char *status;         /* status, or NULL for all */
+    bool above;                 /* only sensors at or above min_temp */
+    int64_t min_temp;           /* milidegrees */
+    int top;                    /* hottest top sensors only, or 0 for all */
+};
+
+/* A displayed sensor, and the subsystem that owns it */
+struct temp_sensor_entry {
+    const struct ovsrec_temp_sensor *row;
+    const struct ovsrec_subsystem *subsystem;
+};
+
+/* Severity of a status string: unknown strings rank as uninitialized */
+static size_t
+temp_status_rank (const char *status)
+{
+    size_t idx;
+
+    for (idx = 0; idx < TEMP_STATUS_COUNT; idx++)
+    {
+        if (strcmp(status, temp_status_severity[idx]) == 0)
+        {
+            return idx;
+        }
+    }
+    return 0;
+}
+
+/* Compare names with runs of digits taken as numbers, so that base-2
+ * comes before base-10 */
+static int
+temp_name_compare (const char *a, const char *b)
+{
+    while (*a != '\0' && *b != '\0')
+    {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b))
+        {
+            unsigned long long na = strtoull(a, (char **)&a, 10);
+            unsigned long long nb = strtoull(b, (char **)&b, 10);
+
+            if (na != nb)
+            {
+                return na < nb ? -1 : 1;
+            }
+        }
+        else if (*a != *b)
+        {
+            return (unsigned char)*a - (unsigned char)*b;
+        }
+        else
+        {
+            a++;
+            b++;
+        }
+    }
+    return (unsigned char)*a - (unsigned char)*b;
+}
+
+/* Order by subsystem, then by sensor name */
+static int
+temp_entry_compare_name (const void *a_, const void *b_)
+{
+    const struct temp_sensor_entry *a = a_;
+    const struct temp_sensor_entry *b = b_;
+    int cmp = temp_name_compare(a->subsystem->name, b->subsystem->name);
+
+    return cmp != 0 ? cmp : temp_name_compare(a->row->name, b->row->name);
+}
+
+/* Hottest first, then by name */
+static int
+temp_entry_compare_temp (const void *a_, const void *b_)
+{
+    const struct temp_sensor_entry *a = a_;
+    const struct temp_sensor_entry *b = b_;
+
+    if (a->row->temperature != b->row->temperature)
+    {
+        return a->row->temperature > b->row->temperature ? -1 : 1;
+    }
+    return temp_entry_compare_name(a_, b_);
+}
+
+/* Order subsystems by name */
+static int
+temp_subsystem_compare (const void *a_, const void *b_)
+{
+    const struct ovsrec_subsystem *const *a = a_;
+    const struct ovsrec_subsystem *const *b = b_;
+
+    return temp_name_compare((*a)->name, (*b)->name);
+}
+
+/*
+ * Function     : vtysh_ovsdb_collect_temp_sensors
+ * Responsibility : gather the sensors that match a filter, from the
+ *                  temp_sensors of each subsystem, and sort them
+ * Parameters
+ *    filter   : sensors to keep, and whether to sort by temperature
+ *    entriesp : set to an array of the matching sensors (freed by caller)
+ * Returns the number of sensors in the array, or -1 if it can't be
+ * allocated
+ */
+
+static int
+vtysh_ovsdb_collect_temp_sensors (const struct temp_sensor_filter *filter,
+                                  struct temp_sensor_entry **entriesp)
+{
+    const struct ovsrec_subsystem *subsystem;
+    struct temp_sensor_entry *entries;
+    size_t total = 0;
+    int n = 0;
+    size_t idx;
+
+    OVSREC_SUBSYSTEM_FOR_EACH (subsystem, idl)
+    {
+        total += subsystem->n_temp_sensors;
+    }
+
+    entries = calloc(total > 0 ? total : 1, sizeof(*entries));
+    if (entries == NULL)
+    {
+        return -1;
+    }
+
+    OVSREC_SUBSYSTEM_FOR_EACH (subsystem, idl)
+    {
+        if (filter->subsystem != NULL &&
+            strcmp(subsystem->name, filter->subsystem) != 0)
+        {
+            continue;
+        }
+        for (idx = 0; idx < subsystem->n_temp_sensors; idx++)
+        {
+            const struct ovsrec_temp_sensor *row = subsystem->temp_sensors[idx];
+
+            if (filter->status != NULL &&
+                strcmp(row->status, filter->status) != 0)
+            {
+                continue;
+            }
+            if (filter->above && row->temperature < filter->min_temp)
+            {
+                continue;
+            }
+            entries[n].row = row;
+            entries[n].subsystem = subsystem;
+            n++;
+        }
+    }
+
+    if (filter->top > 0)
+    {
+        qsort(entries, n, sizeof(*entries), temp_entry_compare_temp);
+        if (n > filter->top)
+        {
+            n = filter->top;
+        }
+    }
+    else
+    {
+        qsort(entries, n, sizeof(*entries), temp_entry_compare_name);
+    }
+
+    *entriesp = entries;
+    return n;
+}
+
 /*
  * Function     : vtysh_ovsdb_show_temp_sensor
  * Responsibility : display temperature sensor information
  * Parameters
  *    detail   : boolean param to decide whether detailed description or brief
  description
+ *    filter   : sensors to display
  */
 
+static int
+vtysh_ovsdb_show_temp_sensor (boolean detail,
+                              const struct temp_sensor_filter *filter)
+{
+    struct temp_sensor_entry *entries;
+    int n;
+    int idx;
+
+    n = vtysh_ovsdb_collect_temp_sensors(filter, &entries);
+    if (n < 0)
+    {
+        VLOG_ERR("Unable to allocate the Temp_sensor table rows");
+        return CMD_WARNING;
+    }
+
+    for (idx = 0; idx < n; idx++)
+    {
+        const struct ovsrec_temp_sensor *row = entries[idx].row;
+
+        if (!detail)
+        {
+            vty_out (vty,"%-10s%-15.2f%-15s%-10s%s",
+                    row->name,((row->temperature)/1000.0),
+                    row->status, row->fan_state,VTY_NEWLINE);
+        }
+        else
+        {
+            vty_out(vty,"%-26s:%s %s","Name",row->name,VTY_NEWLINE);
+            vty_out(vty,"%-26s:%s %s","Location",row->location,
+                    VTY_NEWLINE);
+            vty_out(vty,"%-26s:%s %s","Status",row->status,VTY_NEWLINE);
+            vty_out(vty,"%-26s:%s %s",
+                    "Fan-state",row->fan_state,VTY_NEWLINE);
+            vty_out(vty,"%-26s:%.2f%s",
+                    "Current temperature(in C)",
+                    ((row->temperature)/1000.0),VTY_NEWLINE);
+            vty_out(vty,"%-26s:%.2f%s",
+                    "Minimum temperature(in C)",
+                    ((row->min)/1000.0),VTY_NEWLINE);
+            vty_out(vty,"%-26s:%.2f%s",
+                    "Maximum temperature(in C)",
+                    ((row->max)/1000.0),VTY_NEWLINE);
+            vtysh_ovsdb_show_temp_windows (row);
+            vty_out(vty,"%s",VTY_NEWLINE);
+        }
+    }
+    free(entries);
+    return CMD_SUCCESS;
+}
+
+/* Print the header of the brief sensor list */
 static void
-vtysh_ovsdb_show_temp_sensor (boolean detail)
+vtysh_show_temp_brief_header (void)
 {
-    const struct ovsrec_temp_sensor *row;
-    OVSREC_TEMP_SENSOR_FOR_EACH (row, idl)
+    vty_out(vty,"%s%s","Temperature information",VTY_NEWLINE);
+    vty_out(vty,"---------------------------------------------------%s",
+            VTY_NEWLINE);
+    vty_out(vty,"%-12s%-9s%s"," ","Current",VTY_NEWLINE);
+    vty_out(vty,"%-10s%-15s%-15s%-10s%s","Name","temperature",
+            "Status","Fan state",VTY_NEWLINE);
+    vty_out(vty,"%-12s%-6s%s"," ","(in C)",VTY_NEWLINE);
+    vty_out(vty,"---------------------------------------------------%s",
+            VTY_NEWLINE);
+}
+
+/* Print the header of the detailed sensor list */
+static void
+vtysh_show_temp_detail_header (void)
+{
+    vty_out(vty,"%s%s","Detailed temperature information",VTY_NEWLINE);
+    vty_out(vty,"---------------------------------------------------%s",
+            VTY_NEWLINE);
+}
+
+/*
+ * Function     : vtysh_ovsdb_show_temp_summary
+ * Responsibility : display one line per subsystem: its sensor count, the
+ *                  most severe status of its sensors, and its hottest
+ *                  sensor, in order of subsystem name
+ */
+
+static int
+vtysh_ovsdb_show_temp_summary (void)
+{
+    const struct ovsrec_subsystem *subsystem;
+    const struct ovsrec_subsystem **subsystems;
+    size_t n = 0;
+    size_t sub;
+
+    OVSREC_SUBSYSTEM_FOR_EACH (subsystem, idl)
+    {
+        n++;
+    }
+    subsystems = calloc(n > 0 ? n : 1, sizeof(*subsystems));
+    if (subsystems == NULL)
+    {
+        VLOG_ERR("Unable to allocate the Subsystem table rows");
+        return CMD_WARNING;
+    }
+    n = 0;
+    OVSREC_SUBSYSTEM_FOR_EACH (subsystem, idl)
     {
-        if (row)
+        subsystems[n++] = subsystem;
+    }
+    qsort(subsystems, n, sizeof(*subsystems), temp_subsystem_compare);
+
+    for (sub = 0; sub < n; sub++)
+    {
+        const struct ovsrec_temp_sensor *hottest = NULL;
+        size_t worst = 0;
+        size_t idx;
+
+        subsystem = subsystems[sub];
+        for (idx = 0; idx < subsystem->n_temp_sensors; idx++)
         {
-            if (!detail)
+            const struct ovsrec_temp_sensor *row = subsystem->temp_sensors[idx];
+            size_t rank = temp_status_rank(row->status);
+
+            if (rank > worst)
             {
-                vty_out (vty,"%-10s%-15.2f%-15s%-10s%s",
-                        row->name,((row->temperature)/1000.0),
-                        row->status, row->fan_state,VTY_NEWLINE);
+                worst = rank;
             }
-            else
+            if (hottest == NULL || row->temperature > hottest->temperature)
             {
-                vty_out(vty,"%-26s:%s %s","Name",row->name,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s","Location",row->location,
-                        VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s","Status",row->status,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%s %s",
-                        "Fan-state",row->fan_state,VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Current temperature(in C)",
-                        ((row->temperature)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Minimum temperature(in C)",
-                        ((row->min)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%-26s:%.2f%s",
-                        "Maximum temperature(in C)",
-                        ((row->max)/1000.0),VTY_NEWLINE);
-                vty_out(vty,"%s",VTY_NEWLINE);
+                hottest = row;
             }
         }
-        else
+
+        if (hottest == NULL)
         {
-            VLOG_ERR("Unable to retrieve Temp_sensor table rows");
+            vty_out(vty,"%-15s%-9s%-15s%s",
+                    subsystem->name,"0","-",VTY_NEWLINE);
+            continue;
         }
+        vty_out(vty,"%-15s%-9zu%-15s%-15.2f%-10s%s",
+                subsystem->name,subsystem->n_temp_sensors,
+                temp_status_severity[worst],
+                ((hottest->temperature)/1000.0),hottest->name,VTY_NEWLINE);
     }
+    free(subsystems);
+    return CMD_SUCCESS;
 }
+
 DEFUN (vtysh_show_system_temperature_detail,
         vtysh_show_system_temperature_detail_cmd,
         "show system temperature detail",
@@ -94,11 +434,10 @@ DEFUN (vtysh_show_system_temperature_detail,
         TEMP_STR
         TEMP_DETAIL_STR)
 {
-    vty_out(vty,"%s%s","Detailed temperature information",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vtysh_ovsdb_show_temp_sensor (true);
-    return CMD_SUCCESS;
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    vtysh_show_temp_detail_header();
+    return vtysh_ovsdb_show_temp_sensor (true, &filter);
 }
 
 DEFUN (vtysh_show_system_temperature,
@@ -108,17 +447,111 @@ DEFUN (vtysh_show_system_temperature,
         SYS_STR
         TEMP_STR)
 {
-    vty_out(vty,"%s%s","Temperature information",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vty_out(vty,"%-12s%-9s%s"," ","Current",VTY_NEWLINE);
-    vty_out(vty,"%-10s%-15s%-15s%-10s%s","Name","temperature",
-            "Status","Fan state",VTY_NEWLINE);
-    vty_out(vty,"%-12s%-6s%s"," ","(in C)",VTY_NEWLINE);
-    vty_out(vty,"---------------------------------------------------%s",
-            VTY_NEWLINE);
-    vtysh_ovsdb_show_temp_sensor (false);
-    return CMD_SUCCESS;
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    vtysh_show_temp_brief_header();
+    return vtysh_ovsdb_show_temp_sensor (false, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_subsystem,
+        vtysh_show_system_temperature_subsystem_cmd,
+        "show system temperature subsystem WORD",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_SUBSYSTEM_STR
+        TEMP_SUBSYSTEM_NAME_STR)
+{
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    filter.subsystem = argv[0];
+    vtysh_show_temp_brief_header();
+    return vtysh_ovsdb_show_temp_sensor (false, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_subsystem_detail,
+        vtysh_show_system_temperature_subsystem_detail_cmd,
+        "show system temperature subsystem WORD detail",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_SUBSYSTEM_STR
+        TEMP_SUBSYSTEM_NAME_STR
+        TEMP_DETAIL_STR)
+{
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    filter.subsystem = argv[0];
+    vtysh_show_temp_detail_header();
+    return vtysh_ovsdb_show_temp_sensor (true, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_status,
+        vtysh_show_system_temperature_status_cmd,
+        "show system temperature status "
+        "(uninitialized|normal|min|max|low_critical|critical|fault|emergency)",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_STATUS_STR
+        TEMP_STATUS_VALUES_STR)
+{
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    filter.status = argv[0];
+    vtysh_show_temp_brief_header();
+    return vtysh_ovsdb_show_temp_sensor (false, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_above,
+        vtysh_show_system_temperature_above_cmd,
+        "show system temperature above <0-200>",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_ABOVE_STR
+        TEMP_ABOVE_VALUE_STR)
+{
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    filter.above = true;
+    filter.min_temp = atoi(argv[0]) * 1000LL;
+    vtysh_show_temp_brief_header();
+    return vtysh_ovsdb_show_temp_sensor (false, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_top,
+        vtysh_show_system_temperature_top_cmd,
+        "show system temperature top <1-1000>",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_TOP_STR
+        TEMP_TOP_VALUE_STR)
+{
+    struct temp_sensor_filter filter = { NULL, NULL, false, 0, 0 };
+
+    filter.top = atoi(argv[0]);
+    vtysh_show_temp_brief_header();
+    return vtysh_ovsdb_show_temp_sensor (false, &filter);
+}
+
+DEFUN (vtysh_show_system_temperature_summary,
+        vtysh_show_system_temperature_summary_cmd,
+        "show system temperature summary",
+        SHOW_STR
+        SYS_STR
+        TEMP_STR
+        TEMP_SUMMARY_STR)
+{
+    vty_out(vty,"%s%s","Temperature summary",VTY_NEWLINE);
+    vty_out(vty,"-----------------------------------------------------------"
+            "---------%s",VTY_NEWLINE);
+    vty_out(vty,"%-15s%-9s%-15s%-15s%-10s%s","Subsystem","Sensors",
+            "Worst status","Max temp(in C)","Hottest",VTY_NEWLINE);
+    vty_out(vty,"-----------------------------------------------------------"
+            "---------%s",VTY_NEWLINE);
+    return vtysh_ovsdb_show_temp_summary();
 }
 
 /*******************************************************************
@@ -134,17 +567,21 @@ void tempd_ovsdb_init(void)
     /*Add temp_sensors into subsystem */
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_temp_sensors);
 
+    /* subsystem names, for filtering by subsystem and the summary */
+    ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
+
+    /* Only the columns that the show commands display. hw_config and
+     * other_config aren't used; external_ids has the rolling statistics
+     * shown by the detail commands. The IDL's columns are fixed once the
+     * CLI connects, so this is what all of the commands need. */
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_external_ids);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_hw_config);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_location);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_max);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_min);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_name);
-    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_other_config);;
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_status);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_temperature);
-
 }
 
 /* Initialize ops-tempd cli node.
@@ -162,4 +599,18 @@ void cli_post_init(void)
     install_element (ENABLE_NODE, &vtysh_show_system_temperature_cmd);
     install_element (VIEW_NODE, &vtysh_show_system_temperature_detail_cmd);
     install_element (ENABLE_NODE, &vtysh_show_system_temperature_detail_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_subsystem_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_subsystem_cmd);
+    install_element (VIEW_NODE,
+                     &vtysh_show_system_temperature_subsystem_detail_cmd);
+    install_element (ENABLE_NODE,
+                     &vtysh_show_system_temperature_subsystem_detail_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_status_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_status_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_above_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_above_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_top_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_top_cmd);
+    install_element (VIEW_NODE, &vtysh_show_system_temperature_summary_cmd);
+    install_element (ENABLE_NODE, &vtysh_show_system_temperature_summary_cmd);
 }
@@ -40,9 +40,14 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <errno.h>
+#include <fnmatch.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <malloc.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -55,8 +60,12 @@
 #include "dirs.h"
 #include "dummy.h"
 #include "fatal-signal.h"
+#include "hash.h"
+#include "heap.h"
+#include "ovsdb-condition.h"
 #include "ovsdb-idl.h"
 #include "poll-loop.h"
+#include "sha1.h"
 #include "simap.h"
 #include "stream-ssl.h"
 #include "stream.h"
@@ -70,45 +79,151 @@
 #include "coverage.h"
 #include "config-yaml.h"
 #include "tempd.h"
+#include "tempd_arena.h"
+#include "tempd_buslock.h"
+#include "tempd_claim.h"
+#include "tempd_i2cdev.h"
+#include "tempd_log.h"
+#include "tempd_metrics.h"
+#include "tempd_mirror.h"
+#include "tempd_probes.h"
+#include "tempd_publish.h"
+#include "tempd_record.h"
+#include "tempd_sensor.h"
+#include "tempd_sim.h"
+#include "tempd_stats.h"
+#include "tempd_virtual.h"
+#include "tempd_watchdog.h"
 #include "eventlog.h"
 
+VLOG_DEFINE_THIS_MODULE(ops_tempd);
+
+COVERAGE_DEFINE(tempd_reconfigure);
+
 static struct ovsdb_idl *idl;
 
 static unsigned int idl_seqno;
 
+// Temp_sensor rows are only replicated for our own sensors. The condition
+// is sent again whenever subsystems come or go, and new subsystems get
+// their rows once the server has applied it (see tempd_add_sensor_rows).
+static unsigned int sensor_cond_seqno;      // seqno of the latest condition
+static bool sensor_cond_changed = false;    // sensors added or removed
+static int n_rows_pending = 0;              // subsystems waiting for rows
+static unsigned int rows_claim_seqno = 0;   // claims when the rows were last
+                                            // created, if some subsystems
+                                            // were left unclaimed (else 0)
+
 static unixctl_cb_func tempd_unixctl_dump;
 
 static bool cur_hw_set = false;
 
+// events that can repeat for every sensor, logged through tempd_log_check
+static struct tempd_log_event sensor_down_event =
+    TEMPD_LOG_EVENT_INIT("Sensor not responding");
+static struct tempd_log_event sensor_up_event =
+    TEMPD_LOG_EVENT_INIT("Sensor responding again");
+static struct tempd_log_event bus_down_event =
+    TEMPD_LOG_EVENT_INIT("Bus not responding");
+static struct tempd_log_event bus_up_event =
+    TEMPD_LOG_EVENT_INIT("Bus responding again");
+static struct tempd_log_event stale_event =
+    TEMPD_LOG_EVENT_INIT("Sensor stale");
+static struct tempd_log_event fresh_event =
+    TEMPD_LOG_EVENT_INIT("Sensor fresh again");
+static struct tempd_log_event unrecognized_event =
+    TEMPD_LOG_EVENT_INIT("Unrecognized sensor type");
+static struct tempd_log_event unmatched_event =
+    TEMPD_LOG_EVENT_INIT("No sensor for Temp_sensor row");
+
+// emergency confirmation settings (see tempd_confirm_emergency)
+static int emergency_samples = EMERGENCY_CONFIRM_SAMPLES;
+static int emergency_votes = EMERGENCY_CONFIRM_VOTES;
+static int emergency_interval = EMERGENCY_CONFIRM_INTERVAL_MS;
+static bool emergency_correlate = false;
+
+// noise filter given to new sensors (see tempd_filter.h)
+static struct tempd_filter_config default_filter = { FILTER_NONE, 0 };
+
+// trend settings: readings in the fit, and how far ahead (seconds) to
+// raise the fan demand for a predicted threshold crossing (0 = never)
+static int trend_window = TREND_WINDOW;
+static int trend_lead = 0;
+
+// rolling statistics windows kept for each sensor
+static struct tempd_window_config window_config;
+
+// emergency watchdog thread settings (see tempd_watchdog.h)
+static bool watchdog_enabled = false;
+static int watchdog_period = WATCHDOG_PERIOD_MS;
+static int watchdog_priority = WATCHDOG_PRIORITY;
+static int watchdog_cpu = -1;
+
+// sensor read schedule: struct locl_sensor, earliest next_read first
+static struct heap read_schedule;
+static unsigned int publish_seqno;  // idl seqno when the rows were mapped
+
+// sensors read since their rows were last published, in the order read
+static struct locl_sensor **dirty_sensors;
+static size_t n_dirty_sensors, allocated_dirty_sensors;
+static long long publish_time;      // time_msec() of the last publish
+
+// lm75-class device configuration (--lm75-resolution, --lm75-oneshot)
+static int lm75_resolution = 0;     // 0: leave as set
+static bool lm75_oneshot = false;
+
+// polling periods without a good reading before a sensor is stale
+static int stale_periods = STALE_PERIODS;
+
+// advisory bus locks (--bus-lock-dir)
+static const char *bus_lock_dir = NULL;
+
+// buses accessed through i2c-dev (--i2c-dev): bus name to device path
+static struct shash i2c_devs = SHASH_INITIALIZER(&i2c_devs);
+
+// simulated sensors (--sim), replacing the h/w description files and i2c
+static const char *sim_file = NULL;
+static struct tempd_sim *sim = NULL;
+
+// virtual sensors (--virtual), computed from the physical ones. Their
+// inputs are already filtered, so they aren't filtered again.
+static const char *virtual_file = NULL;
+static struct tempd_virtual *virt = NULL;
+static const struct tempd_filter_config virtual_filter = { FILTER_NONE, 0 };
+
+// recording (--record) and replay (--replay) of raw sensor samples
+static const char *record_file = NULL;
+static int record_size = RECORD_MAX_SIZE_MB;
+static struct tempd_recorder *recorder = NULL;
+static const char *replay_file = NULL;
+static const char *replay_output_file = NULL;
+static struct tempd_replay *replay = NULL;
+static FILE *replay_output = NULL;
+static struct tempd_record replay_record;   // next sample to replay
+static bool replay_pending = false;         // replay_record is valid
+static long long replay_start;              // time of the first sample
+static long long replay_time;               // time of the current sample
+static uint64_t replay_samples = 0;
+static uint64_t replay_unmatched = 0;       // samples of unknown sensors
+static bool replay_done = false;
+
+// OpenMetrics socket (--metrics)
+static const char *metrics_path = NULL;
+
+// hot standby (--mirror)
+static const char *mirror_path = NULL;
+
+// subsystems handled by this instance (--subsystems): globs, all if empty
+static struct svec shard_globs = SVEC_EMPTY_INITIALIZER;
+
 YamlConfigHandle yaml_handle;
+// h/w descriptions config-yaml has parsed: it can't drop a subsystem's, so
+// they're only freed on exit (see ops-tempd/memory)
+static size_t n_hw_desc_loaded = 0;
 
 struct shash sensor_data;       // struct locl_sensor (all sensors)
 struct shash subsystem_data;    // struct locl_subsystem
-
-// map sensorstatus enum to the equivalent string
-static const char *
-sensor_status_to_string(enum sensorstatus status)
-{
-    VLOG_DBG("sensor status is %d", status);
-    if (status < sizeof(sensor_status)/sizeof(const char *)) {
-        VLOG_DBG("sensor status is %s", sensor_status[status]);
-        return(sensor_status[status]);
-    } else {
-        VLOG_DBG("sensor status is %s", sensor_status[SENSOR_STATUS_UNINITIALIZED]);
-        return(sensor_status[SENSOR_STATUS_UNINITIALIZED]);
-    }
-}
-
-// map fanspeed enum to the equivalent string
-static const char *
-sensor_speed_to_string(enum fanspeed speed)
-{
-    if (speed < sizeof(fan_speed)/sizeof(const char *)) {
-        return(fan_speed[speed]);
-    } else {
-        return(fan_speed[SENSOR_FAN_NORMAL]);
-    }
-}
+struct shash bus_data;          // struct locl_bus
 
 // initialize the subsystem and global sensor dictionaries
 static void
@@ -116,6 +231,8 @@ init_subsystems(void)
 {
     shash_init(&subsystem_data);
     shash_init(&sensor_data);
+    shash_init(&bus_data);
+    heap_init(&read_schedule);
 }
 
 // find a sensor (in idl cache) by name
@@ -134,207 +251,562 @@ lookup_sensor(const char *name)
     return(NULL);
 }
 
-// read the lm75 temperature sensor
-// lm75 has a two-byte temperature output. The first byte is the temperature,
-// and the second byte's highest bit is a half-degree adder
+// current time for sensor processing. While replaying, this is the time of
+// the sample being replayed.
+static long long
+tempd_time_msec(void)
+{
+    return(replay != NULL ? replay_time : time_msec());
+}
+
+// write a line about a sensor to the replay transcript, stamped with the
+// replay time (relative to the start of the recording)
+static void OVS_PRINTF_FORMAT(2, 3)
+tempd_replay_log(const struct locl_sensor *sensor, const char *format, ...)
+{
+    long long offset = replay_time - replay_start;
+    va_list args;
+
+    fprintf(replay_output, "%lld.%03lld %s ", offset / MSEC_PER_SEC,
+            offset % MSEC_PER_SEC, sensor->name);
+    va_start(args, format);
+    vfprintf(replay_output, format, args);
+    va_end(args);
+    fputc('\n', replay_output);
+}
+
+// count a device read of an lm75 sensor, and record it (--record)
 static void
-lm75_read(struct locl_sensor *sensor)
+lm75_count_read(const struct locl_sensor *sensor, const char *buf, int rc)
 {
-    char buf[2];
-    int rc;
-    bool fault = false;
+    tempd_stats_count(STATS_READS, 1);
+    if (rc != 0) {
+        tempd_stats_count(STATS_FAULTS, 1);
+    }
+
+    if (recorder != NULL) {
+        tempd_recorder_sample(recorder, sensor->name, time_msec(), buf, rc);
+    }
+}
 
-    const YamlDevice *device = yaml_find_device(
-            yaml_handle,
-            sensor->subsystem->name,
-            sensor->yaml_sensor->device);
+// take a single raw sample of an lm75 sensor without changing any of the
+// sensor state. Returns 0 and the temperature (milidegrees) on success.
+static int
+lm75_read_raw(const struct locl_sensor *sensor, int *temp)
+{
+    char buf[2] = { 0, 0 };
+    int rc;
 
     if (sensor->test_temp != -1) {
-        VLOG_DBG("Test temperature override set to %d", sensor->test_temp);
-        sensor->status = SENSOR_STATUS_NORMAL;
-        sensor->temp = sensor->test_temp;
-        return;
+        *temp = sensor->test_temp;
+        return(0);
     }
 
-    rc = i2c_data_read(yaml_handle, device, sensor->subsystem->name, 0,
-                       sizeof(buf), buf);
+    if (replay != NULL) {
+        // the latest sample replayed for this sensor
+        memcpy(buf, sensor->replay_raw, sizeof(buf));
+        rc = sensor->replay_status;
+    } else {
+        struct tempd_buslock *lock = NULL;
+        long long start;
+
+        // the wait for the bus lock isn't part of the read time
+        if (sim == NULL && sensor->bus != NULL) {
+            lock = sensor->bus->lock;
+        }
+        if (lock != NULL) {
+            tempd_buslock_acquire(lock);
+        }
+
+        start = tempd_stats_start();
+        TEMPD_PROBE1(read_start, sensor->name);
+        if (sim != NULL) {
+            rc = tempd_sim_read(sim, sensor->yaml_sensor, sizeof(buf), buf);
+        } else if (sensor->bus != NULL && sensor->bus->i2cdev != NULL) {
+            rc = tempd_i2cdev_read(sensor->bus->i2cdev,
+                                   sensor->yaml_device->address,
+                                   LM75_REG_TEMP, sizeof(buf), buf);
+        } else {
+            rc = i2c_data_read(yaml_handle, sensor->yaml_device,
+                               sensor->subsystem->name, LM75_REG_TEMP,
+                               sizeof(buf), buf);
+        }
+        TEMPD_PROBE3(read_end, sensor->name, rc,
+                     ((unsigned char)buf[0] << 8) | (unsigned char)buf[1]);
+        if (lock != NULL) {
+            tempd_buslock_release(lock);
+        }
+
+        tempd_stats_record(STATS_READ_TIME, start);
+        lm75_count_read(sensor, buf, rc);
+    }
 
     if (0 != rc) {
-        fault = true;
+        return(rc);
     }
 
-    if (true == fault) {
-        // if we've hit the retry limit, mark it as failed
-        if (sensor->fault_count > MAX_FAIL_RETRY) {
-            sensor->status = SENSOR_STATUS_FAILED;
+    *temp = lm75_decode(buf, sensor->lm75.resolution);
+    return(0);
+}
+
+// record the result of a sensor access in its circuit breaker
+static void
+tempd_sensor_breaker_record(struct locl_sensor *sensor, int rc, long long now)
+{
+    if (tempd_breaker_record(&sensor->breaker, rc, now)) {
+        if (sensor->breaker.state == BREAKER_OPEN) {
+            if (tempd_log_check(&sensor_down_event, sensor->name)) {
+                VLOG_WARN("Sensor %s is not responding, probing every %d ms",
+                          sensor->name, sensor->breaker.backoff);
+            }
+        } else if (tempd_log_check(&sensor_up_event, sensor->name)) {
+            VLOG_INFO("Sensor %s is responding again", sensor->name);
         }
-        // otherwise, don't change the temp or status, but increment the retry
-        // count
-        sensor->fault_count++;
-        return;
     }
+}
 
-    // if we succeeded in reading the temp, then clear the retry count
-    sensor->fault_count = 0;
+// access one of an lm75-class device's other registers, holding the bus
+// lock. Returns 0 on success, like i2c_data_read.
+static int
+lm75_register_io(const struct locl_sensor *sensor, int reg, bool write,
+                 int length, char *buf)
+{
+    struct tempd_buslock *lock = NULL;
+    int rc;
 
-    if (sensor->status == SENSOR_STATUS_FAILED) {
-        // we need to kick this sensor back into a working state
-        sensor->status = SENSOR_STATUS_NORMAL;
+    if (sensor->bus != NULL) {
+        lock = sensor->bus->lock;
+    }
+    if (lock != NULL) {
+        tempd_buslock_acquire(lock);
     }
 
-    // convert to milidegrees (C)
-    sensor->temp = buf[0] * MILI_DEGREES;
+    if (sensor->bus != NULL && sensor->bus->i2cdev != NULL) {
+        rc = write ? tempd_i2cdev_write(sensor->bus->i2cdev,
+                                        sensor->yaml_device->address, reg,
+                                        length, buf)
+                   : tempd_i2cdev_read(sensor->bus->i2cdev,
+                                       sensor->yaml_device->address, reg,
+                                       length, buf);
+    } else if (write) {
+        rc = i2c_data_write(yaml_handle, sensor->yaml_device,
+                            sensor->subsystem->name, reg, length, buf);
+    } else {
+        rc = i2c_data_read(yaml_handle, sensor->yaml_device,
+                           sensor->subsystem->name, reg, length, buf);
+    }
 
-    // high bit in second byte is half-degree indicator
-    if (buf[1] < 0) {
-        // half-degree in milidegrees
-        sensor->temp += 500;
+    if (lock != NULL) {
+        tempd_buslock_release(lock);
     }
 
-    VLOG_DBG("%s: %4.1fc", sensor->yaml_sensor->device, ((float)sensor->temp)/MILI_DEGREES_FLOAT);
+    return(rc);
 }
 
-// read sensor temperature and calculate status/fan speed setting
+// look up what an lm75-class device can do, and configure its resolution
+// (--lm75-resolution) and one-shot conversions (--lm75-oneshot). If the
+// configuration can't be read or written, the device is left as it is.
 static void
-tempd_read_sensor(struct locl_sensor *sensor)
+lm75_setup(struct locl_sensor *sensor, bool oneshot)
 {
-    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    struct tempd_lm75 *lm75 = &sensor->lm75;
+    char config;
+    int rc;
 
-    if (strcmp(yaml_sensor->type, "lm75") == 0) {
-        lm75_read(sensor);
-    } else {
-        VLOG_WARN("Unrecognized sensor type %s", yaml_sensor->type);
-        log_event("TEMP_SENSOR_UNRECOGNIZED", EV_KV("type",
-            "%s", yaml_sensor->type));
-        sensor->temp = DEFAULT_TEMP * MILI_DEGREES;
+    tempd_lm75_init(lm75, tempd_lm75_find_part(sensor->yaml_device->dev_type));
+    if (lm75->part == NULL || lm75->part->resolution != 0) {
+        // fixed resolution, and none of them have one-shot conversions
+        return;
     }
 
-    // recalculate alarm and fan state
+    rc = lm75_register_io(sensor, LM75_REG_CONFIG, false, 1, &config);
+    if (rc != 0) {
+        VLOG_WARN("Unable to read the configuration of sensor %s: %s",
+                  sensor->name, ovs_strerror(rc));
+        return;
+    }
 
-    // decreasing alarms
+    if (tempd_lm75_configure(lm75, config, lm75_resolution, oneshot)) {
+        char new_config = lm75->config;
 
-    if (SENSOR_STATUS_FAILED == sensor->status) {
-        // no temp to report, unable to read sensor
-        return;
+        rc = lm75_register_io(sensor, LM75_REG_CONFIG, true, 1, &new_config);
+        if (rc != 0) {
+            VLOG_WARN("Unable to configure sensor %s: %s",
+                      sensor->name, ovs_strerror(rc));
+            // carry on with whatever it's set to
+            tempd_lm75_configure(lm75, config, 0, false);
+            return;
+        }
     }
 
-    // adjust min and max values
-    if (sensor->min > sensor->temp) {
-        sensor->min = sensor->temp;
+    VLOG_DBG("Sensor %s: %s, %d bits%s", sensor->name, lm75->part->type,
+             lm75->resolution, lm75->oneshot ? ", one-shot" : "");
+}
+
+// take a one-shot sensor out of shutdown, converting continuously again
+static void
+lm75_restore(struct locl_sensor *sensor)
+{
+    char config = sensor->lm75.config & ~LM75_CONFIG_SHUTDOWN;
+
+    if (lm75_register_io(sensor, LM75_REG_CONFIG, true, 1, &config) != 0) {
+        VLOG_WARN("Unable to take sensor %s out of shutdown", sensor->name);
     }
+}
 
-    if (sensor->max < sensor->temp) {
-        sensor->max = sensor->temp;
+// whether a sensor's circuit breakers let its device be touched now. A
+// failed sensor is only touched when it's due for a probe; if the whole bus
+// isn't responding, we don't wait for it to time out again, but count a
+// fault without touching the device. (Each call can let a probe through.)
+static bool
+lm75_allow(struct locl_sensor *sensor, long long now)
+{
+    if (!tempd_breaker_allow(&sensor->breaker, now)) {
+        return(false);
     }
+    if (sensor->bus != NULL && !tempd_breaker_allow(&sensor->bus->breaker, now)) {
+        tempd_apply_sample(sensor, EIO, 0, now);
+        return(false);
+    }
+
+    return(true);
+}
+
+// start a one-shot conversion for a sensor's next read. Returns 0 if it
+// was started, or if the read will be skipped anyway.
+static int
+lm75_start_conversion(struct locl_sensor *sensor, long long now)
+{
+    char config = sensor->lm75.config | LM75_CONFIG_ONESHOT;
 
-    // decreasing alarms
-    if (SENSOR_STATUS_EMERGENCY == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.emergency_off) {
-        sensor->status = SENSOR_STATUS_CRITICAL;
+    sensor->lm75.converting = true;
+    sensor->lm75.ready = now + tempd_lm75_conversion_ms(&sensor->lm75);
+    if (sensor->test_temp != -1) {
+        sensor->lm75.allowed = false;
+        return(0);
     }
 
-    if (SENSOR_STATUS_CRITICAL == sensor->status &&
-            (float)sensor->temp /MILI_DEGREES_FLOAT<= yaml_sensor->alarm_thresholds.critical_off) {
-        sensor->status = SENSOR_STATUS_MAX;
+    // the breakers are asked once for the conversion and its read (asking
+    // again could let a second probe through, or count one twice)
+    sensor->lm75.allowed = lm75_allow(sensor, now);
+    if (!sensor->lm75.allowed) {
+        // lm75_read doesn't touch the device either
+        return(0);
     }
 
-    if (SENSOR_STATUS_MAX == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.max_off) {
+    return(lm75_register_io(sensor, LM75_REG_CONFIG, true, 1, &config));
+}
+
+// read the lm75 temperature sensor
+static void
+lm75_read(struct locl_sensor *sensor)
+{
+    long long now = tempd_time_msec();
+    char batch_raw[2];
+    int batch_rc;
+    int temp = 0;
+    int rc;
+
+    // (taken first: if the breakers turn the read down, the result of a
+    // batch read in this pass mustn't be picked up on a later one)
+    batch_rc = tempd_take_batch(sensor, batch_raw);
+
+    if (sensor->test_temp != -1) {
+        VLOG_DBG("Test temperature override set to %d", sensor->test_temp);
         sensor->status = SENSOR_STATUS_NORMAL;
+        sensor->temp = sensor->test_temp;
+        sensor->raw_temp = sensor->test_temp;
+        sensor->sample_time = now;
+        tempd_trend_add(&sensor->trend, now, sensor->temp);
+        tempd_add_to_windows(sensor, now);
+        return;
     }
 
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.low_crit) {
-        sensor->status = SENSOR_STATUS_MIN;
+    // (a one-shot sensor's breakers were asked when its conversion was
+    // started)
+    if (sensor->lm75.oneshot ? !sensor->lm75.allowed
+                             : !lm75_allow(sensor, now)) {
+        return;
     }
 
-    if (SENSOR_STATUS_MIN == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.min) {
-        sensor->status = SENSOR_STATUS_NORMAL;
+    if (batch_rc != -1) {
+        // already read, along with the other sensors due on its bus
+        rc = batch_rc;
+        TEMPD_PROBE3(batch_read, sensor->name, rc,
+                     ((unsigned char)batch_raw[0] << 8) |
+                     (unsigned char)batch_raw[1]);
+        if (rc == 0) {
+            temp = lm75_decode(batch_raw, sensor->lm75.resolution);
+        }
+        lm75_count_read(sensor, batch_raw, rc);
+    } else {
+        rc = lm75_read_raw(sensor, &temp);
+    }
+    now = tempd_time_msec();
+
+    tempd_sensor_breaker_record(sensor, rc, now);
+    if (sensor->bus != NULL &&
+            tempd_breaker_record(&sensor->bus->breaker, rc, now)) {
+        if (sensor->bus->breaker.state == BREAKER_OPEN) {
+            if (tempd_log_check(&bus_down_event, sensor->bus->name)) {
+                VLOG_WARN("Bus %s is not responding, probing every %d ms",
+                          sensor->bus->name, sensor->bus->breaker.backoff);
+            }
+        } else if (tempd_log_check(&bus_up_event, sensor->bus->name)) {
+            VLOG_INFO("Bus %s is responding again", sensor->bus->name);
+        }
+    }
+
+    tempd_apply_sample(sensor, rc, temp, now);
+}
+
+// take a single raw sample of any supported sensor type, leaving the
+// sensor state untouched. Returns 0 on success.
+static int
+tempd_sample_sensor(const struct locl_sensor *sensor, int *temp)
+{
+    if (strcmp(sensor->yaml_sensor->type, "lm75") == 0) {
+        return(lm75_read_raw(sensor, temp));
+    }
+
+    return(EINVAL);
+}
+
+// read sensor temperature and calculate status/fan speed setting
+static void
+tempd_read_sensor(struct locl_sensor *sensor)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    struct tempd_watchdog_sample sample;
+    enum sensorstatus old_status = sensor->status;
+    long long old_sample_time = sensor->sample_time;
+    int old_temp = sensor->temp;
+
+    // virtual sensors are evaluated after the physical ones have been read
+    if (sensor->virtual != NULL) {
+        return;
     }
 
-    // increasing alarms
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.max_on) {
-        sensor->status = SENSOR_STATUS_MAX;
+    if (sensor->watchdog_slot >= 0) {
+        // the watchdog thread owns this sensor: use its latest reading, if
+        // there's a new one
+        if (!tempd_watchdog_get(sensor->watchdog_slot, &sample) ||
+                sample.count == sensor->watchdog_count) {
+            return;
+        }
+        sensor->watchdog_count = sample.count;
+        tempd_apply_sample(sensor, sample.rc, sample.temp, sample.when);
+    } else if (strcmp(yaml_sensor->type, "lm75") == 0) {
+        lm75_read(sensor);
+    } else {
+        // reported when the sensor was added
+        sensor->temp = DEFAULT_TEMP * MILI_DEGREES;
+        sensor->raw_temp = sensor->temp;
     }
 
-    if (SENSOR_STATUS_MAX == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.critical_on) {
-        sensor->status = SENSOR_STATUS_CRITICAL;
+    tempd_evaluate_sensor(sensor, trend_lead);
+
+    // (a new reading, even of the same temperature, keeps the virtual
+    // sensors using it fresh)
+    if (sensor->virtual_users != NULL &&
+            (sensor->temp != old_temp || sensor->status != old_status ||
+             sensor->sample_time != old_sample_time)) {
+        tempd_virtual_touch(sensor);
+    }
+}
+
+// confirm an emergency reading using a burst of raw samples. The burst does
+// not change any sensor state (temperature, min/max, status or fault count).
+// The reading is confirmed when at least emergency_votes of the
+// emergency_samples taken are at or above the emergency threshold. Samples
+// that fail to read don't vote either way. If emergency_correlate is set,
+// the other sensors in the subsystem are sampled in the same burst and at
+// least one of them must be at or above its critical threshold.
+static bool
+tempd_confirm_emergency__(struct locl_subsystem *subsystem,
+                          struct locl_sensor *sensor, int *votesp)
+{
+    struct shash_node *node;
+    int sample;
+    int temp;
+    int votes = 0;
+    int failed = 0;
+    int peers = 0;
+    int peer_votes = 0;
+    float emergency_on = sensor->yaml_sensor->alarm_thresholds.emergency_on;
+
+    for (sample = 0; sample < emergency_samples; sample++) {
+        if (sample != 0 && replay == NULL) {
+            usleep(emergency_interval * 1000);
+        }
+
+        if (tempd_sample_sensor(sensor, &temp) != 0) {
+            failed++;
+        } else if ((float)temp/MILI_DEGREES_FLOAT >= emergency_on) {
+            votes++;
+        }
+
+        if (!emergency_correlate) {
+            continue;
+        }
+
+        SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+            struct locl_sensor *peer = (struct locl_sensor *)node->data;
+
+            if (peer == sensor || tempd_sample_sensor(peer, &temp) != 0) {
+                continue;
+            }
+            peers++;
+            if ((float)temp/MILI_DEGREES_FLOAT >=
+                    peer->yaml_sensor->alarm_thresholds.critical_on) {
+                peer_votes++;
+            }
+        }
     }
 
-    if (SENSOR_STATUS_CRITICAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.emergency_on) {
-        sensor->status = SENSOR_STATUS_EMERGENCY;
+    VLOG_INFO("Emergency confirmation for sensor %s: %d of %d samples over "
+              "threshold (%d failed), %d of %d peer samples over critical",
+              sensor->name, votes, emergency_samples, failed,
+              peer_votes, peers);
+    *votesp = votes;
+
+    if (votes < emergency_votes) {
+        return(false);
     }
 
-    if (SENSOR_STATUS_NORMAL == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.min) {
-        sensor->status = SENSOR_STATUS_MIN;
+    // a subsystem without readable peers can't be correlated
+    if (emergency_correlate && peers != 0 && peer_votes == 0) {
+        return(false);
     }
 
-    if (SENSOR_STATUS_MIN == sensor->status &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.low_crit) {
-        sensor->status = SENSOR_STATUS_LOWCRIT;
+    return(true);
+}
+
+static bool
+tempd_confirm_emergency(struct locl_subsystem *subsystem,
+                        struct locl_sensor *sensor)
+{
+    bool confirmed;
+    int votes = 0;
+
+    TEMPD_PROBE1(confirm_start, sensor->name);
+    confirmed = tempd_confirm_emergency__(subsystem, sensor, &votes);
+    TEMPD_PROBE3(confirm_end, sensor->name, votes, confirmed);
+
+    return(confirmed);
+}
+
+// power off the system due to an emergency overtemp on a sensor
+static void
+tempd_emergency_shutdown(const struct locl_sensor *sensor)
+{
+    if (replay != NULL) {
+        tempd_replay_log(sensor, "emergency shutdown temp %d",
+                         sensor->raw_temp);
+        return;
     }
 
-    // calculate requested fan speed
-    if (SENSOR_FAN_NORMAL == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.medium_on) {
-        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    VLOG_WARN("Emergency shutdown initiated for sensor %s", sensor->name);
+    log_event("TEMP_SENSOR_SHUTDOWN", EV_KV("name", "%s", sensor->name));
+    if (sim != NULL) {
+        // simulated h/w: record the shutdown and carry on
+        tempd_sim_shutdown(sim);
+        return;
     }
+    system(EMERGENCY_POWEROFF);
+    // shouldn't continue
+    while (1) {
+        sleep(1000);
+    }
+}
 
-    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.fast_on) {
-        sensor->fan_speed = SENSOR_FAN_FAST;
+// watchdog read callback: raw sample of a sensor, through its circuit
+// breaker. The watchdog doesn't use the bus breakers, which belong to the
+// main loop.
+static int
+tempd_watchdog_read(void *sensor_, int *temp)
+{
+    struct locl_sensor *sensor = (struct locl_sensor *)sensor_;
+    int rc;
+
+    if (!tempd_breaker_allow(&sensor->breaker, time_msec())) {
+        return(EAGAIN);
     }
 
-    if (SENSOR_FAN_FAST == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.max_on) {
-        sensor->fan_speed = SENSOR_FAN_MAX;
+    rc = tempd_sample_sensor(sensor, temp);
+    tempd_sensor_breaker_record(sensor, rc, time_msec());
+    return(rc);
+}
+
+// watchdog check callback: confirm and act on an emergency reading
+static void
+tempd_watchdog_check(void *sensor_, int temp)
+{
+    struct locl_sensor *sensor = (struct locl_sensor *)sensor_;
+
+    if ((float)temp/MILI_DEGREES_FLOAT >=
+            sensor->yaml_sensor->alarm_thresholds.emergency_on &&
+            tempd_confirm_emergency(sensor->subsystem, sensor)) {
+        tempd_emergency_shutdown(sensor);
     }
+}
+
+// find or create the bus structure for a device
+static struct locl_bus *
+get_bus(const YamlDevice *device)
+{
+    struct locl_bus *bus;
 
-    if (SENSOR_FAN_MAX == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.max_off) {
-        sensor->fan_speed = SENSOR_FAN_FAST;
+    if (device == NULL || device->bus == NULL) {
+        return(NULL);
     }
 
-    if (SENSOR_FAN_FAST == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.fast_off) {
-        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    bus = (struct locl_bus *)shash_find_data(&bus_data, device->bus);
+    if (bus == NULL) {
+        bus = (struct locl_bus *)xzalloc(sizeof(struct locl_bus));
+        bus->name = xstrdup(device->bus);
+        tempd_breaker_init(&bus->breaker, BREAKER_BUS_TRIP);
+        if (bus_lock_dir != NULL) {
+            bus->lock = tempd_buslock_open(bus_lock_dir, bus->name);
+        }
+        if (sim == NULL && replay == NULL) {
+            const char *path = shash_find_data(&i2c_devs, bus->name);
+
+            if (path != NULL) {
+                bus->i2cdev = tempd_i2cdev_open(path);
+            }
+        }
+        shash_add(&bus_data, bus->name, (void *)bus);
     }
+    bus->n_sensors++;
 
-    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
-            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.medium_off) {
-        sensor->fan_speed = SENSOR_FAN_NORMAL;
+    return(bus);
+}
+
+// drop a sensor's reference to a bus, deleting the bus if it's unused
+static void
+put_bus(struct locl_bus *bus)
+{
+    if (bus == NULL || --bus->n_sensors > 0) {
+        return;
     }
+
+    shash_find_and_delete(&bus_data, bus->name);
+    tempd_buslock_close(bus->lock);
+    tempd_i2cdev_close(bus->i2cdev);
+    free(bus->name);
+    free(bus);
 }
 
-// create a new locl_subsystem object
-static struct locl_subsystem *
-add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+// load the h/w description files for a subsystem. Returns the number of
+// sensors in the subsystem, or -1 on error.
+static int
+load_hw_desc(const struct ovsrec_subsystem *ovsrec_subsys,
+             bool *emergency_shutdown)
 {
-    struct locl_subsystem *result;
-    int rc;
-    int idx;
-    struct ovsdb_idl_txn *txn;
-    struct ovsrec_temp_sensor **sensor_array;
-    int sensor_idx;
-    int sensor_count;
     const char *dir;
     const YamlThermalInfo *info;
-
-    // create and initialize basic subsystem information
-    VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
-    result = (struct locl_subsystem *)malloc(sizeof(struct locl_subsystem));
-    memset(result, 0, sizeof(struct locl_subsystem));
-    (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
-    result->name = strdup(ovsrec_subsys->name);
-    result->marked = false;
-    result->marked = true;
-    result->parent_subsystem = NULL;  // OPS_TODO: find parent subsystem
-    shash_init(&result->subsystem_sensors);
+    int rc;
 
     // use a default if the hw_desc_dir has not been populated
     dir = ovsrec_subsys->hw_desc_dir;
@@ -342,7 +814,7 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     if (dir == NULL || strlen(dir) == 0) {
         VLOG_ERR("No h/w description directory for subsystem %s",
                                         ovsrec_subsys->name);
-        return(NULL);
+        return(-1);
     }
 
     // since this is a new subsystem, load all of the hardware description
@@ -353,7 +825,7 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     if (rc != 0) {
         VLOG_ERR("Error reading h/w description files for subsystem %s",
                                         ovsrec_subsys->name);
-        return(NULL);
+        return(-1);
     }
 
     // need devices data
@@ -362,7 +834,7 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     if (rc != 0) {
         VLOG_ERR("Unable to parse subsystem %s devices file (in %s)",
                                         ovsrec_subsys->name, dir);
-        return(NULL);
+        return(-1);
     }
 
     // need thermal (sensor) data
@@ -371,100 +843,533 @@ add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     if (rc != 0) {
         VLOG_ERR("Unable to parse subsystem %s thermal file (in %s)",
                                         ovsrec_subsys->name, dir);
-        return(NULL);
+        return(-1);
     }
 
+    n_hw_desc_loaded++;
+
     // get the thermal info, need it for shutdown flag
     info = yaml_get_thermal_info(yaml_handle, ovsrec_subsys->name);
-    result->emergency_shutdown = info->auto_shutdown;
+    *emergency_shutdown = info->auto_shutdown;
 
     // OPS_TODO: the thermal info has a polling period, but when we
     // OPS_TODO: have multiple subsystems, that could be tricky to
     // OPS_TODO: implement if there are different polling periods.
     // OPS_TODO: For now, hardware the polling period to 5 seconds.
 
-    // prepare to add sensors to db
-    sensor_idx = 0;
-    sensor_count = yaml_get_sensor_count(yaml_handle, ovsrec_subsys->name);
+    return(yaml_get_sensor_count(yaml_handle, ovsrec_subsys->name));
+}
 
-    if (sensor_count <= 0) {
-        return(NULL);
-    }
+// commit a transaction and wait for the result, timing the round trip
+static void
+tempd_txn_commit(struct ovsdb_idl_txn *txn)
+{
+    long long start = tempd_stats_start();
+    enum ovsdb_idl_txn_status status OVS_UNUSED;
 
-    result->valid = true;
+    TEMPD_PROBE(commit_start);
+    status = ovsdb_idl_txn_commit_block(txn);
+    TEMPD_PROBE1(commit_end, status);
+    tempd_stats_record(STATS_COMMIT_TIME, start);
+}
 
-    // subsystem db object has reference array for sensors
-    sensor_array = (struct ovsrec_temp_sensor **)malloc(sensor_count * sizeof(struct ovsrec_temp_sensor *));
-    memset(sensor_array, 0, sensor_count * sizeof(struct ovsrec_temp_sensor *));
+// format a sensor's thresholds for ops-tempd/dump, in text and JSON, into
+// its subsystem's arena. They don't change while the sensor exists, so this
+// is only done once.
+static void
+tempd_format_thresholds(struct locl_sensor *sensor)
+{
+    struct tempd_arena *arena = sensor->subsystem->arena;
+    const YamlAlarmThresholds *alarm = &sensor->yaml_sensor->alarm_thresholds;
+    const YamlFanThresholds *fan = &sensor->yaml_sensor->fan_thresholds;
+    struct ds ds = DS_EMPTY_INITIALIZER;
 
-    txn = ovsdb_idl_txn_create(idl);
+    ds_put_format(&ds, "\t\tAlarm Thresholds: \n");
+    ds_put_format(&ds, "\t\t\temergency_on: %.2f\n", alarm->emergency_on);
+    ds_put_format(&ds, "\t\t\temergency_off: %.2f\n", alarm->emergency_off);
+    ds_put_format(&ds, "\t\t\tcritical_on: %.2f\n", alarm->critical_on);
+    ds_put_format(&ds, "\t\t\tcritical_off: %.2f\n", alarm->critical_off);
+    ds_put_format(&ds, "\t\t\tmax_on: %.2f\n", alarm->max_on);
+    ds_put_format(&ds, "\t\t\tmax_off: %.2f\n", alarm->max_off);
+    ds_put_format(&ds, "\t\t\tmin: %.2f\n", alarm->min);
+    ds_put_format(&ds, "\t\t\tlow_crit: %.2f\n", alarm->low_crit);
+    ds_put_format(&ds, "\t\tFan Thresholds: \n");
+    ds_put_format(&ds, "\t\t\tmax_on: %.2f\n", fan->max_on);
+    ds_put_format(&ds, "\t\t\tmax_off: %.2f\n", fan->max_off);
+    ds_put_format(&ds, "\t\t\tfast_on: %.2f\n", fan->fast_on);
+    ds_put_format(&ds, "\t\t\tfast_off: %.2f\n", fan->fast_off);
+    ds_put_format(&ds, "\t\t\tmedium_on: %.2f\n", fan->medium_on);
+    ds_put_format(&ds, "\t\t\tmedium_off: %.2f\n", fan->medium_off);
+    sensor->dump_thresholds = tempd_arena_strdup(arena, ds_cstr(&ds));
+    ds_clear(&ds);
+
+    ds_put_format(&ds, "{\"alarm\":{\"emergency_on\":%.2f,"
+                  "\"emergency_off\":%.2f,\"critical_on\":%.2f,"
+                  "\"critical_off\":%.2f,\"max_on\":%.2f,\"max_off\":%.2f,"
+                  "\"min\":%.2f,\"low_crit\":%.2f},",
+                  alarm->emergency_on, alarm->emergency_off,
+                  alarm->critical_on, alarm->critical_off, alarm->max_on,
+                  alarm->max_off, alarm->min, alarm->low_crit);
+    ds_put_format(&ds, "\"fan\":{\"max_on\":%.2f,\"max_off\":%.2f,"
+                  "\"fast_on\":%.2f,\"fast_off\":%.2f,\"medium_on\":%.2f,"
+                  "\"medium_off\":%.2f}}",
+                  fan->max_on, fan->max_off, fan->fast_on, fan->fast_off,
+                  fan->medium_on, fan->medium_off);
+    sensor->dump_thresholds_json = tempd_arena_strdup(arena, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
 
-    VLOG_DBG("There are %d sensors in subsystem %s", sensor_count, ovsrec_subsys->name);
+// typical length of a sensor's formatted thresholds, text and JSON
+#define DUMP_THRESHOLDS_SIZE    768
 
-    for (idx = 0; idx < sensor_count; idx++) {
-        const YamlSensor *sensor = yaml_get_sensor(yaml_handle, ovsrec_subsys->name, idx);
+// initial arena size for a subsystem with n_sensors sensors: the
+// subsystem, and for each sensor its structure, name, formatted thresholds,
+// windows and Temp_sensor reference, each rounded up for alignment
+static size_t
+tempd_subsystem_arena_size(const char *name, int n_sensors)
+{
+    size_t size = sizeof(struct locl_subsystem) + strlen(name) + 1 +
+                  2 * ARENA_ALIGN;
+
+    if (n_sensors > 0) {
+        size += n_sensors * (sizeof(struct locl_sensor) +
+                             strlen(name) + 13 +   // "-%d"
+                             DUMP_THRESHOLDS_SIZE +
+                             window_config.n * sizeof(struct tempd_window) +
+                             sizeof(struct ovsrec_temp_sensor *) +
+                             6 * ARENA_ALIGN);
+    }
 
-        struct ovsrec_temp_sensor *ovs_sensor;
-        char *sensor_name = NULL;
-        struct locl_sensor *new_sensor;
-        VLOG_DBG("Adding sensor %d (%s) in subsystem %s",
-            sensor->number,
-            sensor->location,
-            ovsrec_subsys->name);
+    return(size);
+}
 
-        // create a name for the sensor from the subsystem name and the
-        // sensor number
-        asprintf(&sensor_name, "%s-%d", ovsrec_subsys->name, sensor->number);
-        // allocate and initialize basic sensor information
-        new_sensor = (struct locl_sensor *)malloc(sizeof(struct locl_sensor));
-        new_sensor->name = sensor_name;
-        new_sensor->subsystem = result;
-        new_sensor->yaml_sensor = sensor;
-        new_sensor->min = 1000000;
-        new_sensor->max = -1000000;
-        new_sensor->temp = 0;
-        new_sensor->status = SENSOR_STATUS_NORMAL;
-        new_sensor->fan_speed = SENSOR_FAN_NORMAL;
-        new_sensor->test_temp = -1;     // no test temperature override set
-
-        // try to populate sensor information with real data
-        tempd_read_sensor(new_sensor);
+// give a new sensor its rolling statistics windows, from the arena
+static void
+tempd_add_windows(struct locl_sensor *sensor, struct tempd_arena *arena)
+{
+    if (window_config.n > 0) {
+        tempd_init_windows(sensor,
+                           tempd_arena_alloc(arena, window_config.n *
+                                                    sizeof(struct tempd_window)),
+                           &window_config);
+    }
+}
 
-        // add sensor to subsystem sensor dictionary
-        shash_add(&result->subsystem_sensors, sensor_name, (void *)new_sensor);
-        // add sensor to global sensor dictionary
-        shash_add(&sensor_data, sensor_name, (void *)new_sensor);
+// time of a sensor's first read slot after now. A sensor's phase comes from
+// its name, so it's the same from one run (or instance) to the next, and
+// the sensors' reads are spread over the polling period instead of all
+// hitting the buses at once.
+static long long
+tempd_next_read_slot(const struct locl_sensor *sensor, long long now)
+{
+    long long period = POLLING_PERIOD * MSEC_PER_SEC;
+    long long offset = ((now - sensor->read_phase) % period + period) % period;
 
-        // look for existing Temp_sensor rows
-        ovs_sensor = lookup_sensor(sensor_name);
+    return(now - offset + period);
+}
 
-        if (ovs_sensor == NULL) {
-            // existing sensor doesn't exist in db, create it
-            ovs_sensor = ovsrec_temp_sensor_insert(txn);
+// time of a sensor's next scheduled event: its next read, or for a
+// one-shot sensor, the start of the conversion for it
+static long long
+tempd_next_event(const struct locl_sensor *sensor)
+{
+    if (sensor->lm75.oneshot) {
+        if (!sensor->lm75.converting) {
+            return(sensor->next_read - tempd_lm75_conversion_ms(&sensor->lm75)
+                   - SCHEDULE_SLACK_MS);
         }
-
-        // set initial data
-        ovsrec_temp_sensor_set_name(ovs_sensor, sensor_name);
-        ovsrec_temp_sensor_set_status(ovs_sensor,
-            sensor_status_to_string(new_sensor->status));
-        ovsrec_temp_sensor_set_temperature(ovs_sensor, new_sensor->temp);
-        ovsrec_temp_sensor_set_min(ovs_sensor, new_sensor->min);
-        ovsrec_temp_sensor_set_max(ovs_sensor, new_sensor->max);
-        ovsrec_temp_sensor_set_fan_state(ovs_sensor,
-            sensor_speed_to_string(new_sensor->fan_speed));
-        ovsrec_temp_sensor_set_location(ovs_sensor, sensor->location);
-
-        // add sensor to subsystem reference list
-        sensor_array[sensor_idx++] = ovs_sensor;
+        // not before the conversion is done, however late it was started
+        // (reads are taken up to SCHEDULE_SLACK_MS early)
+        return(MAX(sensor->next_read,
+                   sensor->lm75.ready + SCHEDULE_SLACK_MS));
     }
 
-    ovsrec_subsystem_set_temp_sensors(ovsrec_subsys, sensor_array, sensor_count);
-    // execute transaction
-    ovsdb_idl_txn_commit_block(txn);
-    ovsdb_idl_txn_destroy(txn);
-    free(sensor_array);
-
-    return(result);
+    return(sensor->next_read);
+}
+
+// heap priorities are highest first: the earliest event gets the highest
+static uint64_t
+tempd_schedule_priority(const struct locl_sensor *sensor)
+{
+    return((uint64_t)(LLONG_MAX - tempd_next_event(sensor)));
+}
+
+// add a physical sensor to the read schedule, at its next slot. One-shot
+// sensors take their phase from the subsystem, so that its sensors all
+// sample at the same time; sensors on an i2c-dev bus take it from the bus,
+// so that they're all due together, and read in one batch.
+static void
+tempd_schedule_sensor(struct locl_sensor *sensor)
+{
+    const char *phase_name = sensor->name;
+
+    if (sensor->lm75.oneshot) {
+        phase_name = sensor->subsystem->name;
+    } else if (sensor->bus != NULL && sensor->bus->i2cdev != NULL) {
+        phase_name = sensor->bus->name;
+    }
+    sensor->read_phase = hash_string(phase_name, 0)
+                         % (POLLING_PERIOD * MSEC_PER_SEC);
+    sensor->next_read = tempd_next_read_slot(sensor, time_msec());
+    heap_insert(&read_schedule, &sensor->schedule_node,
+                tempd_schedule_priority(sensor));
+}
+
+// note that a sensor has a new reading (or a new state) to publish
+static void
+tempd_mark_dirty(struct locl_sensor *sensor)
+{
+    if (sensor->dirty) {
+        return;
+    }
+    if (n_dirty_sensors == allocated_dirty_sensors) {
+        dirty_sensors = x2nrealloc(dirty_sensors, &allocated_dirty_sensors,
+                                   sizeof(*dirty_sensors));
+    }
+    dirty_sensors[n_dirty_sensors++] = sensor;
+    sensor->dirty = true;
+}
+
+// a sensor is going away: drop it from the dirty list
+static void
+tempd_forget_dirty(struct locl_sensor *sensor)
+{
+    size_t idx;
+
+    if (!sensor->dirty) {
+        return;
+    }
+    for (idx = 0; idx < n_dirty_sensors; idx++) {
+        if (dirty_sensors[idx] == sensor) {
+            dirty_sensors[idx] = dirty_sensors[--n_dirty_sensors];
+            break;
+        }
+    }
+    sensor->dirty = false;
+}
+
+// start using a physical sensor's device: set it up, take a first reading,
+// hand it to the watchdog thread if it can trigger an emergency shutdown,
+// and add it to the read schedule. Only done while holding the lock.
+static void
+tempd_start_sensor(struct locl_sensor *sensor)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+
+    if (sim == NULL && replay == NULL && sensor->yaml_device != NULL &&
+            strcmp(yaml_sensor->type, "lm75") == 0) {
+        lm75_setup(sensor,
+                   lm75_oneshot && !sensor->subsystem->emergency_shutdown);
+    }
+
+    // try to populate sensor information with real data (when replaying,
+    // the recording provides the first reading; a one-shot sensor has
+    // nothing to read until its first conversion)
+    if (replay == NULL && !sensor->lm75.oneshot) {
+        tempd_read_sensor(sensor);
+    }
+
+    // sensors that can trigger an emergency shutdown are read by the
+    // watchdog thread from now on
+    if (sensor->subsystem->emergency_shutdown && tempd_watchdog_is_running() &&
+            strcmp(yaml_sensor->type, "lm75") == 0) {
+        sensor->watchdog_slot = tempd_watchdog_add(sensor);
+    }
+
+    // and read it again at its phase of the polling period
+    tempd_schedule_sensor(sensor);
+    sensor->started = true;
+    tempd_mark_dirty(sensor);
+}
+
+// stop using a physical sensor's device (the lock was lost)
+static void
+tempd_stop_sensor(struct locl_sensor *sensor)
+{
+    tempd_watchdog_remove(sensor->watchdog_slot);
+    sensor->watchdog_slot = -1;
+    heap_remove(&read_schedule, &sensor->schedule_node);
+    sensor->lm75.converting = false;
+    sensor->started = false;
+}
+
+// start (on claiming it) or stop (on losing the claim, or the lock) every
+// physical sensor of a subsystem that isn't in that state already.
+// Claiming a subsystem publishes all of its sensors.
+static void
+tempd_set_sensors_started(struct locl_subsystem *subsystem, bool start)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+        struct locl_sensor *sensor = node->data;
+
+        if (start) {
+            tempd_mark_dirty(sensor);
+        }
+        if (sensor->virtual != NULL || sensor->started == start) {
+            continue;
+        }
+        if (start) {
+            tempd_start_sensor(sensor);
+        } else {
+            tempd_stop_sensor(sensor);
+        }
+    }
+}
+
+// bring each subsystem's claimed flag, and so its sensors, up to date. The
+// subsystems are only looked at when a claim or the lock comes or goes
+// (subsystems added meanwhile are started as they're added).
+static void
+tempd_update_claimed(void)
+{
+    static unsigned int claim_seqno = 0;
+    static bool had_lock = false;
+    bool has_lock = ovsdb_idl_has_lock(idl);
+    struct shash_node *node;
+
+    if (claim_seqno == tempd_claim_seqno() && had_lock == has_lock) {
+        return;
+    }
+    claim_seqno = tempd_claim_seqno();
+    had_lock = has_lock;
+
+    SHASH_FOR_EACH(node, &subsystem_data) {
+        struct locl_subsystem *subsystem = node->data;
+        bool claimed = has_lock && tempd_claim_held(subsystem->name);
+
+        if (claimed != subsystem->claimed) {
+            subsystem->claimed = claimed;
+            tempd_set_sensors_started(subsystem, claimed);
+        }
+    }
+}
+
+// create a new locl_subsystem object
+static struct locl_subsystem *
+add_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    struct locl_subsystem *result;
+    struct tempd_arena *arena;
+    int idx;
+    int sensor_count;
+    int n_virtual = 0;
+    bool emergency_shutdown = false;
+
+    VLOG_DBG("Adding new subsystem %s", ovsrec_subsys->name);
+
+    if (sim != NULL) {
+        sensor_count = tempd_sim_add_subsystem(sim, ovsrec_subsys->name,
+                                               &emergency_shutdown);
+    } else {
+        sensor_count = load_hw_desc(ovsrec_subsys, &emergency_shutdown);
+    }
+
+    // everything the subsystem owns goes in one arena, sized for its
+    // sensors now that we know how many there are
+    if (virt != NULL) {
+        n_virtual = tempd_virtual_count(virt, ovsrec_subsys->name);
+    }
+    arena = tempd_arena_create(tempd_subsystem_arena_size(ovsrec_subsys->name,
+                                                          sensor_count +
+                                                          n_virtual));
+
+    // create and initialize basic subsystem information
+    result = tempd_arena_alloc(arena, sizeof(struct locl_subsystem));
+    (void)shash_add(&subsystem_data, ovsrec_subsys->name, (void *)result);
+    result->arena = arena;
+    result->name = tempd_arena_strdup(arena, ovsrec_subsys->name);
+    result->marked = false;
+    result->marked = true;
+    result->parent_subsystem = NULL;  // OPS_TODO: find parent subsystem
+    result->emergency_shutdown = emergency_shutdown;
+    result->claimed = ovsdb_idl_has_lock(idl) &&
+                      tempd_claim_held(ovsrec_subsys->name);
+    shash_init(&result->subsystem_sensors);
+
+    if (sensor_count <= 0) {
+        return(NULL);
+    }
+
+    result->valid = true;
+
+    VLOG_DBG("There are %d sensors in subsystem %s", sensor_count, ovsrec_subsys->name);
+
+    for (idx = 0; idx < sensor_count; idx++) {
+        const YamlSensor *sensor;
+        char *sensor_name = NULL;
+        struct locl_sensor *new_sensor;
+
+        if (sim != NULL) {
+            sensor = tempd_sim_get_sensor(sim, ovsrec_subsys->name, idx);
+        } else {
+            sensor = yaml_get_sensor(yaml_handle, ovsrec_subsys->name, idx);
+        }
+        VLOG_DBG("Adding sensor %d (%s) in subsystem %s",
+            sensor->number,
+            sensor->location,
+            ovsrec_subsys->name);
+
+        // create a name for the sensor from the subsystem name and the
+        // sensor number
+        sensor_name = tempd_arena_asprintf(arena, "%s-%d",
+                                           ovsrec_subsys->name, sensor->number);
+        // allocate and initialize basic sensor information
+        new_sensor = tempd_arena_alloc(arena, sizeof(struct locl_sensor));
+        tempd_init_sensor(new_sensor, sensor_name, result, sensor,
+                          &default_filter, trend_window);
+        tempd_add_windows(new_sensor, arena);
+        if (sim != NULL) {
+            new_sensor->yaml_device = tempd_sim_get_device(sim,
+                                        ovsrec_subsys->name);
+        } else {
+            new_sensor->yaml_device = yaml_find_device(yaml_handle,
+                                        ovsrec_subsys->name, sensor->device);
+        }
+        new_sensor->bus = get_bus(new_sensor->yaml_device);
+        tempd_format_thresholds(new_sensor);
+        if (strcmp(sensor->type, "lm75") != 0 &&
+                tempd_log_check(&unrecognized_event, sensor->type)) {
+            VLOG_WARN("Unrecognized sensor type %s", sensor->type);
+            log_event("TEMP_SENSOR_UNRECOGNIZED", EV_KV("type",
+                "%s", sensor->type));
+        }
+        new_sensor->replay_status = EAGAIN;
+        memset(new_sensor->replay_raw, 0, sizeof(new_sensor->replay_raw));
+
+        // add sensor to subsystem sensor dictionary
+        shash_add(&result->subsystem_sensors, sensor_name, (void *)new_sensor);
+        // add sensor to global sensor dictionary
+        shash_add(&sensor_data, sensor_name, (void *)new_sensor);
+
+        // a standby leaves the device to the active instance until it
+        // takes over (and an instance leaves it to the one that claimed
+        // the subsystem)
+        if (result->claimed) {
+            tempd_start_sensor(new_sensor);
+        }
+    }
+
+    // add the subsystem's virtual sensors. Their inputs are resolved once
+    // all of the subsystems have been added (see tempd_reconfigure).
+    for (idx = 0; idx < n_virtual; idx++) {
+        const YamlSensor *sensor;
+        const char *name;
+        struct locl_sensor *new_sensor;
+
+        sensor = tempd_virtual_get_sensor(virt, ovsrec_subsys->name, idx,
+                                          &name);
+        if (shash_find(&sensor_data, name) != NULL) {
+            VLOG_WARN("Virtual sensor %s has the name of another sensor",
+                      name);
+            continue;
+        }
+
+        new_sensor = tempd_arena_alloc(arena, sizeof(struct locl_sensor));
+        tempd_init_sensor(new_sensor, tempd_arena_strdup(arena, name), result,
+                          sensor, &virtual_filter, trend_window);
+        tempd_add_windows(new_sensor, arena);
+        tempd_format_thresholds(new_sensor);
+        tempd_virtual_attach(virt, sensor, new_sensor);
+
+        shash_add(&result->subsystem_sensors, new_sensor->name, new_sensor);
+        shash_add(&sensor_data, new_sensor->name, new_sensor);
+    }
+
+    // any existing Temp_sensor rows for the new sensors aren't replicated
+    // yet, so the rows are looked up (or created) once the condition that
+    // includes them has been applied
+    result->rows_pending = true;
+    n_rows_pending++;
+    rows_claim_seqno = 0;
+    sensor_cond_changed = true;
+
+    return(result);
+}
+
+// ask the server for the Temp_sensor rows of all of our sensors, and no
+// others
+static void
+tempd_set_sensor_condition(void)
+{
+    struct ovsdb_idl_condition cond;
+    struct shash_node *node;
+
+    // an empty condition matches no rows
+    ovsdb_idl_condition_init(&cond);
+    SHASH_FOR_EACH(node, &sensor_data) {
+        ovsrec_temp_sensor_add_clause_name(&cond, OVSDB_F_EQ, node->name);
+    }
+    sensor_cond_seqno = ovsdb_idl_set_condition(idl, &ovsrec_table_temp_sensor,
+                                                &cond);
+    ovsdb_idl_condition_destroy(&cond);
+
+    sensor_cond_changed = false;
+}
+
+// true if new subsystems are waiting for rows, and the server has applied
+// the condition that covers them (a standby leaves them to the active
+// instance, and creates them if it takes over). Subsystems claimed by
+// another instance are left to it, so they're only looked at again when
+// the claims change.
+static bool
+tempd_sensor_rows_due(void)
+{
+    return(n_rows_pending > 0 && !sensor_cond_changed &&
+           ovsdb_idl_has_lock(idl) &&
+           ovsdb_idl_get_condition_seqno(idl) == sensor_cond_seqno &&
+           rows_claim_seqno != tempd_claim_seqno());
+}
+
+// find or create the Temp_sensor rows for a new subsystem's sensors, set
+// their initial data and reference them from the Subsystem row
+static void
+tempd_add_sensor_rows(struct ovsdb_idl_txn *txn,
+                      struct locl_subsystem *subsystem,
+                      const struct ovsrec_subsystem *ovsrec_subsys)
+{
+    struct ovsrec_temp_sensor **sensor_array;
+    struct shash_node *node;
+    size_t sensor_idx = 0;
+
+    // subsystem db object has reference array for sensors
+    sensor_array = tempd_arena_alloc(subsystem->arena,
+                                     shash_count(&subsystem->subsystem_sensors)
+                                     * sizeof(struct ovsrec_temp_sensor *));
+
+    SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+        struct locl_sensor *sensor = (struct locl_sensor *)node->data;
+        struct ovsrec_temp_sensor *ovs_sensor;
+
+        // look for existing Temp_sensor rows
+        ovs_sensor = lookup_sensor(sensor->name);
+
+        if (ovs_sensor == NULL) {
+            // existing sensor doesn't exist in db, create it
+            ovs_sensor = ovsrec_temp_sensor_insert(txn);
+        }
+
+        // set initial data
+        ovsrec_temp_sensor_set_name(ovs_sensor, sensor->name);
+        ovsrec_temp_sensor_set_status(ovs_sensor,
+            sensor_status_to_string(sensor->status));
+        ovsrec_temp_sensor_set_temperature(ovs_sensor, sensor->temp);
+        ovsrec_temp_sensor_set_min(ovs_sensor, sensor->min);
+        ovsrec_temp_sensor_set_max(ovs_sensor, sensor->max);
+        ovsrec_temp_sensor_set_fan_state(ovs_sensor,
+            sensor_speed_to_string(sensor->fan_demand));
+        ovsrec_temp_sensor_set_location(ovs_sensor,
+                                        sensor->yaml_sensor->location);
+
+        // add sensor to subsystem reference list
+        sensor_array[sensor_idx++] = ovs_sensor;
+    }
+
+    ovsrec_subsystem_set_temp_sensors(ovsrec_subsys, sensor_array, sensor_idx);
+
+    subsystem->rows_pending = false;
+    n_rows_pending--;
 }
 
 static void
@@ -492,22 +1397,259 @@ tempd_unixctl_test(struct unixctl_conn *conn, int argc OVS_UNUSED,
     unixctl_command_reply(conn, "Test temperature override set");
 }
 
+static void
+tempd_unixctl_filter(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct tempd_filter_config config;
+    struct shash_node *node;
+    struct locl_sensor *sensor;
+
+    if (!tempd_filter_parse(argv[2], &config)) {
+        unixctl_command_reply_error(conn, "Invalid filter specification");
+        return;
+    }
+
+    // "all" changes every physical sensor, and the filter given to new
+    // sensors. Virtual sensors keep virtual_filter: their inputs are
+    // filtered already.
+    if (strcmp(argv[1], "all") == 0) {
+        default_filter = config;
+        SHASH_FOR_EACH(node, &sensor_data) {
+            sensor = (struct locl_sensor *)node->data;
+            if (sensor->virtual == NULL) {
+                tempd_filter_init(&sensor->filter, &config);
+            }
+        }
+        unixctl_command_reply(conn, "Filter set for all physical sensors");
+        return;
+    }
+
+    node = shash_find(&sensor_data, argv[1]);
+    if (node == NULL) {
+        unixctl_command_reply_error(conn, "Sensor does not exist");
+        return;
+    }
+    sensor = (struct locl_sensor *)node->data;
+    tempd_filter_init(&sensor->filter, &config);
+    unixctl_command_reply(conn, "Filter set");
+}
+
+static void
+tempd_unixctl_stats(struct unixctl_conn *conn, int argc,
+                    const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        tempd_stats_reset();
+        unixctl_command_reply(conn, "Statistics reset");
+        return;
+    } else if (argc > 1 && strcmp(argv[1], "json") != 0) {
+        unixctl_command_reply_error(conn, "Expected \"reset\" or \"json\"");
+        return;
+    }
+
+    tempd_stats_format(&ds, argc > 1);
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
+// bytes allocated from the heap by all threads, or 0 if unknown
+static size_t
+tempd_heap_in_use(void)
+{
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+
+    return(info.uordblks + info.hblkhd);
+#elif defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+
+    return((unsigned int)info.uordblks + (unsigned int)info.hblkhd);
+#else
+    return(0);
+#endif
+}
+
+// report the memory held by each subsystem's arena
+static void
+tempd_unixctl_memory(struct unixctl_conn *conn, int argc,
+                     const char *argv[], void *aux OVS_UNUSED)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct shash_node **nodes = shash_sort(&subsystem_data);
+    struct tempd_arena_usage total;
+    size_t n_created;
+    size_t n_live;
+    bool json = false;
+    size_t idx;
+
+    if (argc > 1) {
+        if (strcmp(argv[1], "json") != 0) {
+            unixctl_command_reply_error(conn, "usage: ops-tempd/memory [json]");
+            free(nodes);
+            return;
+        }
+        json = true;
+    }
+
+    memset(&total, 0, sizeof(total));
+    if (!json) {
+        ds_put_format(&ds, "%-20s %8s %10s %10s %7s %7s\n", "Subsystem",
+                      "Sensors", "Size", "Used", "Chunks", "Allocs");
+    }
+    for (idx = 0; idx < shash_count(&subsystem_data); idx++) {
+        const struct locl_subsystem *subsystem = nodes[idx]->data;
+        struct tempd_arena_usage usage;
+
+        tempd_arena_usage(subsystem->arena, &usage);
+        if (!json) {
+            ds_put_format(&ds, "%-20s %8"PRIuSIZE" %10"PRIuSIZE" %10"PRIuSIZE
+                          " %7"PRIuSIZE" %7"PRIuSIZE"\n", subsystem->name,
+                          shash_count(&subsystem->subsystem_sensors),
+                          usage.size, usage.used, usage.n_chunks,
+                          usage.n_allocs);
+        }
+        total.size += usage.size;
+        total.used += usage.used;
+        total.n_chunks += usage.n_chunks;
+        total.n_allocs += usage.n_allocs;
+    }
+    free(nodes);
+    tempd_arena_totals(&n_created, &n_live);
+
+    if (json) {
+        ds_put_format(&ds, "{\"subsystems\":%"PRIuSIZE",\"sensors\":%"PRIuSIZE
+                      ",\"buses\":%"PRIuSIZE",\"arena_size\":%"PRIuSIZE
+                      ",\"arena_used\":%"PRIuSIZE",\"arena_chunks\":%"PRIuSIZE
+                      ",\"arena_allocs\":%"PRIuSIZE",\"arenas_live\":%"PRIuSIZE
+                      ",\"arenas_created\":%"PRIuSIZE
+                      ",\"hw_desc_loaded\":%"PRIuSIZE
+                      ",\"heap_in_use\":%"PRIuSIZE"}",
+                      shash_count(&subsystem_data), shash_count(&sensor_data),
+                      shash_count(&bus_data), total.size, total.used,
+                      total.n_chunks, total.n_allocs, n_live, n_created,
+                      n_hw_desc_loaded, tempd_heap_in_use());
+        unixctl_command_reply(conn, ds_cstr(&ds));
+        ds_destroy(&ds);
+        return;
+    }
+
+    ds_put_format(&ds, "%-20s %8"PRIuSIZE" %10"PRIuSIZE" %10"PRIuSIZE
+                  " %7"PRIuSIZE" %7"PRIuSIZE"\n", "Total",
+                  shash_count(&sensor_data), total.size, total.used,
+                  total.n_chunks, total.n_allocs);
+    ds_put_format(&ds, "Buses: %"PRIuSIZE"\n", shash_count(&bus_data));
+    ds_put_format(&ds, "Arenas: %"PRIuSIZE" live, %"PRIuSIZE" created\n",
+                  n_live, n_created);
+    ds_put_format(&ds, "H/w descriptions: %"PRIuSIZE" loaded (held until "
+                  "exit)\n", n_hw_desc_loaded);
+    ds_put_format(&ds, "Heap: %"PRIuSIZE" bytes in use\n",
+                  tempd_heap_in_use());
+
+    unixctl_command_reply(conn, ds_cstr(&ds));
+    ds_destroy(&ds);
+}
+
 // initialize tempd process
 static void
 tempd_init(const char *remote)
 {
+    struct ovsdb_idl_condition cond;
     int retval;
 
+    tempd_stats_reset();
+
     // initialize subsystems
     init_subsystems();
 
     // initialize the yaml handle
     yaml_handle = yaml_new_config_handle();
 
+    if (sim_file != NULL) {
+        char *error = NULL;
+
+        sim = tempd_sim_load(sim_file, &error);
+        if (sim == NULL) {
+            VLOG_FATAL("%s", error);
+        }
+    }
+
+    if (virtual_file != NULL) {
+        char *error = NULL;
+
+        virt = tempd_virtual_load(virtual_file, &error);
+        if (virt == NULL) {
+            VLOG_FATAL("%s", error);
+        }
+    }
+
+    if (metrics_path != NULL && tempd_metrics_open(metrics_path) != 0) {
+        VLOG_FATAL("unable to serve metrics on %s", metrics_path);
+    }
+
+    if (mirror_path != NULL) {
+        tempd_mirror_open(mirror_path);
+    }
+
+    if (record_file != NULL) {
+        char *error = NULL;
+
+        recorder = tempd_recorder_open(record_file,
+                                       (size_t)record_size * 1024 * 1024,
+                                       &error);
+        if (recorder == NULL) {
+            VLOG_FATAL("%s", error);
+        }
+    }
+
+    if (replay_file != NULL) {
+        char *error = NULL;
+
+        replay = tempd_replay_open(replay_file, &error);
+        if (replay == NULL) {
+            VLOG_FATAL("%s", error);
+        }
+        replay_output = stdout;
+        if (replay_output_file != NULL) {
+            replay_output = fopen(replay_output_file, "w");
+            if (replay_output == NULL) {
+                VLOG_FATAL("%s: open failed (%s)", replay_output_file,
+                           ovs_strerror(errno));
+            }
+        }
+        replay_pending = tempd_replay_next(replay, &replay_record);
+        replay_start = replay_pending ? replay_record.when : 0;
+        replay_time = replay_start;
+    }
+
     // create connection to db
     idl = ovsdb_idl_create(remote, &ovsrec_idl_class, false, true);
     idl_seqno = ovsdb_idl_get_seqno(idl);
-    ovsdb_idl_set_lock(idl, "ops_tempd");
+    if (shard_globs.n > 0) {
+        // instances for different subsystems run side by side; a standby
+        // (or a duplicate) for the same subsystems, however they're listed,
+        // contends for the lock. Lock names are ids, so the sorted list is
+        // hashed.
+        uint8_t digest[SHA1_DIGEST_SIZE];
+        char hex[SHA1_HEX_DIGEST_LEN + 1];
+        char *spec = svec_join(&shard_globs, ",", "");
+        char *lock_name;
+
+        sha1_bytes(spec, strlen(spec), digest);
+        sha1_to_hex(digest, hex);
+        lock_name = xasprintf("ops_tempd_%s", hex);
+        ovsdb_idl_set_lock(idl, lock_name);
+        VLOG_INFO("handling subsystems %s", spec);
+        free(lock_name);
+        free(spec);
+    } else {
+        ovsdb_idl_set_lock(idl, "ops_tempd");
+    }
+    // and a connection of its own for the subsystem claims
+    tempd_claim_open(remote);
     ovsdb_idl_verify_write_only(idl);
 
     // Register for daemon table.
@@ -516,6 +1658,12 @@ tempd_init(const char *remote)
     ovsdb_idl_add_column(idl, &ovsrec_daemon_col_cur_hw);
     ovsdb_idl_omit_alert(idl, &ovsrec_daemon_col_cur_hw);
 
+    // only replicate our own daemon row
+    ovsdb_idl_condition_init(&cond);
+    ovsrec_daemon_add_clause_name(&cond, OVSDB_F_EQ, NAME_IN_DAEMON_TABLE);
+    ovsdb_idl_set_condition(idl, &ovsrec_table_daemon, &cond);
+    ovsdb_idl_condition_destroy(&cond);
+
     ovsdb_idl_add_table(idl, &ovsrec_table_temp_sensor);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_location);
     ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_location);
@@ -531,6 +1679,11 @@ tempd_init(const char *remote)
     ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_name);
     ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_fan_state);
     ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_fan_state);
+    ovsdb_idl_add_column(idl, &ovsrec_temp_sensor_col_external_ids);
+    ovsdb_idl_omit_alert(idl, &ovsrec_temp_sensor_col_external_ids);
+
+    // no Temp_sensor rows until subsystems are added
+    tempd_set_sensor_condition();
 
     ovsdb_idl_add_table(idl, &ovsrec_table_subsystem);
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_name);
@@ -539,10 +1692,29 @@ tempd_init(const char *remote)
     ovsdb_idl_add_column(idl, &ovsrec_subsystem_col_hw_desc_dir);
     ovsdb_idl_omit_alert(idl, &ovsrec_subsystem_col_hw_desc_dir);
 
-    unixctl_command_register("ops-tempd/dump", "", 0, 0,
+    unixctl_command_register("ops-tempd/dump",
+                             "[--format=text|json] [--subsystem=GLOB] "
+                             "[--sensor=GLOB] [--status=STATUS]", 0, 4,
                              tempd_unixctl_dump, NULL);
     unixctl_command_register("ops-tempd/test", "sensor temp", 2, 2,
                              tempd_unixctl_test, NULL);
+    unixctl_command_register("ops-tempd/filter", "sensor|all filter", 2, 2,
+                             tempd_unixctl_filter, NULL);
+    unixctl_command_register("ops-tempd/stats", "[reset|json]", 0, 1,
+                             tempd_unixctl_stats, NULL);
+    unixctl_command_register("ops-tempd/memory", "[json]", 0, 1,
+                             tempd_unixctl_memory, NULL);
+
+    if (watchdog_enabled) {
+        struct tempd_watchdog_settings settings = {
+            .period = watchdog_period,
+            .priority = watchdog_priority,
+            .cpu = watchdog_cpu,
+            .read = tempd_watchdog_read,
+            .check = tempd_watchdog_check,
+        };
+        tempd_watchdog_start(&settings);
+    }
 
     retval = event_log_init("TEMPERATURE");
     if(retval < 0) {
@@ -554,117 +1726,527 @@ tempd_init(const char *remote)
 static void
 tempd_exit(void)
 {
+    struct shash_node *node;
+
+    tempd_watchdog_stop();
+
+    // leave one-shot sensors converting for whoever reads them next (but
+    // a standby leaves them to the active instance)
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = node->data;
+
+        if (sensor->lm75.oneshot && sensor->started) {
+            lm75_restore(sensor);
+        }
+    }
+    heap_destroy(&read_schedule);
+    tempd_metrics_close();
+    tempd_mirror_close();
+    tempd_sim_destroy(sim);
+    tempd_virtual_destroy(virt);
+    tempd_recorder_close(recorder);
+    tempd_replay_close(replay);
+    svec_destroy(&shard_globs);
+    tempd_claim_close();
+    if (replay_output != NULL && replay_output != stdout) {
+        fclose(replay_output);
+    }
     ovsdb_idl_destroy(idl);
 }
 
-// poll every sensor for new temperature and update db with any new results
+// if we're in an emergency situation, and the subsystem indicates that we
+// should shutdown, verify the reading with a burst of samples before doing
+// so. The raw reading is checked as well as the status, so that filtering
+// never delays a shutdown. (the watchdog thread does this for the sensors
+// it owns; virtual sensors can't be sampled, and never shut down)
+static void
+tempd_check_emergency(struct locl_sensor *sensor)
+{
+    struct locl_subsystem *subsystem = sensor->subsystem;
+    float emergency_on = sensor->yaml_sensor->alarm_thresholds.emergency_on;
+
+    if ((sensor->status == SENSOR_STATUS_EMERGENCY ||
+             (sensor->fault_count == 0 &&
+              (float)sensor->raw_temp/MILI_DEGREES_FLOAT >= emergency_on)) &&
+            subsystem->emergency_shutdown == true &&
+            sensor->watchdog_slot < 0 && sensor->virtual == NULL &&
+            tempd_confirm_emergency(subsystem, sensor)) {
+        tempd_emergency_shutdown(sensor);
+    }
+}
+
+// run a recorded sample through the sensor state machine, and note any
+// status or fan changes in the transcript
+static void
+tempd_replay_sample(const struct tempd_record *record)
+{
+    struct locl_sensor *sensor;
+    enum sensorstatus status;
+    enum fanspeed fan;
+
+    sensor = (struct locl_sensor *)shash_find_data(&sensor_data, record->name);
+    if (sensor == NULL) {
+        replay_unmatched++;
+        return;
+    }
+
+    replay_samples++;
+    replay_time = record->when;
+    sensor->replay_status = record->status;
+    memcpy(sensor->replay_raw, record->raw, sizeof(sensor->replay_raw));
+
+    status = sensor->status;
+    fan = sensor->fan_demand;
+    tempd_read_sensor(sensor);
+    tempd_mark_dirty(sensor);
+
+    if (sensor->status != status) {
+        tempd_replay_log(sensor, "status %s -> %s temp %d",
+                         sensor_status_to_string(status),
+                         sensor_status_to_string(sensor->status),
+                         sensor->temp);
+    }
+    if (sensor->fan_demand != fan) {
+        tempd_replay_log(sensor, "fan %s -> %s temp %d",
+                         sensor_speed_to_string(fan),
+                         sensor_speed_to_string(sensor->fan_demand),
+                         sensor->temp);
+    }
+
+    tempd_check_emergency(sensor);
+}
+
+// write the replay summary: final state of each sensor, in name order
+static void
+tempd_replay_finish(void)
+{
+    const struct shash_node **nodes = shash_sort(&sensor_data);
+    long long duration = replay_time - replay_start;
+    size_t idx;
+
+    for (idx = 0; idx < shash_count(&sensor_data); idx++) {
+        const struct locl_sensor *sensor = nodes[idx]->data;
+
+        fprintf(replay_output, "summary %s status %s fan %s temp %d min %d "
+                "max %d reads %"PRIu64" faults %"PRIu64"\n", sensor->name,
+                sensor_status_to_string(sensor->status),
+                sensor_speed_to_string(sensor->fan_demand),
+                sensor->temp, sensor->min, sensor->max,
+                sensor->breaker.n_reads, sensor->breaker.n_faults);
+    }
+    free(nodes);
+
+    fprintf(replay_output, "summary samples %"PRIu64" unmatched %"PRIu64
+            " duration %lld.%03lld\n", replay_samples, replay_unmatched,
+            duration / MSEC_PER_SEC, duration % MSEC_PER_SEC);
+    if (tempd_replay_error(replay) != NULL) {
+        fprintf(replay_output, "summary error %s\n",
+                tempd_replay_error(replay));
+        VLOG_ERR("Replay stopped: %s", tempd_replay_error(replay));
+    }
+    fflush(replay_output);
+
+    VLOG_INFO("Replay of %s complete: %"PRIu64" samples", replay_file,
+              replay_samples);
+    replay_done = true;
+}
+
+// replay one polling period's worth of recorded samples. The main loop
+// runs again immediately, so the recording is replayed as fast as the
+// results can be published.
+static void
+tempd_replay_pass(void)
+{
+    long long pass_end;
+
+    if (replay_done) {
+        return;
+    }
+
+    // wait until the subsystems have been read from the database
+    if (shash_count(&sensor_data) == 0) {
+        return;
+    }
+
+    if (replay_pending) {
+        pass_end = replay_record.when + POLLING_PERIOD * MSEC_PER_SEC;
+        while (replay_pending && replay_record.when < pass_end) {
+            tempd_replay_sample(&replay_record);
+            replay_pending = tempd_replay_next(replay, &replay_record);
+        }
+    }
+
+    if (replay_pending) {
+        poll_immediate_wake();
+    } else {
+        tempd_replay_finish();
+    }
+}
+
+// whether a sensor's temperature will be read in this pass, and can be
+// read in a batch with the other sensors on its bus (--i2c-dev). Sensors
+// and buses that have been failing are left to their circuit breakers: one
+// in a batch would fail it, and every read in it would be retried.
+static bool
+tempd_batchable(const struct locl_sensor *sensor, long long now)
+{
+    return(sensor->bus != NULL && sensor->bus->i2cdev != NULL &&
+           sensor->yaml_device != NULL && sensor->virtual == NULL &&
+           sensor->watchdog_slot < 0 && sensor->test_temp == -1 &&
+           strcmp(sensor->yaml_sensor->type, "lm75") == 0 &&
+           !(sensor->lm75.oneshot && !sensor->lm75.converting) &&
+           tempd_next_event(sensor) <= now + SCHEDULE_SLACK_MS &&
+           sensor->breaker.state == BREAKER_CLOSED &&
+           sensor->bus->breaker.state == BREAKER_CLOSED);
+}
+
+static int
+tempd_compare_bus(const void *a_, const void *b_)
+{
+    const struct locl_sensor *const *a = a_;
+    const struct locl_sensor *const *b = b_;
+
+    return(strcmp((*a)->bus->name, (*b)->bus->name));
+}
+
+// collect the batchable sensors among those due in this pass, from the
+// read schedule's entry idx (1 is the earliest) down. An entry that isn't
+// due has nothing due below it, so only the due entries are visited.
+static void
+tempd_collect_batchable(size_t idx, long long now, struct locl_sensor ***due,
+                        size_t *n_due, size_t *allocated)
+{
+    struct locl_sensor *sensor;
+
+    if (idx > read_schedule.n) {
+        return;
+    }
+    sensor = CONTAINER_OF(read_schedule.array[idx], struct locl_sensor,
+                          schedule_node);
+    if (tempd_next_event(sensor) > now + SCHEDULE_SLACK_MS) {
+        return;
+    }
+
+    if (tempd_batchable(sensor, now)) {
+        if (*n_due >= *allocated) {
+            *due = x2nrealloc(*due, allocated, sizeof(**due));
+        }
+        (*due)[(*n_due)++] = sensor;
+    }
+    tempd_collect_batchable(2 * idx, now, due, n_due, allocated);
+    tempd_collect_batchable(2 * idx + 1, now, due, n_due, allocated);
+}
+
+// read the temperatures of the sensors due in this pass with one transfer
+// per bus, for the buses accessed through i2c-dev. lm75_read() then picks
+// up each sensor's result.
+static void
+tempd_read_batches(long long now)
+{
+    struct locl_sensor **due = NULL;
+    size_t n_due = 0;
+    size_t allocated = 0;
+    size_t start;
+    size_t count;
+
+    tempd_collect_batchable(1, now, &due, &n_due, &allocated);
+    if (n_due < 2) {
+        free(due);
+        return;
+    }
+    qsort(due, n_due, sizeof(*due), tempd_compare_bus);
+
+    for (start = 0; start < n_due; start += count) {
+        struct locl_bus *bus = due[start]->bus;
+        struct tempd_i2cdev_read *reads;
+        long long time;
+        size_t idx;
+
+        for (count = 1; start + count < n_due; count++) {
+            if (due[start + count]->bus != bus) {
+                break;
+            }
+        }
+        if (count == 1) {
+            // nothing to batch it with
+            continue;
+        }
+
+        reads = xmalloc(count * sizeof(*reads));
+        for (idx = 0; idx < count; idx++) {
+            struct locl_sensor *sensor = due[start + idx];
+
+            reads[idx].address = sensor->yaml_device->address;
+            reads[idx].reg = LM75_REG_TEMP;
+            reads[idx].length = sizeof(sensor->batch_raw);
+            reads[idx].buf = sensor->batch_raw;
+            reads[idx].rc = 0;
+        }
+
+        if (bus->lock != NULL) {
+            tempd_buslock_acquire(bus->lock);
+        }
+        // (the reads in it are timed and traced as a batch, not one by one)
+        time = tempd_stats_start();
+        TEMPD_PROBE2(batch_start, bus->name, count);
+        tempd_i2cdev_read_batch(bus->i2cdev, reads, count);
+        TEMPD_PROBE2(batch_end, bus->name, count);
+        tempd_stats_record(STATS_BATCH_TIME, time);
+        if (bus->lock != NULL) {
+            tempd_buslock_release(bus->lock);
+        }
+
+        for (idx = 0; idx < count; idx++) {
+            due[start + idx]->batch_status = reads[idx].rc;
+        }
+        free(reads);
+    }
+
+    free(due);
+}
+
+// read the sensors that are due (or nearly due)
+static void
+tempd_read_due_sensors(void)
+{
+    long long now = time_msec();
+
+    if (!shash_is_empty(&i2c_devs)) {
+        tempd_read_batches(now);
+    }
+
+    while (!heap_is_empty(&read_schedule)) {
+        struct locl_sensor *sensor = CONTAINER_OF(heap_max(&read_schedule),
+                                                  struct locl_sensor,
+                                                  schedule_node);
+
+        if (tempd_next_event(sensor) > now + SCHEDULE_SLACK_MS) {
+            break;
+        }
+
+        if (sensor->lm75.oneshot && !sensor->lm75.converting) {
+            int rc = lm75_start_conversion(sensor, now);
+
+            if (rc == 0) {
+                // read it once the conversion is done
+                heap_change(&read_schedule, &sensor->schedule_node,
+                            tempd_schedule_priority(sensor));
+                continue;
+            }
+
+            // the read would only get the previous conversion back, so
+            // count this period's read as failed instead
+            sensor->lm75.converting = false;
+            tempd_sensor_breaker_record(sensor, rc, now);
+            tempd_apply_sample(sensor, rc, 0, now);
+        } else {
+            sensor->lm75.converting = false;
+            tempd_read_sensor(sensor);
+            tempd_check_emergency(sensor);
+        }
+        tempd_mark_dirty(sensor);
+
+        // keep to the sensor's phase; if we've fallen a whole period
+        // behind, skip to its next slot
+        sensor->next_read += POLLING_PERIOD * MSEC_PER_SEC;
+        if (sensor->next_read <= now) {
+            sensor->next_read = tempd_next_read_slot(sensor, now);
+        }
+        heap_change(&read_schedule, &sensor->schedule_node,
+                    tempd_schedule_priority(sensor));
+    }
+}
+
+// point each sensor at its Temp_sensor row: the row pointers are good
+// until the database changes again. Rows without a sensor are marked
+// uninitialized; returns true if any were.
+static bool
+tempd_map_rows(void)
+{
+    const struct ovsrec_temp_sensor *cfg;
+    struct shash_node *node;
+    bool change = false;
+
+    SHASH_FOR_EACH(node, &sensor_data) {
+        struct locl_sensor *sensor = node->data;
+
+        sensor->row = NULL;
+    }
+
+    OVSREC_TEMP_SENSOR_FOR_EACH(cfg, idl) {
+        struct locl_sensor *sensor = shash_find_data(&sensor_data, cfg->name);
+
+        if (sensor != NULL) {
+            sensor->row = cfg;
+            continue;
+        }
+        if (tempd_log_check(&unmatched_event, cfg->name)) {
+            VLOG_WARN("unable to find matching sensor for %s", cfg->name);
+        }
+        ovsrec_temp_sensor_set_status(
+            cfg,
+            sensor_status_to_string(SENSOR_STATUS_UNINITIALIZED));
+        tempd_stats_count(STATS_ROWS_WRITTEN, 1);
+        change = true;
+    }
+
+    return(change);
+}
+
+// whether the sensors read since the last publish should be published now:
+// once PUBLISH_COALESCE_MS has passed, or at once if one of them has a new
+// status or fan demand
+static bool
+tempd_publish_due(long long now)
+{
+    size_t idx;
+
+    if (n_dirty_sensors == 0) {
+        return(false);
+    }
+    if (now >= publish_time + PUBLISH_COALESCE_MS) {
+        return(true);
+    }
+    for (idx = 0; idx < n_dirty_sensors; idx++) {
+        const struct locl_sensor *sensor = dirty_sensors[idx];
+
+        if (sensor->row != NULL &&
+                (strcmp(sensor_status_to_string(sensor->status),
+                        sensor->row->status) != 0 ||
+                 strcmp(sensor_speed_to_string(sensor->fan_demand),
+                        sensor->row->fan_state) != 0)) {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
+// write the rows of the sensors read since the last publish
+static bool
+tempd_publish_dirty(void)
+{
+    long long stale_age = (long long)stale_periods * POLLING_PERIOD *
+                          MSEC_PER_SEC;
+    bool change = false;
+    size_t idx;
+
+    for (idx = 0; idx < n_dirty_sensors; idx++) {
+        struct locl_sensor *sensor = dirty_sensors[idx];
+
+        sensor->dirty = false;
+        // (a new subsystem's rows are created with its sensors' data, and
+        // those of a subsystem claimed by another instance are its own)
+        if (sensor->row == NULL || !sensor->subsystem->claimed) {
+            continue;
+        }
+
+        if (tempd_check_stale(sensor, tempd_time_msec(), stale_age)) {
+            if (sensor->stale) {
+                if (tempd_log_check(&stale_event, sensor->name)) {
+                    VLOG_WARN("Sensor %s is stale: no good reading in %d "
+                              "polling periods", sensor->name,
+                              stale_periods);
+                }
+            } else if (tempd_log_check(&fresh_event, sensor->name)) {
+                VLOG_INFO("Sensor %s has a fresh reading again",
+                          sensor->name);
+            }
+        }
+
+        if (tempd_publish_sensor(sensor->row, sensor, tempd_time_msec())) {
+            change = true;
+        }
+        tempd_metrics_update(sensor);
+    }
+
+    return(change);
+}
+
+// read the sensors that are due, and update db with the new results of
+// those read since the last publish (at most once per PUBLISH_COALESCE_MS,
+// unless a status or fan demand changes)
 static void
 tempd_run__(void)
 {
     struct ovsdb_idl_txn *txn;
-    const struct ovsrec_temp_sensor *cfg;
     const struct ovsrec_daemon *db_daemon;
-    struct shash_node *node;
-    struct shash_node *sensor_node;
-    struct locl_sensor *sensor;
+    bool rows_changed;
+    bool cur_hw_due;
     bool change = false;
+    long long start = tempd_stats_start();
 
-    SHASH_FOR_EACH(node, &subsystem_data) {
-        struct locl_subsystem *subsystem = (struct locl_subsystem *)node->data;
-        SHASH_FOR_EACH(sensor_node, &subsystem->subsystem_sensors) {
-            sensor = (struct locl_sensor *)sensor_node->data;
-            tempd_read_sensor(sensor);
-            if (sensor->status == SENSOR_STATUS_EMERGENCY) {
-                // if we're in an emergency situation, verify that the sensor
-                // was read correctly (by reading it again).
-                tempd_read_sensor(sensor);
-                if (sensor->status == SENSOR_STATUS_EMERGENCY) {
-                    // if we're still in an emergency sitaution, and the
-                    // subsystem indicates that we should shutdown, do so.
-                    if (subsystem->emergency_shutdown == true) {
-                        VLOG_WARN("Emergency shutdown initiated for sensor %s",
-                                sensor->name);
-                        log_event("TEMP_SENSOR_SHUTDOWN",
-                            EV_KV("name", "%s", sensor->name));
-                        system(EMERGENCY_POWEROFF);
-                        // shouldn't continue
-                        while (1) {
-                            sleep(1000);
-                        }
-                    }
-                }
-            }
-        }
+    if (replay != NULL) {
+        tempd_replay_pass();
+    } else {
+        tempd_read_due_sensors();
     }
 
-    txn = ovsdb_idl_txn_create(idl);
-    OVSREC_TEMP_SENSOR_FOR_EACH(cfg, idl) {
-        const char *status;
-        node = shash_find(&sensor_data, cfg->name);
-        if (node == NULL) {
-            VLOG_WARN("unable to find matching sensor for %s", cfg->name);
-            ovsrec_temp_sensor_set_status(
-                cfg,
-                sensor_status_to_string(SENSOR_STATUS_UNINITIALIZED));
-            change = true;
-            continue;
-        }
-        sensor = (struct locl_sensor *)node->data;
+    if (virt != NULL) {
+        tempd_virtual_run(virt, tempd_time_msec(), trend_lead,
+                          tempd_mark_dirty);
+    }
+
+    rows_changed = ovsdb_idl_get_seqno(idl) != publish_seqno;
+    if (rows_changed) {
+        publish_seqno = ovsdb_idl_get_seqno(idl);
+    }
 
-        // note: only apply changes - don't blindly set data
+    // cur_hw is set by whichever instance holds the ops_tempd_cur_hw claim,
+    // once the rows of the subsystems it has claimed are there (and set
+    // again by the next holder, if that one goes away)
+    if (!tempd_claim_cur_hw()) {
+        cur_hw_set = false;
+    }
+    cur_hw_due = !cur_hw_set && tempd_claim_cur_hw() &&
+                 (n_rows_pending == 0 ||
+                  rows_claim_seqno == tempd_claim_seqno());
+
+    // (a replay is published as fast as it's replayed)
+    if (!cur_hw_due && !rows_changed && replay == NULL &&
+            !tempd_publish_due(time_msec())) {
+        tempd_log_run();
+        return;
+    }
 
-        // calculate and set status
-        status = sensor_status_to_string(sensor->status);
-        if (strcmp(status, cfg->status) != 0) {
-            ovsrec_temp_sensor_set_status(cfg, status);
-            change = true;
-        }
-        // set temperature
-        if (cfg->temperature != sensor->temp) {
-            ovsrec_temp_sensor_set_temperature(cfg, sensor->temp);
-            change = true;
-        }
-        // set min
-        if (cfg->min != sensor->min) {
-            ovsrec_temp_sensor_set_min(cfg, sensor->min);
-            change = true;
-        }
-        // set max
-        if (cfg->max != sensor->max) {
-            ovsrec_temp_sensor_set_max(cfg, sensor->max);
-            change = true;
-        }
-        // calculate and set fan speed
-        status = sensor_speed_to_string(sensor->fan_speed);
-        if (strcmp(status, cfg->fan_state) != 0) {
-            ovsrec_temp_sensor_set_fan_state(cfg, status);
+    txn = ovsdb_idl_txn_create(idl);
+    if (rows_changed && tempd_map_rows()) {
+        change = true;
+    }
+    if (replay != NULL || tempd_publish_due(time_msec())) {
+        if (tempd_publish_dirty()) {
             change = true;
         }
-        // set location (note: should never change)
-        if (strcmp(sensor->yaml_sensor->location, cfg->location) != 0) {
-            ovsrec_temp_sensor_set_location(cfg, sensor->yaml_sensor->location);
-            change = true;
+        if (recorder != NULL) {
+            tempd_recorder_flush(recorder);
         }
+        tempd_mirror_publish(dirty_sensors, n_dirty_sensors);
+        n_dirty_sensors = 0;
+        publish_time = time_msec();
     }
 
-    // If first time through, set cur_hw = 1
-    if (!cur_hw_set) {
-        OVSREC_DAEMON_FOR_EACH(db_daemon, idl) {
-            if (strncmp(db_daemon->name, NAME_IN_DAEMON_TABLE,
-                            strlen(NAME_IN_DAEMON_TABLE)) == 0) {
+    // set cur_hw = 1 (our own row is the only daemon row replicated),
+    // unless an earlier holder of the claim did
+    if (cur_hw_due) {
+        db_daemon = ovsrec_daemon_first(idl);
+        if (db_daemon != NULL) {
+            if (db_daemon->cur_hw != 1) {
                 ovsrec_daemon_set_cur_hw(db_daemon, (int64_t) 1);
-                cur_hw_set = true;
                 change = true;
-                break;
             }
+            cur_hw_set = true;
         }
     }
 
     // if a change was made, execute the transaction
     if (change == true) {
-        ovsdb_idl_txn_commit_block(txn);
+        tempd_txn_commit(txn);
     }
     ovsdb_idl_txn_destroy(txn);
+
+    tempd_log_run();
+
+    tempd_stats_record(STATS_PASS_TIME, start);
 }
 
 // lookup a local subsystem structure
@@ -690,6 +2272,26 @@ get_subsystem(const struct ovsrec_subsystem *ovsrec_subsys)
     return(result);
 }
 
+// true if this instance handles a subsystem (--subsystems)
+static bool
+tempd_in_shard(const char *name)
+{
+    const char *glob;
+    size_t idx;
+
+    if (shard_globs.n == 0) {
+        return(true);
+    }
+
+    SVEC_FOR_EACH(idx, glob, &shard_globs) {
+        if (fnmatch(glob, name, 0) == 0) {
+            return(true);
+        }
+    }
+
+    return(false);
+}
+
 // set the "marked" value for each subsystem to false.
 static void
 tempd_unmark_subsystems(void)
@@ -702,6 +2304,23 @@ tempd_unmark_subsystems(void)
     }
 }
 
+// delete the Temp_sensor rows of a subsystem that's being removed
+static void
+tempd_delete_sensor_rows(const struct locl_subsystem *subsystem)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &subsystem->subsystem_sensors) {
+        const struct locl_sensor *sensor = node->data;
+        const struct ovsrec_temp_sensor *row = lookup_sensor(sensor->name);
+
+        if (row != NULL) {
+            ovsrec_temp_sensor_delete(row);
+            tempd_stats_count(STATS_ROWS_DELETED, 1);
+        }
+    }
+}
+
 // delete all subsystems that haven't been marked
 // this is a helper function for deleting subsystems that no longer exist
 // in the DB
@@ -711,32 +2330,83 @@ tempd_remove_unmarked_subsystems(void)
     struct shash_node *node, *next;
     struct shash_node *temp_node, *temp_next;
     struct shash_node *global_node;
+    struct ovsdb_idl_txn *txn = NULL;
 
     SHASH_FOR_EACH_SAFE(node, next, &subsystem_data) {
         struct locl_subsystem *subsystem = node->data;
 
         if (subsystem->marked == false) {
+            if (subsystem->rows_pending) {
+                n_rows_pending--;
+            } else if (subsystem->claimed) {
+                // nothing else deletes its sensors' rows (a standby leaves
+                // them to the active instance, and an instance that didn't
+                // claim the subsystem to the one that did). They're still
+                // replicated: the condition changes once the subsystems
+                // are removed.
+                if (txn == NULL) {
+                    txn = ovsdb_idl_txn_create(idl);
+                }
+                tempd_delete_sensor_rows(subsystem);
+            }
+            if (!shash_is_empty(&subsystem->subsystem_sensors)) {
+                sensor_cond_changed = true;
+                // virtual sensors may read the sensors about to be freed
+                if (virt != NULL) {
+                    tempd_virtual_unbind(virt);
+                }
+            }
+
+            // take all of the sensors back from the watchdog thread before
+            // freeing any of them (it may look at the whole subsystem)
+            SHASH_FOR_EACH(temp_node, &subsystem->subsystem_sensors) {
+                struct locl_sensor *temp = (struct locl_sensor *)temp_node->data;
+                tempd_watchdog_remove(temp->watchdog_slot);
+            }
+
             // also, delete all temp sensors in the subsystem
             SHASH_FOR_EACH_SAFE(temp_node, temp_next, &subsystem->subsystem_sensors) {
                 struct locl_sensor *temp = (struct locl_sensor *)temp_node->data;
                 // delete the sensor_data entry
                 global_node = shash_find(&sensor_data, temp->name);
                 shash_delete(&sensor_data, global_node);
+                tempd_metrics_remove(temp->name);
+                tempd_mirror_remove(temp->name);
+                tempd_forget_dirty(temp);
+                if (temp->virtual != NULL) {
+                    tempd_virtual_detach(temp);
+                } else if (temp->started) {
+                    // as on exit, leave a one-shot sensor converting
+                    if (temp->lm75.oneshot) {
+                        lm75_restore(temp);
+                    }
+                    heap_remove(&read_schedule, &temp->schedule_node);
+                }
                 // delete the subsystem entry
                 shash_delete(&subsystem->subsystem_sensors, temp_node);
-                // free the allocated data
-                free(temp->name);
-                free(temp);
+                // release its bus (the sensor is freed with the arena)
+                put_bus(temp->bus);
             }
-            free(subsystem->name);
-            free(subsystem);
+            if (sim != NULL) {
+                tempd_sim_remove_subsystem(sim, subsystem->name);
+            }
+            shash_destroy(&subsystem->subsystem_sensors);
 
-            // delete the subsystem dictionary entry
+            // delete the subsystem dictionary entry, then free the
+            // subsystem and its sensors all at once
             shash_delete(&subsystem_data, node);
+            tempd_arena_destroy(subsystem->arena);
 
-            // OPS_TODO: need to remove subsystem yaml data
+            // OPS_TODO: config-yaml has no call to remove a subsystem's
+            // OPS_TODO: yaml data, so it stays until exit (counted by
+            // OPS_TODO: n_hw_desc_loaded, which the churn soak tracks)
         }
     }
+
+    if (txn != NULL) {
+        tempd_txn_commit(txn);
+        ovsdb_idl_txn_destroy(txn);
+    }
 }
 
 // process any changes to cached data
@@ -745,28 +2415,69 @@ tempd_reconfigure(struct ovsdb_idl *idl)
 {
     const struct ovsrec_subsystem *subsys;
     unsigned int new_idl_seqno = ovsdb_idl_get_seqno(idl);
+    struct ovsdb_idl_txn *txn;
+    long long start;
 
     COVERAGE_INC(tempd_reconfigure);
 
-    if (new_idl_seqno == idl_seqno){
+    if (new_idl_seqno == idl_seqno && !tempd_sensor_rows_due()) {
         return;
     }
 
     idl_seqno = new_idl_seqno;
+    start = tempd_stats_start();
+    TEMPD_PROBE1(reconfigure_start, idl_seqno);
 
     // handle any added or deleted subsystems
     tempd_unmark_subsystems();
 
+    tempd_claim_begin();
     OVSREC_SUBSYSTEM_FOR_EACH(subsys, idl) {
         struct locl_subsystem *subsystem;
+
+        if (!tempd_in_shard(subsys->name)) {
+            // another instance's (--subsystems)
+            continue;
+        }
+        tempd_claim_want(subsys->name);
         // get_subsystem will create a new one if it was added
         subsystem = get_subsystem(subsys);
         if (subsystem == NULL) continue;
         subsystem->marked = true;
     }
+    tempd_claim_end();
 
     // remove any subsystems that are no longer present in the db
     tempd_remove_unmarked_subsystems();
+
+    if (sensor_cond_changed) {
+        // resolve the inputs of the virtual sensors again
+        if (virt != NULL) {
+            tempd_virtual_bind(virt, &sensor_data);
+        }
+        tempd_set_sensor_condition();
+    }
+
+    // create the rows of new subsystems, once their existing rows (if any)
+    // have been replicated
+    if (tempd_sensor_rows_due()) {
+        txn = ovsdb_idl_txn_create(idl);
+        OVSREC_SUBSYSTEM_FOR_EACH(subsys, idl) {
+            struct locl_subsystem *subsystem;
+
+            subsystem = shash_find_data(&subsystem_data, subsys->name);
+            if (subsystem != NULL && subsystem->rows_pending &&
+                    tempd_claim_held(subsys->name)) {
+                tempd_add_sensor_rows(txn, subsystem, subsys);
+            }
+        }
+        tempd_txn_commit(txn);
+        ovsdb_idl_txn_destroy(txn);
+        rows_claim_seqno = n_rows_pending > 0 ? tempd_claim_seqno() : 0;
+    }
+
+    TEMPD_PROBE1(reconfigure_end, shash_count(&subsystem_data));
+    tempd_stats_record(STATS_RECONFIGURE_TIME, start);
 }
 
 // perform all of the per-loop processing
@@ -774,8 +2485,28 @@ static void
 tempd_run(void)
 {
     ovsdb_idl_run(idl);
+    // (only the lock holder claims subsystems)
+    tempd_claim_run(ovsdb_idl_has_lock(idl));
+    tempd_metrics_run();
+    tempd_mirror_run();
+
+    if (!ovsdb_idl_has_lock(idl)) {
+        // lost the lock (or never had it): leave the devices alone
+        tempd_update_claimed();
+    }
+
+    if (mirror_path != NULL && !ovsdb_idl_has_lock(idl)) {
+        // standby: keep the subsystems parsed, and their state mirrored,
+        // to take over where the active process leaves off
+        if (ovsdb_idl_is_lock_contended(idl)) {
+            VLOG_INFO_ONCE("another ops-tempd process is running, "
+                           "standing by until it goes away");
+        }
+        tempd_reconfigure(idl);
+        daemonize_complete();
 
-    if (ovsdb_idl_is_lock_contended(idl)) {
+        return;
+    } else if (ovsdb_idl_is_lock_contended(idl)) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 1);
 
         VLOG_ERR_RL(&rl, "another ops-tempd process is running, "
@@ -788,6 +2519,13 @@ tempd_run(void)
 
     // handle changes to cache
     tempd_reconfigure(idl);
+    if (mirror_path != NULL && !tempd_mirror_is_active()) {
+        tempd_mirror_activate(&sensor_data);
+    }
+    // take over the devices of the subsystems claimed, including those
+    // added while standing by (after restoring their mirrored state, which
+    // their first reading updates)
+    tempd_update_claimed();
     // poll all sensors and report changes into db
     tempd_run__();
 
@@ -801,75 +2539,392 @@ static void
 tempd_wait(void)
 {
     ovsdb_idl_wait(idl);
+    tempd_claim_wait();
+    tempd_metrics_wait();
+    tempd_mirror_wait();
+    // (only sensors read by the lock holder are scheduled)
+    if (replay == NULL && !heap_is_empty(&read_schedule) &&
+            ovsdb_idl_has_lock(idl)) {
+        const struct locl_sensor *sensor;
+
+        sensor = CONTAINER_OF(heap_max(&read_schedule), struct locl_sensor,
+                              schedule_node);
+        poll_timer_wait_until(tempd_next_event(sensor));
+    }
+    // publish what was held back (see tempd_publish_due)
+    if (n_dirty_sensors > 0 && ovsdb_idl_has_lock(idl)) {
+        poll_timer_wait_until(publish_time + PUBLISH_COALESCE_MS);
+    }
     poll_timer_wait(POLLING_PERIOD * MSEC_PER_SEC);
 }
 
+// ops-tempd/dump options
+struct dump_options {
+    bool json;              // JSON instead of text
+    const char *subsystem;  // glob of subsystems to show, NULL for all
+    const char *sensor;     // glob of sensors to show, NULL for all
+    int status;             // status of sensors to show, -1 for all
+};
+
+// parse the ops-tempd/dump arguments. Returns NULL, or an error message.
+static const char *
+tempd_dump_parse(int argc, const char *argv[], struct dump_options *options)
+{
+    int idx;
+
+    memset(options, 0, sizeof(*options));
+    options->status = -1;
+
+    for (idx = 1; idx < argc; idx++) {
+        const char *arg = argv[idx];
+
+        if (strcmp(arg, "--format=json") == 0) {
+            options->json = true;
+        } else if (strcmp(arg, "--format=text") == 0) {
+            options->json = false;
+        } else if (strncmp(arg, "--subsystem=", 12) == 0) {
+            options->subsystem = arg + 12;
+        } else if (strncmp(arg, "--sensor=", 9) == 0) {
+            options->sensor = arg + 9;
+        } else if (strncmp(arg, "--status=", 9) == 0) {
+            int status;
+
+            for (status = SENSOR_STATUS_UNINITIALIZED;
+                    status <= SENSOR_STATUS_EMERGENCY; status++) {
+                if (strcmp(arg + 9, sensor_status[status]) == 0) {
+                    break;
+                }
+            }
+            if (status > SENSOR_STATUS_EMERGENCY) {
+                return("Unknown sensor status");
+            }
+            options->status = status;
+        } else {
+            return("Unknown option");
+        }
+    }
+
+    return(NULL);
+}
+
+static bool
+tempd_dump_match(const struct dump_options *options,
+                 const struct locl_sensor *sensor)
+{
+    return((options->sensor == NULL ||
+            fnmatch(options->sensor, sensor->name, 0) == 0) &&
+           (options->status < 0 || sensor->status == options->status));
+}
+
+// append a JSON string
+static void
+tempd_dump_json_string(struct ds *ds, const char *value)
+{
+    ds_put_char(ds, '"');
+    for (; *value != '\0'; value++) {
+        unsigned char c = *value;
+
+        if (c == '"' || c == '\\') {
+            ds_put_char(ds, '\\');
+            ds_put_char(ds, c);
+        } else if (c < 0x20) {
+            ds_put_format(ds, "\\u%04x", c);
+        } else {
+            ds_put_char(ds, c);
+        }
+    }
+    ds_put_char(ds, '"');
+}
+
+// add circuit breaker state and counters to a support dump
+static void
+tempd_dump_breaker(struct ds *ds, const char *indent,
+                   const struct tempd_breaker *breaker, long long now)
+{
+    ds_put_format(ds, "%sBreaker: %s\n", indent,
+                  tempd_breaker_state_to_string(breaker->state));
+    if (breaker->state != BREAKER_CLOSED) {
+        ds_put_format(ds, "%s\tNext probe in: %lld ms\n", indent,
+                      breaker->next_probe > now ? breaker->next_probe - now : 0);
+    }
+    ds_put_format(ds, "%s\tReads: %"PRIu64"\n", indent, breaker->n_reads);
+    ds_put_format(ds, "%s\tFaults: %"PRIu64"\n", indent, breaker->n_faults);
+    ds_put_format(ds, "%s\tTrips: %"PRIu64"\n", indent, breaker->n_trips);
+    ds_put_format(ds, "%s\tProbes: %"PRIu64"\n", indent, breaker->n_probes);
+    ds_put_format(ds, "%s\tSkipped: %"PRIu64"\n", indent, breaker->n_skipped);
+    if (breaker->last_error != 0) {
+        ds_put_format(ds, "%s\tLast error: %d (%lld s ago)\n", indent,
+                      breaker->last_error,
+                      (now - breaker->last_error_time) / MSEC_PER_SEC);
+    }
+}
+
+static void
+tempd_dump_breaker_json(struct ds *ds, const struct tempd_breaker *breaker,
+                        long long now)
+{
+    ds_put_format(ds, "{\"state\":\"%s\",\"next_probe_ms\":%lld,"
+                  "\"reads\":%"PRIu64",\"faults\":%"PRIu64",\"trips\":%"PRIu64
+                  ",\"probes\":%"PRIu64",\"skipped\":%"PRIu64
+                  ",\"last_error\":%d,\"last_error_age\":%lld}",
+                  tempd_breaker_state_to_string(breaker->state),
+                  breaker->state != BREAKER_CLOSED && breaker->next_probe > now
+                  ? breaker->next_probe - now : 0,
+                  breaker->n_reads, breaker->n_faults, breaker->n_trips,
+                  breaker->n_probes, breaker->n_skipped, breaker->last_error,
+                  breaker->last_error != 0
+                  ? (now - breaker->last_error_time) / MSEC_PER_SEC : 0);
+}
+
+static void
+tempd_dump_sensor(struct ds *ds, struct locl_sensor *sensor, long long now)
+{
+    struct tempd_window_stats stats;
+    char filter[32];
+    char label[16];
+    int slope;
+    int idx;
+
+    ds_put_format(ds, "\tSensor name: %s\n", sensor->name);
+    ds_put_format(ds, "\t\tLocation: %s\n", sensor->yaml_sensor->location);
+    ds_put_format(ds, "\t\tDevice name: %s\n", sensor->yaml_sensor->device);
+    ds_put_format(ds, "\t\tType: %s\n", sensor->yaml_sensor->type);
+    ds_put_format(ds, "\t\tStatus: %s\n",
+                  sensor_status_to_string(sensor->status));
+    ds_put_format(ds, "\t\tFan speed: %s\n",
+                  sensor_speed_to_string(sensor->fan_speed));
+    tempd_filter_format(&sensor->filter.config, filter, sizeof(filter));
+    ds_put_format(ds, "\t\tTemperature: %d\n", sensor->temp / 1000);
+    ds_put_format(ds, "\t\tRaw temperature: %d\n", sensor->raw_temp / 1000);
+    ds_put_format(ds, "\t\tFilter: %s\n", filter);
+    if (tempd_trend_slope(&sensor->trend, &slope)) {
+        ds_put_format(ds, "\t\tTrend: %.1f C/min\n",
+                      slope / MILI_DEGREES_FLOAT);
+    }
+    ds_put_format(ds, "\t\tFan demand: %s\n",
+                  sensor_speed_to_string(sensor->fan_demand));
+    ds_put_format(ds, "\t\tMin temp: %d\n", sensor->min / 1000);
+    ds_put_format(ds, "\t\tMax temp: %d\n", sensor->max / 1000);
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        tempd_window_label(sensor->windows[idx].length, label, sizeof(label));
+        if (tempd_window_get(&sensor->windows[idx], now, &stats)) {
+            ds_put_format(ds, "\t\tLast %s: min %.1f, max %.1f, "
+                          "avg %.1f (%d readings)\n", label,
+                          stats.min / MILI_DEGREES_FLOAT,
+                          stats.max / MILI_DEGREES_FLOAT,
+                          stats.avg / MILI_DEGREES_FLOAT, stats.count);
+        } else {
+            ds_put_format(ds, "\t\tLast %s: no readings\n", label);
+        }
+    }
+    ds_put_format(ds, "\t\tFault count: %d\n", sensor->fault_count);
+    if (sensor->sample_time != 0) {
+        ds_put_format(ds, "\t\tSample age: %lld ms%s\n",
+                      now - sensor->sample_time,
+                      sensor->stale ? " (stale)" : "");
+    } else {
+        ds_put_cstr(ds, "\t\tSample age: none (stale)\n");
+    }
+    ds_put_format(ds, "\t\tSequence: %lld\n", sensor->publish_seq);
+    tempd_dump_breaker(ds, "\t\t", &sensor->breaker, now);
+    ds_put_cstr(ds, sensor->dump_thresholds);
+}
+
+// temperatures are in milidegrees, so no precision is lost
 static void
-tempd_unixctl_dump(struct unixctl_conn *conn, int argc OVS_UNUSED,
-                          const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+tempd_dump_sensor_json(struct ds *ds, struct locl_sensor *sensor,
+                       long long now)
+{
+    struct tempd_window_stats stats;
+    char filter[32];
+    char label[16];
+    int slope;
+    int idx;
+
+    ds_put_cstr(ds, "{\"name\":");
+    tempd_dump_json_string(ds, sensor->name);
+    ds_put_cstr(ds, ",\"location\":");
+    tempd_dump_json_string(ds, sensor->yaml_sensor->location);
+    ds_put_cstr(ds, ",\"device\":");
+    tempd_dump_json_string(ds, sensor->yaml_sensor->device);
+    ds_put_cstr(ds, ",\"type\":");
+    tempd_dump_json_string(ds, sensor->yaml_sensor->type);
+    tempd_filter_format(&sensor->filter.config, filter, sizeof(filter));
+    ds_put_format(ds, ",\"status\":\"%s\",\"fan_speed\":\"%s\","
+                  "\"fan_demand\":\"%s\",\"temperature\":%d,"
+                  "\"raw_temperature\":%d,\"min\":%d,\"max\":%d,"
+                  "\"filter\":\"%s\",\"fault_count\":%d,",
+                  sensor_status_to_string(sensor->status),
+                  sensor_speed_to_string(sensor->fan_speed),
+                  sensor_speed_to_string(sensor->fan_demand),
+                  sensor->temp, sensor->raw_temp, sensor->min, sensor->max,
+                  filter, sensor->fault_count);
+    if (tempd_trend_slope(&sensor->trend, &slope)) {
+        ds_put_format(ds, "\"trend_slope\":%d,", slope);
+    } else {
+        ds_put_cstr(ds, "\"trend_slope\":null,");
+    }
+    ds_put_cstr(ds, "\"windows\":{");
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        tempd_window_label(sensor->windows[idx].length, label, sizeof(label));
+        ds_put_format(ds, "%s\"%s\":", idx > 0 ? "," : "", label);
+        if (tempd_window_get(&sensor->windows[idx], now, &stats)) {
+            ds_put_format(ds, "{\"min\":%d,\"max\":%d,\"avg\":%d,"
+                          "\"count\":%d}", stats.min, stats.max, stats.avg,
+                          stats.count);
+        } else {
+            ds_put_cstr(ds, "null");
+        }
+    }
+    ds_put_cstr(ds, "},");
+    if (sensor->sample_time != 0) {
+        ds_put_format(ds, "\"sample_age\":%lld,",
+                      now - sensor->sample_time);
+    } else {
+        ds_put_cstr(ds, "\"sample_age\":null,");
+    }
+    ds_put_format(ds, "\"stale\":%s,\"seq\":%lld,",
+                  sensor->stale ? "true" : "false", sensor->publish_seq);
+    ds_put_cstr(ds, "\"breaker\":");
+    tempd_dump_breaker_json(ds, &sensor->breaker, now);
+    ds_put_format(ds, ",\"thresholds\":%s}", sensor->dump_thresholds_json);
+}
+
+// start a subsystem in the dump
+static void
+tempd_dump_subsystem(struct ds *ds, const struct dump_options *options,
+                     const struct locl_subsystem *subsystem, bool first)
+{
+    if (options->json) {
+        ds_put_cstr(ds, first ? "{\"name\":" : ",{\"name\":");
+        tempd_dump_json_string(ds, subsystem->name);
+        ds_put_format(ds, ",\"emergency_shutdown\":%s,\"sensors\":[",
+                      subsystem->emergency_shutdown ? "true" : "false");
+    } else {
+        ds_put_format(ds, "\nSubsystem: %s\n", subsystem->name);
+    }
+}
+
+// support dump: ops-tempd/dump [--format=text|json] [--subsystem=GLOB]
+// [--sensor=GLOB] [--status=STATUS]. The reply is written in a single pass
+// over the sensors. With the sensor or status filters, subsystems without
+// any matching sensors are left out; with any filter, so are the buses and
+// the simulation and recording sections.
+static void
+tempd_unixctl_dump(struct unixctl_conn *conn, int argc,
+                   const char *argv[], void *aux OVS_UNUSED)
 {
     struct ds ds = DS_EMPTY_INITIALIZER;
+    struct dump_options options;
     struct shash_node *snode;
     struct shash_node *tnode;
+    long long now = tempd_time_msec();
+    bool filtered;
+    bool first_subsystem = true;
+    const char *error;
+
+    error = tempd_dump_parse(argc, argv, &options);
+    if (error != NULL) {
+        unixctl_command_reply_error(conn, error);
+        return;
+    }
+    filtered = options.sensor != NULL || options.status >= 0;
 
-    ds_put_cstr(&ds, "Support Dump for Platform Temperature Daemon (ops-tempd)\n");
+    if (options.json) {
+        ds_put_cstr(&ds, "{\"subsystems\":[");
+    } else {
+        ds_put_cstr(&ds, "Support Dump for Platform Temperature Daemon (ops-tempd)\n");
+    }
 
     SHASH_FOR_EACH(snode, &subsystem_data) {
         struct locl_subsystem *subsystem = (struct locl_subsystem *)snode->data;
+        bool started = false;
+        bool first_sensor = true;
+
+        if (options.subsystem != NULL &&
+                fnmatch(options.subsystem, subsystem->name, 0) != 0) {
+            continue;
+        }
 
-        ds_put_format(&ds, "\nSubsystem: %s\n", subsystem->name);
+        if (!filtered) {
+            tempd_dump_subsystem(&ds, &options, subsystem, first_subsystem);
+            first_subsystem = false;
+            started = true;
+        }
 
         SHASH_FOR_EACH(tnode, &(subsystem->subsystem_sensors)) {
             struct locl_sensor *sensor = (struct locl_sensor *)tnode->data;
 
-            ds_put_format(&ds, "\tSensor name: %s\n", sensor->name);
-            ds_put_format(&ds, "\t\tLocation: %s\n",
-                                        sensor->yaml_sensor->location);
-            ds_put_format(&ds, "\t\tDevice name: %s\n",
-                                        sensor->yaml_sensor->device);
-            ds_put_format(&ds, "\t\tType: %s\n",
-                                        sensor->yaml_sensor->type);
-            ds_put_format(&ds, "\t\tStatus: %s\n",
-                                sensor_status_to_string(sensor->status));
-            ds_put_format(&ds, "\t\tFan speed: %s\n",
-                                sensor_speed_to_string(sensor->fan_speed));
-            ds_put_format(&ds, "\t\tTemperature: %d\n",
-                                        sensor->temp / 1000);
-            ds_put_format(&ds, "\t\tMin temp: %d\n", sensor->min / 1000);
-            ds_put_format(&ds, "\t\tMax temp: %d\n", sensor->max / 1000);
-            ds_put_format(&ds, "\t\tFault count: %d\n",
-                                        sensor->fault_count);
-            ds_put_format(&ds, "\t\tAlarm Thresholds: \n");
-            ds_put_format(&ds, "\t\t\temergency_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.emergency_on);
-            ds_put_format(&ds, "\t\t\temergency_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.emergency_off);
-            ds_put_format(&ds, "\t\t\tcritical_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.critical_on);
-            ds_put_format(&ds, "\t\t\tcritical_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.critical_off);
-            ds_put_format(&ds, "\t\t\tmax_on: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.max_on);
-            ds_put_format(&ds, "\t\t\tmax_off: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.max_off);
-            ds_put_format(&ds, "\t\t\tmin: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.min);
-            ds_put_format(&ds, "\t\t\tlow_crit: %.2f\n",
-                        sensor->yaml_sensor->alarm_thresholds.low_crit);
-            ds_put_format(&ds, "\t\tFan Thresholds: \n");
-            ds_put_format(&ds, "\t\t\tmax_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.max_on);
-            ds_put_format(&ds, "\t\t\tmax_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.max_off);
-            ds_put_format(&ds, "\t\t\tfast_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.fast_on);
-            ds_put_format(&ds, "\t\t\tfast_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.fast_off);
-            ds_put_format(&ds, "\t\t\tmedium_on: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.medium_on);
-            ds_put_format(&ds, "\t\t\tmedium_off: %.2f\n",
-                        sensor->yaml_sensor->fan_thresholds.medium_off);
+            if (!tempd_dump_match(&options, sensor)) {
+                continue;
+            }
+            if (!started) {
+                tempd_dump_subsystem(&ds, &options, subsystem,
+                                     first_subsystem);
+                first_subsystem = false;
+                started = true;
+            }
+
+            if (options.json) {
+                if (!first_sensor) {
+                    ds_put_char(&ds, ',');
+                }
+                tempd_dump_sensor_json(&ds, sensor, now);
+            } else {
+                tempd_dump_sensor(&ds, sensor, now);
+            }
+            first_sensor = false;
         }
+
+        if (started && options.json) {
+            ds_put_cstr(&ds, "]}");
+        }
+    }
+
+    filtered = filtered || options.subsystem != NULL;
+
+    if (options.json) {
+        ds_put_cstr(&ds, "],\"buses\":[");
+    }
+    if (!filtered) {
+        bool first_bus = true;
+
+        SHASH_FOR_EACH(snode, &bus_data) {
+            struct locl_bus *bus = (struct locl_bus *)snode->data;
+
+            if (options.json) {
+                ds_put_cstr(&ds, first_bus ? "{\"name\":" : ",{\"name\":");
+                tempd_dump_json_string(&ds, bus->name);
+                ds_put_format(&ds, ",\"sensors\":%d,\"breaker\":",
+                              bus->n_sensors);
+                tempd_dump_breaker_json(&ds, &bus->breaker, now);
+                ds_put_char(&ds, '}');
+            } else {
+                ds_put_format(&ds, "\nBus: %s\n", bus->name);
+                ds_put_format(&ds, "\tSensors: %d\n", bus->n_sensors);
+                tempd_dump_breaker(&ds, "\t", &bus->breaker, now);
+            }
+            first_bus = false;
+        }
+    }
+    if (options.json) {
+        ds_put_cstr(&ds, "]}\n");
+    }
+
+    if (!filtered && !options.json) {
+        if (sim != NULL) {
+            tempd_sim_dump(sim, &ds);
+        }
+
+        if (recorder != NULL) {
+            tempd_recorder_dump(recorder, &ds);
+        }
+
+        if (mirror_path != NULL) {
+            tempd_mirror_dump(&ds);
+        }
+
+        tempd_claim_dump(&ds);
     }
 
     unixctl_command_reply(conn, ds_cstr(&ds));
@@ -911,7 +2966,7 @@ main(int argc, char *argv[])
     free(remote);
 
     exiting = false;
-    while (!exiting) {
+    while (!exiting && !replay_done) {
         tempd_run();
         unixctl_server_run(unixctl);
 
@@ -928,6 +2983,24 @@ main(int argc, char *argv[])
     return 0;
 }
 
+// parse a BUS=DEVICE mapping (--i2c-dev). Returns false if it's malformed.
+static bool
+parse_i2c_dev(const char *arg)
+{
+    const char *path = strchr(arg, '=');
+    char *bus;
+
+    if (path == NULL || path == arg || path[1] == '\0') {
+        return(false);
+    }
+
+    bus = xmemdup0(arg, path - arg);
+    shash_replace(&i2c_devs, bus, path + 1);
+    free(bus);
+
+    return(true);
+}
+
 static char *
 parse_options(int argc, char *argv[], char **unixctl_pathp)
 {
@@ -940,6 +3013,32 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         OPT_DISABLE_SYSTEM,
         DAEMON_OPTION_ENUMS,
         OPT_DPDK,
+        OPT_EMERGENCY_SAMPLES,
+        OPT_EMERGENCY_VOTES,
+        OPT_EMERGENCY_INTERVAL,
+        OPT_EMERGENCY_CORRELATE,
+        OPT_WATCHDOG,
+        OPT_WATCHDOG_PERIOD,
+        OPT_WATCHDOG_PRIORITY,
+        OPT_WATCHDOG_CPU,
+        OPT_BUS_LOCK_DIR,
+        OPT_I2C_DEV,
+        OPT_LM75_RESOLUTION,
+        OPT_LM75_ONESHOT,
+        OPT_STALE_PERIODS,
+        OPT_FILTER,
+        OPT_TREND_WINDOW,
+        OPT_TREND_LEAD,
+        OPT_WINDOWS,
+        OPT_SIM,
+        OPT_VIRTUAL,
+        OPT_RECORD,
+        OPT_RECORD_SIZE,
+        OPT_REPLAY,
+        OPT_REPLAY_OUTPUT,
+        OPT_METRICS,
+        OPT_MIRROR,
+        OPT_SUBSYSTEMS,
     };
     static const struct option long_options[] = {
         {"help",        no_argument, NULL, 'h'},
@@ -950,9 +3049,39 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
         STREAM_SSL_LONG_OPTIONS,
         {"peer-ca-cert", required_argument, NULL, OPT_PEER_CA_CERT},
         {"bootstrap-ca-cert", required_argument, NULL, OPT_BOOTSTRAP_CA_CERT},
+        {"emergency-samples", required_argument, NULL, OPT_EMERGENCY_SAMPLES},
+        {"emergency-votes", required_argument, NULL, OPT_EMERGENCY_VOTES},
+        {"emergency-interval", required_argument, NULL,
+                                                OPT_EMERGENCY_INTERVAL},
+        {"emergency-correlate", no_argument, NULL, OPT_EMERGENCY_CORRELATE},
+        {"watchdog", no_argument, NULL, OPT_WATCHDOG},
+        {"watchdog-period", required_argument, NULL, OPT_WATCHDOG_PERIOD},
+        {"watchdog-priority", required_argument, NULL, OPT_WATCHDOG_PRIORITY},
+        {"watchdog-cpu", required_argument, NULL, OPT_WATCHDOG_CPU},
+        {"bus-lock-dir", required_argument, NULL, OPT_BUS_LOCK_DIR},
+        {"i2c-dev", required_argument, NULL, OPT_I2C_DEV},
+        {"lm75-resolution", required_argument, NULL, OPT_LM75_RESOLUTION},
+        {"lm75-oneshot", no_argument, NULL, OPT_LM75_ONESHOT},
+        {"stale-periods", required_argument, NULL, OPT_STALE_PERIODS},
+        {"filter", required_argument, NULL, OPT_FILTER},
+        {"trend-window", required_argument, NULL, OPT_TREND_WINDOW},
+        {"trend-lead", required_argument, NULL, OPT_TREND_LEAD},
+        {"windows", required_argument, NULL, OPT_WINDOWS},
+        {"sim", required_argument, NULL, OPT_SIM},
+        {"virtual", required_argument, NULL, OPT_VIRTUAL},
+        {"record", required_argument, NULL, OPT_RECORD},
+        {"record-size", required_argument, NULL, OPT_RECORD_SIZE},
+        {"replay", required_argument, NULL, OPT_REPLAY},
+        {"replay-output", required_argument, NULL, OPT_REPLAY_OUTPUT},
+        {"metrics", required_argument, NULL, OPT_METRICS},
+        {"mirror", required_argument, NULL, OPT_MIRROR},
+        {"subsystems", required_argument, NULL, OPT_SUBSYSTEMS},
         {NULL, 0, NULL, 0},
     };
     char *short_options = long_options_to_short_options(long_options);
+    bool votes_given = false;
+
+    (void)tempd_window_parse(WINDOW_DEFAULT, &window_config);
 
     for (;;) {
         int c;
@@ -986,6 +3115,166 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
             stream_ssl_set_ca_cert_file(optarg, true);
             break;
 
+        case OPT_EMERGENCY_SAMPLES:
+            if (!str_to_int(optarg, 10, &emergency_samples) ||
+                    emergency_samples < 1 ||
+                    emergency_samples > EMERGENCY_CONFIRM_MAX_SAMPLES) {
+                VLOG_FATAL("--emergency-samples must be between 1 and %d",
+                           EMERGENCY_CONFIRM_MAX_SAMPLES);
+            }
+            break;
+
+        case OPT_EMERGENCY_VOTES:
+            if (!str_to_int(optarg, 10, &emergency_votes) ||
+                    emergency_votes < 1) {
+                VLOG_FATAL("--emergency-votes must be a positive number");
+            }
+            votes_given = true;
+            break;
+
+        case OPT_EMERGENCY_INTERVAL:
+            if (!str_to_int(optarg, 10, &emergency_interval) ||
+                    emergency_interval < 0 ||
+                    emergency_interval > EMERGENCY_CONFIRM_MAX_INTERVAL_MS) {
+                VLOG_FATAL("--emergency-interval must be between 0 and %d",
+                           EMERGENCY_CONFIRM_MAX_INTERVAL_MS);
+            }
+            break;
+
+        case OPT_EMERGENCY_CORRELATE:
+            emergency_correlate = true;
+            break;
+
+        case OPT_WATCHDOG:
+            watchdog_enabled = true;
+            break;
+
+        case OPT_WATCHDOG_PERIOD:
+            if (!str_to_int(optarg, 10, &watchdog_period) ||
+                    watchdog_period < WATCHDOG_MIN_PERIOD_MS) {
+                VLOG_FATAL("--watchdog-period must be at least %d",
+                           WATCHDOG_MIN_PERIOD_MS);
+            }
+            break;
+
+        case OPT_WATCHDOG_PRIORITY:
+            if (!str_to_int(optarg, 10, &watchdog_priority) ||
+                    watchdog_priority < 0 ||
+                    watchdog_priority > sched_get_priority_max(SCHED_FIFO)) {
+                VLOG_FATAL("--watchdog-priority must be between 0 and %d",
+                           sched_get_priority_max(SCHED_FIFO));
+            }
+            break;
+
+        case OPT_WATCHDOG_CPU:
+            if (!str_to_int(optarg, 10, &watchdog_cpu) || watchdog_cpu < 0) {
+                VLOG_FATAL("--watchdog-cpu must be a cpu number");
+            }
+            break;
+
+        case OPT_BUS_LOCK_DIR:
+            bus_lock_dir = optarg;
+            break;
+
+        case OPT_I2C_DEV:
+            if (!parse_i2c_dev(optarg)) {
+                VLOG_FATAL("--i2c-dev must be BUS=DEVICE");
+            }
+            break;
+
+        case OPT_LM75_RESOLUTION:
+            if (!str_to_int(optarg, 10, &lm75_resolution) ||
+                    lm75_resolution < LM75_MIN_RESOLUTION ||
+                    lm75_resolution > LM75_MAX_RESOLUTION) {
+                VLOG_FATAL("--lm75-resolution must be between %d and %d",
+                           LM75_MIN_RESOLUTION, LM75_MAX_RESOLUTION);
+            }
+            break;
+
+        case OPT_LM75_ONESHOT:
+            lm75_oneshot = true;
+            break;
+
+        case OPT_STALE_PERIODS:
+            if (!str_to_int(optarg, 10, &stale_periods) ||
+                    stale_periods < 1) {
+                VLOG_FATAL("--stale-periods must be at least 1");
+            }
+            break;
+
+        case OPT_FILTER:
+            if (!tempd_filter_parse(optarg, &default_filter)) {
+                VLOG_FATAL("invalid --filter specification \"%s\"", optarg);
+            }
+            break;
+
+        case OPT_TREND_WINDOW:
+            if (!str_to_int(optarg, 10, &trend_window) ||
+                    trend_window < TREND_MIN_WINDOW ||
+                    trend_window > TREND_MAX_WINDOW) {
+                VLOG_FATAL("--trend-window must be between %d and %d",
+                           TREND_MIN_WINDOW, TREND_MAX_WINDOW);
+            }
+            break;
+
+        case OPT_TREND_LEAD:
+            if (!str_to_int(optarg, 10, &trend_lead) || trend_lead < 0) {
+                VLOG_FATAL("--trend-lead must be a number of seconds");
+            }
+            break;
+
+        case OPT_WINDOWS:
+            if (!tempd_window_parse(optarg, &window_config)) {
+                VLOG_FATAL("invalid --windows list \"%s\" (at most %d "
+                           "windows, up to 7d each)", optarg, WINDOW_MAX);
+            }
+            break;
+
+        case OPT_SIM:
+            sim_file = optarg;
+            break;
+
+        case OPT_VIRTUAL:
+            virtual_file = optarg;
+            break;
+
+        case OPT_RECORD:
+            record_file = optarg;
+            break;
+
+        case OPT_RECORD_SIZE:
+            if (!str_to_int(optarg, 10, &record_size) || record_size < 1 ||
+                    record_size > 1024) {
+                VLOG_FATAL("--record-size must be between 1 and 1024 (MB)");
+            }
+            break;
+
+        case OPT_REPLAY:
+            replay_file = optarg;
+            break;
+
+        case OPT_REPLAY_OUTPUT:
+            replay_output_file = optarg;
+            break;
+
+        case OPT_METRICS:
+            metrics_path = optarg;
+            break;
+
+        case OPT_MIRROR:
+            mirror_path = optarg;
+            break;
+
+        case OPT_SUBSYSTEMS:
+            // (in a canonical order, so the same subsystems however
+            // they're listed share a lock)
+            svec_split(&shard_globs, optarg, ",");
+            svec_sort_unique(&shard_globs);
+            if (shard_globs.n == 0) {
+                VLOG_FATAL("--subsystems needs at least one subsystem");
+            }
+            break;
+
         case '?':
             exit(EXIT_FAILURE);
 
@@ -995,6 +3284,18 @@ parse_options(int argc, char *argv[], char **unixctl_pathp)
     }
     free(short_options);
 
+    if (replay_file != NULL && (watchdog_enabled || record_file != NULL)) {
+        VLOG_FATAL("--replay can't be used with --watchdog or --record");
+    }
+
+    // the default asks for no more votes than there are samples
+    if (!votes_given) {
+        emergency_votes = MIN(EMERGENCY_CONFIRM_VOTES, emergency_samples);
+    } else if (emergency_votes > emergency_samples) {
+        VLOG_FATAL("--emergency-votes (%d) can't exceed --emergency-samples "
+                   "(%d)", emergency_votes, emergency_samples);
+    }
+
     argc -= optind;
     argv += optind;
 
@@ -1022,6 +3323,101 @@ usage(void)
     stream_usage("DATABASE", true, false, true);
     daemon_usage();
     vlog_usage();
+    printf("\nEmergency confirmation options:\n"
+           "  --emergency-samples=N   samples taken to confirm an emergency "
+           "(default: %d)\n"
+           "  --emergency-votes=M     samples that must agree to shut down "
+           "(default: %d,\n"
+           "                          or N if that's fewer)\n"
+           "  --emergency-interval=MSEC  spacing between samples "
+           "(default: %d)\n"
+           "  --emergency-correlate   require another sensor in the subsystem "
+           "to be\n"
+           "                          at or above critical\n",
+           EMERGENCY_CONFIRM_SAMPLES, EMERGENCY_CONFIRM_VOTES,
+           EMERGENCY_CONFIRM_INTERVAL_MS);
+    printf("\nEmergency watchdog options:\n"
+           "  --watchdog              read shutdown-capable sensors in a "
+           "separate thread\n"
+           "  --watchdog-period=MSEC  watchdog read period (default: %d)\n"
+           "  --watchdog-priority=N   watchdog SCHED_FIFO priority, 0 for "
+           "none\n"
+           "                          (default: %d)\n"
+           "  --watchdog-cpu=N        pin the watchdog thread to cpu N\n",
+           WATCHDOG_PERIOD_MS, WATCHDOG_PRIORITY);
+    printf("\nBus arbitration options:\n"
+           "  --bus-lock-dir=DIR      flock DIR/BUS.lock around each device "
+           "access,\n"
+           "                          shared with other daemons\n"
+           "  --i2c-dev=BUS=DEVICE    access the devices on BUS through "
+           "i2c-dev\n"
+           "                          DEVICE (/dev/i2c-N), batching reads "
+           "with\n"
+           "                          I2C_RDWR (may be repeated)\n");
+    printf("\nLM75 options:\n"
+           "  --lm75-resolution=BITS  set parts with selectable resolution "
+           "to %d to %d\n"
+           "                          bits\n"
+           "  --lm75-oneshot          keep parts that support it in "
+           "shutdown,\n"
+           "                          converting once per read\n",
+           LM75_MIN_RESOLUTION, LM75_MAX_RESOLUTION);
+    printf("\nStaleness options:\n"
+           "  --stale-periods=N       polling periods without a good reading "
+           "before\n"
+           "                          a sensor is reported stale "
+           "(default: %d)\n",
+           STALE_PERIODS);
+    printf("\nFilter options:\n"
+           "  --filter=SPEC           noise filter for all sensors: none, "
+           "median3,\n"
+           "                          median5, ema:PERCENT or "
+           "slew:MILIDEGREES\n"
+           "                          (default: none)\n");
+    printf("\nTrend options:\n"
+           "  --trend-window=N        readings in the trend fit "
+           "(default: %d)\n"
+           "  --trend-lead=SEC        raise the fan demand if the next fan "
+           "threshold is\n"
+           "                          predicted within SEC (default: 0, "
+           "disabled)\n",
+           TREND_WINDOW);
+    printf("\nRolling statistics options:\n"
+           "  --windows=LIST          windows to keep the minimum, maximum "
+           "and average\n"
+           "                          temperature over, as lengths with an "
+           "s, m, h or d\n"
+           "                          suffix, or none (default: %s)\n",
+           WINDOW_DEFAULT);
+    printf("\nSimulation options:\n"
+           "  --sim=FILE              simulate the sensors described in "
+           "scenario FILE,\n"
+           "                          instead of using the h/w description "
+           "files and i2c\n");
+    printf("\nVirtual sensor options:\n"
+           "  --virtual=FILE          add the virtual sensors defined in "
+           "FILE\n");
+    printf("\nRecord and replay options:\n"
+           "  --record=FILE           append every raw sensor sample to FILE\n"
+           "  --record-size=MB        size at which FILE is rotated to FILE.1 "
+           "(default: %d)\n"
+           "  --replay=FILE           replay the samples recorded in FILE, "
+           "then exit\n"
+           "  --replay-output=FILE    write the replay transcript to FILE "
+           "(default: stdout)\n",
+           RECORD_MAX_SIZE_MB);
+    printf("\nMetrics options:\n"
+           "  --metrics=PATH          serve OpenMetrics text on unix socket "
+           "PATH\n");
+    printf("\nStandby options:\n"
+           "  --mirror=PATH           without the lock, stand by mirroring "
+           "the active\n"
+           "                          process on unix socket PATH; with it, "
+           "serve PATH\n");
+    printf("\nSharding options:\n"
+           "  --subsystems=GLOB[,GLOB...]  only handle the subsystems "
+           "matching a GLOB,\n"
+           "                          with a lock of their own\n");
     printf("\nOther options:\n"
            "  --unixctl=SOCKET        override default control socket name\n"
            "  -h, --help              display this help message\n"
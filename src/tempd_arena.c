@@ -0,0 +1,169 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Arena allocator for subsystem data
+ ***************************************************************************/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "util.h"
+#include "tempd_arena.h"
+
+#define ARENA_MIN_CHUNK_SIZE    1024    // smallest chunk added on overflow
+
+struct arena_chunk {
+    struct arena_chunk *next;   // older chunk
+    size_t size;                // bytes in data
+    size_t used;
+    char *data;
+};
+
+// the arena and its first chunk share a single allocation
+struct tempd_arena {
+    struct arena_chunk *chunks;         // newest first
+    struct arena_chunk first;
+    size_t n_allocs;
+};
+
+#define ARENA_HEADER_SIZE ROUND_UP(sizeof(struct tempd_arena), ARENA_ALIGN)
+
+// arenas created, and not yet destroyed, since startup (main thread only)
+static size_t n_arenas_created;
+static size_t n_arenas_live;
+
+// create an arena with room for size bytes of allocations
+struct tempd_arena *
+tempd_arena_create(size_t size)
+{
+    struct tempd_arena *arena;
+
+    size = ROUND_UP(size, ARENA_ALIGN);
+    arena = xmalloc(ARENA_HEADER_SIZE + size);
+    arena->first.next = NULL;
+    arena->first.size = size;
+    arena->first.used = 0;
+    arena->first.data = (char *)arena + ARENA_HEADER_SIZE;
+    arena->chunks = &arena->first;
+    arena->n_allocs = 0;
+    n_arenas_created++;
+    n_arenas_live++;
+
+    return(arena);
+}
+
+// free an arena and everything allocated from it
+void
+tempd_arena_destroy(struct tempd_arena *arena)
+{
+    struct arena_chunk *chunk, *next;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    for (chunk = arena->chunks; chunk != &arena->first; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    free(arena);
+    n_arenas_live--;
+}
+
+// allocate zeroed memory from an arena
+void *
+tempd_arena_alloc(struct tempd_arena *arena, size_t size)
+{
+    struct arena_chunk *chunk = arena->chunks;
+    void *result;
+
+    size = ROUND_UP(MAX(size, 1), ARENA_ALIGN);
+    if (chunk->size - chunk->used < size) {
+        size_t chunk_size = MAX(size, ARENA_MIN_CHUNK_SIZE);
+
+        chunk = xmalloc(ROUND_UP(sizeof(*chunk), ARENA_ALIGN) + chunk_size);
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->data = (char *)chunk + ROUND_UP(sizeof(*chunk), ARENA_ALIGN);
+        arena->chunks = chunk;
+    }
+
+    result = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->n_allocs++;
+    memset(result, 0, size);
+
+    return(result);
+}
+
+char *
+tempd_arena_strdup(struct tempd_arena *arena, const char *string)
+{
+    size_t length = strlen(string) + 1;
+
+    return(memcpy(tempd_arena_alloc(arena, length), string, length));
+}
+
+char *
+tempd_arena_asprintf(struct tempd_arena *arena, const char *format, ...)
+{
+    va_list args;
+    char *result;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    result = tempd_arena_alloc(arena, length + 1);
+    va_start(args, format);
+    vsnprintf(result, length + 1, format, args);
+    va_end(args);
+
+    return(result);
+}
+
+void
+tempd_arena_usage(const struct tempd_arena *arena,
+                  struct tempd_arena_usage *usage)
+{
+    const struct arena_chunk *chunk;
+
+    memset(usage, 0, sizeof(*usage));
+    for (chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+        usage->size += chunk->size;
+        usage->used += chunk->used;
+        usage->n_chunks++;
+    }
+    usage->n_allocs = arena->n_allocs;
+}
+
+// arenas created since startup, and those still in use: a steady rise in
+// the latter as subsystems come and go is a leak
+void
+tempd_arena_totals(size_t *n_created, size_t *n_live)
+{
+    *n_created = n_arenas_created;
+    *n_live = n_arenas_live;
+}
@@ -0,0 +1,114 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Fault circuit breaker for sensors and i2c buses
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "tempd_breaker.h"
+
+// must match tempd_breaker_state enum
+static const char *breaker_state[] = {
+    "closed",
+    "open",
+    "probing"
+};
+
+void
+tempd_breaker_init(struct tempd_breaker *breaker, int trip)
+{
+    memset(breaker, 0, sizeof(*breaker));
+    breaker->state = BREAKER_CLOSED;
+    breaker->trip = trip;
+    breaker->backoff = BREAKER_MIN_BACKOFF_MS;
+}
+
+// decide whether the device may be accessed now
+// an open breaker lets a single probe through once its interval has passed
+bool
+tempd_breaker_allow(struct tempd_breaker *breaker, long long now)
+{
+    if (breaker->state != BREAKER_OPEN) {
+        return(true);
+    }
+
+    if (now >= breaker->next_probe) {
+        breaker->state = BREAKER_PROBING;
+        breaker->n_probes++;
+        return(true);
+    }
+
+    breaker->n_skipped++;
+    return(false);
+}
+
+// record the result of a device access (rc is 0 on success)
+// returns true if the breaker opened or closed as a result
+bool
+tempd_breaker_record(struct tempd_breaker *breaker, int rc, long long now)
+{
+    breaker->n_reads++;
+
+    if (rc == 0) {
+        breaker->failures = 0;
+        if (breaker->state == BREAKER_CLOSED) {
+            return(false);
+        }
+        breaker->state = BREAKER_CLOSED;
+        breaker->backoff = BREAKER_MIN_BACKOFF_MS;
+        return(true);
+    }
+
+    breaker->n_faults++;
+    breaker->failures++;
+    breaker->last_error = rc;
+    breaker->last_error_time = now;
+
+    if (breaker->state == BREAKER_PROBING) {
+        // failed probe: stay open, and wait twice as long for the next one
+        breaker->state = BREAKER_OPEN;
+        breaker->backoff *= 2;
+        if (breaker->backoff > BREAKER_MAX_BACKOFF_MS) {
+            breaker->backoff = BREAKER_MAX_BACKOFF_MS;
+        }
+        breaker->next_probe = now + breaker->backoff;
+        return(false);
+    }
+
+    if (breaker->state == BREAKER_CLOSED && breaker->failures >= breaker->trip) {
+        breaker->state = BREAKER_OPEN;
+        breaker->n_trips++;
+        breaker->backoff = BREAKER_MIN_BACKOFF_MS;
+        breaker->next_probe = now + breaker->backoff;
+        return(true);
+    }
+
+    return(false);
+}
+
+const char *
+tempd_breaker_state_to_string(enum tempd_breaker_state state)
+{
+    if (state < sizeof(breaker_state)/sizeof(const char *)) {
+        return(breaker_state[state]);
+    }
+    return(breaker_state[BREAKER_CLOSED]);
+}
@@ -0,0 +1,137 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Advisory i2c bus locks shared with other daemons
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "ovs-thread.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_buslock.h"
+#include "tempd_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_buslock);
+
+struct tempd_buslock {
+    struct ovs_mutex mutex;     // held between acquire and release
+    int fd;                     // the lock file
+    bool locked;                // fd is flock()ed
+    char *file_name;
+};
+
+// open the lock file for a bus. Returns NULL (and logs why) if it can't be
+// opened: the bus is then used without locking.
+struct tempd_buslock *
+tempd_buslock_open(const char *dir, const char *bus)
+{
+    struct tempd_buslock *lock;
+    char *file_name;
+    char *p;
+    int fd;
+
+    file_name = xasprintf("%s/%s.lock", dir, bus);
+    for (p = file_name + strlen(dir) + 1; *p != '\0'; p++) {
+        if (*p == '/') {
+            *p = '_';
+        }
+    }
+
+    fd = open(file_name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        VLOG_WARN("%s: open failed (%s), using bus %s without locking",
+                  file_name, ovs_strerror(errno), bus);
+        free(file_name);
+        return(NULL);
+    }
+
+    lock = xzalloc(sizeof(*lock));
+    ovs_mutex_init(&lock->mutex);
+    lock->fd = fd;
+    lock->file_name = file_name;
+
+    return(lock);
+}
+
+void
+tempd_buslock_close(struct tempd_buslock *lock)
+{
+    if (lock == NULL) {
+        return;
+    }
+
+    close(lock->fd);
+    ovs_mutex_destroy(&lock->mutex);
+    free(lock->file_name);
+    free(lock);
+}
+
+// take the lock for a transfer. Returns false if another process held it
+// for too long, in which case the caller goes ahead without it (but must
+// still call tempd_buslock_release()).
+bool
+tempd_buslock_acquire(struct tempd_buslock *lock)
+{
+    long long start = tempd_stats_start();
+    long long deadline;
+
+    ovs_mutex_lock(&lock->mutex);
+
+    deadline = time_msec() + BUSLOCK_TIMEOUT_MS;
+    while (flock(lock->fd, LOCK_EX | LOCK_NB) != 0) {
+        int error = errno;
+
+        if ((error != EWOULDBLOCK && error != EINTR) ||
+                time_msec() >= deadline) {
+            static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+            VLOG_WARN_RL(&rl, "%s: %s, using the bus without it",
+                         lock->file_name, error == EWOULDBLOCK
+                         ? "timed out waiting for the lock"
+                         : ovs_strerror(error));
+            tempd_stats_count(STATS_BUS_LOCK_TIMEOUTS, 1);
+            tempd_stats_record(STATS_BUS_LOCK_TIME, start);
+            return(false);
+        }
+        usleep(BUSLOCK_RETRY_US);
+    }
+    lock->locked = true;
+    tempd_stats_record(STATS_BUS_LOCK_TIME, start);
+
+    return(true);
+}
+
+void
+tempd_buslock_release(struct tempd_buslock *lock)
+{
+    if (lock->locked) {
+        flock(lock->fd, LOCK_UN);
+        lock->locked = false;
+    }
+    ovs_mutex_unlock(&lock->mutex);
+}
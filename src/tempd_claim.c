@@ -0,0 +1,423 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Subsystem claims: an OVSDB lock for each subsystem handled
+ ***************************************************************************/
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "json.h"
+#include "jsonrpc.h"
+#include "sha1.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_claim.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_claim);
+
+#define CLAIM_LOCK_PREFIX   "ops_tempd_subsystem_"
+#define CLAIM_CUR_HW_LOCK   "ops_tempd_cur_hw"
+#define CLAIM_MAX_RECV      50          // messages handled per run
+
+enum claim_state {
+    CLAIM_WANTED,           // not asked for (on this connection)
+    CLAIM_WAITING,          // asked for, and not granted yet
+    CLAIM_HELD
+};
+
+struct claim {
+    char *subsystem;        // NULL for the cur_hw claim
+    char *lock;             // OVSDB lock name
+    enum claim_state state;
+    struct json *request_id;    // of the lock request, while waiting
+    bool listed;            // wanted, as of the last tempd_claim_end
+    bool contended;         // held by another instance when asked for
+};
+
+static struct jsonrpc_session *session;
+static unsigned int session_seqno;
+static bool enabled = false;
+static unsigned int claim_seqno = 1;    // bumped when a claim comes or goes
+
+// subsystem claims, by subsystem name
+static struct shash claims = SHASH_INITIALIZER(&claims);
+static struct claim cur_hw_claim = { NULL, CLAIM_CUR_HW_LOCK, CLAIM_WANTED,
+                                     NULL, true, false };
+
+// connect to the database at remote (as the IDL does)
+void
+tempd_claim_open(const char *remote)
+{
+    session = jsonrpc_session_open(remote, true);
+    session_seqno = jsonrpc_session_get_seqno(session);
+}
+
+static void
+claim_destroy(struct claim *claim)
+{
+    json_destroy(claim->request_id);
+    free(claim->subsystem);
+    free(claim->lock);
+    free(claim);
+}
+
+void
+tempd_claim_close(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &claims) {
+        claim_destroy(node->data);
+    }
+    shash_destroy(&claims);
+    json_destroy(cur_hw_claim.request_id);
+    cur_hw_claim.request_id = NULL;
+
+    // (the server releases whatever was held)
+    jsonrpc_session_close(session);
+    session = NULL;
+}
+
+static void
+claim_send(const char *method, struct claim *claim, struct json **idp)
+{
+    struct json *params;
+
+    params = json_array_create_1(json_string_create(claim->lock));
+    jsonrpc_session_send(session, jsonrpc_create_request(method, params, idp));
+}
+
+static void
+claim_set_state(struct claim *claim, enum claim_state state)
+{
+    if ((claim->state == CLAIM_HELD) != (state == CLAIM_HELD)) {
+        claim_seqno++;
+    }
+    claim->state = state;
+}
+
+static void
+claim_request(struct claim *claim)
+{
+    json_destroy(claim->request_id);
+    claim_send("lock", claim, &claim->request_id);
+    claim_set_state(claim, CLAIM_WAITING);
+}
+
+// give a claim up (or stop waiting for it)
+static void
+claim_release(struct claim *claim)
+{
+    if (claim->state != CLAIM_WANTED) {
+        claim_send("unlock", claim, NULL);
+    }
+    json_destroy(claim->request_id);
+    claim->request_id = NULL;
+    claim_set_state(claim, CLAIM_WANTED);
+}
+
+static struct claim *
+claim_find_lock(const char *lock)
+{
+    struct shash_node *node;
+
+    if (strcmp(lock, CLAIM_CUR_HW_LOCK) == 0) {
+        return(&cur_hw_claim);
+    }
+    // (only on notifications, which are rare)
+    SHASH_FOR_EACH(node, &claims) {
+        struct claim *claim = node->data;
+
+        if (strcmp(claim->lock, lock) == 0) {
+            return(claim);
+        }
+    }
+
+    return(NULL);
+}
+
+static struct claim *
+claim_find_request(const struct json *id)
+{
+    struct shash_node *node;
+
+    if (id == NULL) {
+        return(NULL);
+    }
+    if (cur_hw_claim.request_id != NULL &&
+            json_equal(cur_hw_claim.request_id, id)) {
+        return(&cur_hw_claim);
+    }
+    SHASH_FOR_EACH(node, &claims) {
+        struct claim *claim = node->data;
+
+        if (claim->request_id != NULL && json_equal(claim->request_id, id)) {
+            return(claim);
+        }
+    }
+
+    return(NULL);
+}
+
+static void
+claim_granted(struct claim *claim)
+{
+    json_destroy(claim->request_id);
+    claim->request_id = NULL;
+    claim_set_state(claim, CLAIM_HELD);
+    if (claim->contended && claim->subsystem != NULL) {
+        VLOG_INFO("claimed subsystem %s", claim->subsystem);
+    }
+    claim->contended = false;
+}
+
+// another instance holds a claim we asked for: the server queues us for it
+static void
+claim_contended(struct claim *claim)
+{
+    if (claim->subsystem != NULL && !claim->contended) {
+        VLOG_ERR("subsystem %s is claimed by another ops-tempd (do their "
+                 "--subsystems overlap, or is one without it?): leaving it "
+                 "to that one", claim->subsystem);
+    }
+    claim->contended = true;
+}
+
+static void
+claim_receive(const struct jsonrpc_msg *msg)
+{
+    const struct json_array *params;
+    struct claim *claim;
+
+    if (msg->type == JSONRPC_REPLY || msg->type == JSONRPC_ERROR) {
+        const struct json *locked = NULL;
+
+        claim = claim_find_request(msg->id);
+        if (claim == NULL) {
+            return;
+        }
+        if (msg->type == JSONRPC_REPLY && msg->result->type == JSON_OBJECT) {
+            locked = shash_find_data(json_object(msg->result), "locked");
+        }
+        if (locked == NULL) {
+            VLOG_WARN("lock %s: unexpected reply", claim->lock);
+        } else if (json_boolean(locked)) {
+            claim_granted(claim);
+        } else {
+            claim_contended(claim);
+        }
+    } else if (msg->type == JSONRPC_NOTIFY && msg->params != NULL &&
+               msg->params->type == JSON_ARRAY) {
+        params = json_array(msg->params);
+        if (params->n != 1 || params->elems[0]->type != JSON_STRING) {
+            return;
+        }
+        claim = claim_find_lock(json_string(params->elems[0]));
+        if (claim == NULL || claim->state == CLAIM_WANTED) {
+            return;
+        }
+        if (!strcmp(msg->method, "locked")) {
+            claim_granted(claim);
+        } else if (!strcmp(msg->method, "stolen")) {
+            VLOG_WARN("lock %s was stolen", claim->lock);
+            claim_release(claim);
+        }
+    }
+}
+
+// ask for the claims not asked for yet
+static void
+claim_request_wanted(void)
+{
+    struct shash_node *node;
+
+    if (!enabled || !jsonrpc_session_is_connected(session)) {
+        return;
+    }
+    SHASH_FOR_EACH(node, &claims) {
+        struct claim *claim = node->data;
+
+        if (claim->state == CLAIM_WANTED) {
+            claim_request(claim);
+        }
+    }
+    if (cur_hw_claim.state == CLAIM_WANTED) {
+        claim_request(&cur_hw_claim);
+    }
+}
+
+// take (while enabled, that is while holding the ops-tempd lock) or give up
+// the claims
+void
+tempd_claim_run(bool enable)
+{
+    struct shash_node *node;
+    int n;
+
+    jsonrpc_session_run(session);
+    if (jsonrpc_session_get_seqno(session) != session_seqno) {
+        // a new connection (or none): the server dropped everything
+        session_seqno = jsonrpc_session_get_seqno(session);
+        SHASH_FOR_EACH(node, &claims) {
+            struct claim *claim = node->data;
+
+            json_destroy(claim->request_id);
+            claim->request_id = NULL;
+            claim_set_state(claim, CLAIM_WANTED);
+        }
+        json_destroy(cur_hw_claim.request_id);
+        cur_hw_claim.request_id = NULL;
+        claim_set_state(&cur_hw_claim, CLAIM_WANTED);
+    }
+
+    for (n = 0; n < CLAIM_MAX_RECV; n++) {
+        struct jsonrpc_msg *msg = jsonrpc_session_recv(session);
+
+        if (msg == NULL) {
+            break;
+        }
+        claim_receive(msg);
+        jsonrpc_msg_destroy(msg);
+    }
+
+    enabled = enable;
+    if (!enabled) {
+        SHASH_FOR_EACH(node, &claims) {
+            claim_release(node->data);
+        }
+        claim_release(&cur_hw_claim);
+    } else {
+        claim_request_wanted();
+    }
+}
+
+void
+tempd_claim_wait(void)
+{
+    jsonrpc_session_wait(session);
+    jsonrpc_session_recv_wait(session);
+}
+
+// the subsystems to claim are listed between tempd_claim_begin() and
+// tempd_claim_end(); the claims of those not listed are given up
+void
+tempd_claim_begin(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &claims) {
+        struct claim *claim = node->data;
+
+        claim->listed = false;
+    }
+}
+
+void
+tempd_claim_want(const char *subsystem)
+{
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    char hex[SHA1_HEX_DIGEST_LEN + 1];
+    struct claim *claim;
+
+    claim = shash_find_data(&claims, subsystem);
+    if (claim == NULL) {
+        // lock names are ids: letters, digits and underscores
+        sha1_bytes(subsystem, strlen(subsystem), digest);
+        sha1_to_hex(digest, hex);
+
+        claim = xzalloc(sizeof(*claim));
+        claim->subsystem = xstrdup(subsystem);
+        claim->lock = xasprintf("%s%s", CLAIM_LOCK_PREFIX, hex);
+        claim->state = CLAIM_WANTED;
+        shash_add(&claims, subsystem, claim);
+    }
+    claim->listed = true;
+}
+
+void
+tempd_claim_end(void)
+{
+    struct shash_node *node, *next;
+
+    SHASH_FOR_EACH_SAFE(node, next, &claims) {
+        struct claim *claim = node->data;
+
+        if (!claim->listed) {
+            claim_release(claim);
+            shash_delete(&claims, node);
+            claim_destroy(claim);
+        }
+    }
+    claim_request_wanted();
+}
+
+// true if this instance has claimed a subsystem: only then can it touch
+// the subsystem's devices and rows
+bool
+tempd_claim_held(const char *subsystem)
+{
+    const struct claim *claim = shash_find_data(&claims, subsystem);
+
+    return(claim != NULL && claim->state == CLAIM_HELD);
+}
+
+// true if this instance sets Daemon:cur_hw
+bool
+tempd_claim_cur_hw(void)
+{
+    return(cur_hw_claim.state == CLAIM_HELD);
+}
+
+// changes whenever a claim is granted or lost
+unsigned int
+tempd_claim_seqno(void)
+{
+    return(claim_seqno);
+}
+
+void
+tempd_claim_dump(struct ds *ds)
+{
+    struct shash_node *node;
+    size_t n_held = 0;
+
+    ds_put_cstr(ds, "\nSubsystem claims:\n");
+    ds_put_format(ds, "\tConnected: %s\n",
+                  jsonrpc_session_is_connected(session) ? "yes" : "no");
+    SHASH_FOR_EACH(node, &claims) {
+        struct claim *claim = node->data;
+
+        if (claim->state == CLAIM_HELD) {
+            n_held++;
+        } else if (claim->contended) {
+            ds_put_format(ds, "\tClaimed by another ops-tempd: %s\n",
+                          claim->subsystem);
+        }
+    }
+    ds_put_format(ds, "\tClaimed: %"PRIuSIZE" of %"PRIuSIZE"\n", n_held,
+                  shash_count(&claims));
+    ds_put_format(ds, "\tSets cur_hw: %s\n",
+                  tempd_claim_cur_hw() ? "yes" : "no");
+}
@@ -0,0 +1,185 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor noise filters
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tempd_filter.h"
+
+// EMA weights are kept in 1/256ths
+#define EMA_SHIFT   8
+#define EMA_ONE     (1 << EMA_SHIFT)
+
+void
+tempd_filter_init(struct tempd_filter *filter,
+                  const struct tempd_filter_config *config)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->config = *config;
+}
+
+// median of the newest count readings in the history
+static int
+filter_median(const struct tempd_filter *filter, int count)
+{
+    int sorted[FILTER_HISTORY];
+    int n = filter->n_history < count ? filter->n_history : count;
+    int idx;
+    int pos;
+
+    // insertion sort of (at most) the newest FILTER_HISTORY readings
+    for (idx = 0; idx < n; idx++) {
+        int slot = (filter->next - 1 - idx + FILTER_HISTORY) % FILTER_HISTORY;
+        int value = filter->history[slot];
+
+        for (pos = idx; pos > 0 && sorted[pos - 1] > value; pos--) {
+            sorted[pos] = sorted[pos - 1];
+        }
+        sorted[pos] = value;
+    }
+
+    // for an even count (history still filling), average the middle two
+    if (n % 2 == 0) {
+        return((sorted[n / 2 - 1] + sorted[n / 2]) / 2);
+    }
+    return(sorted[n / 2]);
+}
+
+// filter a raw reading (milidegrees), returning the filtered value
+int
+tempd_filter_apply(struct tempd_filter *filter, int raw)
+{
+    int value = raw;
+    int delta;
+
+    filter->history[filter->next] = raw;
+    filter->next = (filter->next + 1) % FILTER_HISTORY;
+    if (filter->n_history < FILTER_HISTORY) {
+        filter->n_history++;
+    }
+
+    switch (filter->config.type) {
+    case FILTER_MEDIAN3:
+        value = filter_median(filter, 3);
+        break;
+
+    case FILTER_MEDIAN5:
+        value = filter_median(filter, 5);
+        break;
+
+    case FILTER_EMA:
+        if (!filter->primed) {
+            filter->ema = (long long)raw << EMA_SHIFT;
+        } else {
+            filter->ema += (filter->config.param *
+                            (((long long)raw << EMA_SHIFT) - filter->ema))
+                           / EMA_ONE;
+        }
+        // round to the nearest milidegree
+        value = (int)((filter->ema + EMA_ONE / 2) >> EMA_SHIFT);
+        break;
+
+    case FILTER_SLEW:
+        if (filter->primed) {
+            delta = raw - filter->value;
+            if (delta > filter->config.param) {
+                delta = filter->config.param;
+            } else if (delta < -filter->config.param) {
+                delta = -filter->config.param;
+            }
+            value = filter->value + delta;
+        }
+        break;
+
+    case FILTER_NONE:
+    default:
+        break;
+    }
+
+    filter->value = value;
+    filter->primed = true;
+
+    return(value);
+}
+
+// parse a filter specification. Returns false if it isn't valid.
+bool
+tempd_filter_parse(const char *spec, struct tempd_filter_config *config)
+{
+    char *end;
+    long param;
+
+    config->param = 0;
+
+    if (strcmp(spec, "none") == 0) {
+        config->type = FILTER_NONE;
+    } else if (strcmp(spec, "median3") == 0) {
+        config->type = FILTER_MEDIAN3;
+    } else if (strcmp(spec, "median5") == 0) {
+        config->type = FILTER_MEDIAN5;
+    } else if (strncmp(spec, "ema:", 4) == 0) {
+        param = strtol(spec + 4, &end, 10);
+        if (end == spec + 4 || *end != '\0' || param < 1 || param > 100) {
+            return(false);
+        }
+        config->type = FILTER_EMA;
+        config->param = (int)((param * EMA_ONE + 50) / 100);
+    } else if (strncmp(spec, "slew:", 5) == 0) {
+        param = strtol(spec + 5, &end, 10);
+        if (end == spec + 5 || *end != '\0' || param < 1 || param > 1000000) {
+            return(false);
+        }
+        config->type = FILTER_SLEW;
+        config->param = (int)param;
+    } else {
+        return(false);
+    }
+
+    return(true);
+}
+
+// format a filter specification, in the form accepted by tempd_filter_parse
+void
+tempd_filter_format(const struct tempd_filter_config *config,
+                    char *buf, size_t size)
+{
+    switch (config->type) {
+    case FILTER_MEDIAN3:
+        snprintf(buf, size, "median3");
+        break;
+    case FILTER_MEDIAN5:
+        snprintf(buf, size, "median5");
+        break;
+    case FILTER_EMA:
+        snprintf(buf, size, "ema:%d", (config->param * 100 + EMA_ONE / 2) / EMA_ONE);
+        break;
+    case FILTER_SLEW:
+        snprintf(buf, size, "slew:%d", config->param);
+        break;
+    case FILTER_NONE:
+    default:
+        snprintf(buf, size, "none");
+        break;
+    }
+}
@@ -0,0 +1,270 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Native i2c-dev access, batching register reads with I2C_RDWR
+ ***************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "config.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_i2cdev.h"
+#include "tempd_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_i2cdev);
+
+// register reads in a single I2C_RDWR ioctl: a pointer write and a read each
+#define I2CDEV_BATCH_READS  (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+struct tempd_i2cdev {
+    int fd;
+    bool smbus_only;        // the adapter can't do plain i2c transfers
+    char *path;
+};
+
+// open an i2c-dev device. Returns NULL (and logs why) if it can't be used:
+// the bus is then accessed through config-yaml.
+struct tempd_i2cdev *
+tempd_i2cdev_open(const char *path)
+{
+    struct tempd_i2cdev *dev;
+    unsigned long funcs;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        VLOG_WARN("%s: open failed (%s), using config-yaml instead",
+                  path, ovs_strerror(errno));
+        return(NULL);
+    }
+
+    if (ioctl(fd, I2C_FUNCS, &funcs) < 0) {
+        VLOG_WARN("%s: unable to get the adapter's functions (%s), using "
+                  "config-yaml instead", path, ovs_strerror(errno));
+        close(fd);
+        return(NULL);
+    }
+
+    if (!(funcs & I2C_FUNC_I2C) &&
+            (funcs & (I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_WORD_DATA))
+            != (I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_WORD_DATA)) {
+        VLOG_WARN("%s: the adapter can't do register transfers, using "
+                  "config-yaml instead", path);
+        close(fd);
+        return(NULL);
+    }
+
+    dev = xzalloc(sizeof(*dev));
+    dev->fd = fd;
+    dev->smbus_only = !(funcs & I2C_FUNC_I2C);
+    dev->path = xstrdup(path);
+    VLOG_INFO("%s: opened%s", path, dev->smbus_only ? " (SMBus only)" : "");
+
+    return(dev);
+}
+
+void
+tempd_i2cdev_close(struct tempd_i2cdev *dev)
+{
+    if (dev == NULL) {
+        return;
+    }
+
+    close(dev->fd);
+    free(dev->path);
+    free(dev);
+}
+
+// issue an I2C_RDWR ioctl. Returns 0 or an errno value.
+static int
+i2cdev_rdwr(struct tempd_i2cdev *dev, struct i2c_msg *msgs, size_t n_msgs)
+{
+    struct i2c_rdwr_ioctl_data data;
+
+    data.msgs = msgs;
+    data.nmsgs = n_msgs;
+
+    tempd_stats_count(STATS_I2C_TRANSFERS, 1);
+    if (ioctl(dev->fd, I2C_RDWR, &data) < 0) {
+        return(errno);
+    }
+
+    return(0);
+}
+
+// an SMBus byte or word register transfer (SMBus-only adapters). Returns 0
+// or an errno value.
+static int
+i2cdev_smbus(struct tempd_i2cdev *dev, int address, char read_write,
+             int reg, int length, char *buf)
+{
+    struct i2c_smbus_ioctl_data args;
+    union i2c_smbus_data data;
+
+    if (length != 1 && length != 2) {
+        return(EOPNOTSUPP);
+    }
+
+    tempd_stats_count(STATS_I2C_TRANSFERS, 2);
+    if (ioctl(dev->fd, I2C_SLAVE, address) < 0) {
+        return(errno);
+    }
+
+    // SMBus words are sent low byte first, so the register's first byte
+    // is the word's low byte
+    if (length == 1) {
+        data.byte = (unsigned char)buf[0];
+    } else {
+        data.word = (unsigned char)buf[0] | ((unsigned char)buf[1] << 8);
+    }
+
+    args.read_write = read_write;
+    args.command = reg;
+    args.size = length == 1 ? I2C_SMBUS_BYTE_DATA : I2C_SMBUS_WORD_DATA;
+    args.data = &data;
+    if (ioctl(dev->fd, I2C_SMBUS, &args) < 0) {
+        return(errno);
+    }
+
+    if (length == 1) {
+        buf[0] = data.byte;
+    } else {
+        buf[0] = data.word & 0xff;
+        buf[1] = data.word >> 8;
+    }
+
+    return(0);
+}
+
+// read a batch of registers, filling in each read's result
+void
+tempd_i2cdev_read_batch(struct tempd_i2cdev *dev,
+                        struct tempd_i2cdev_read *reads, size_t n)
+{
+    struct i2c_msg msgs[2 * I2CDEV_BATCH_READS];
+    uint8_t regs[I2CDEV_BATCH_READS];
+    size_t start;
+    size_t idx;
+
+    if (dev->smbus_only) {
+        for (idx = 0; idx < n; idx++) {
+            reads[idx].rc = i2cdev_smbus(dev, reads[idx].address,
+                                         I2C_SMBUS_READ, reads[idx].reg,
+                                         reads[idx].length, reads[idx].buf);
+        }
+        return;
+    }
+
+    for (start = 0; start < n; start += I2CDEV_BATCH_READS) {
+        size_t count = MIN(n - start, I2CDEV_BATCH_READS);
+        int rc;
+
+        for (idx = 0; idx < count; idx++) {
+            struct tempd_i2cdev_read *read = &reads[start + idx];
+
+            regs[idx] = read->reg;
+            msgs[2 * idx].addr = read->address;
+            msgs[2 * idx].flags = 0;
+            msgs[2 * idx].len = 1;
+            msgs[2 * idx].buf = &regs[idx];
+            msgs[2 * idx + 1].addr = read->address;
+            msgs[2 * idx + 1].flags = I2C_M_RD;
+            msgs[2 * idx + 1].len = read->length;
+            msgs[2 * idx + 1].buf = (uint8_t *)read->buf;
+        }
+
+        rc = i2cdev_rdwr(dev, msgs, 2 * count);
+        for (idx = 0; idx < count; idx++) {
+            struct tempd_i2cdev_read *read = &reads[start + idx];
+
+            // if the batch failed, find out which of the reads did
+            read->rc = rc == 0 ? 0 : tempd_i2cdev_read(dev, read->address,
+                                                       read->reg,
+                                                       read->length,
+                                                       read->buf);
+        }
+    }
+}
+
+// read a register. Returns 0 or an errno value, like i2c_data_read.
+int
+tempd_i2cdev_read(struct tempd_i2cdev *dev, int address, int reg, int length,
+                  char *buf)
+{
+    struct i2c_msg msgs[2];
+    uint8_t pointer = reg;
+
+    if (dev->smbus_only) {
+        return(i2cdev_smbus(dev, address, I2C_SMBUS_READ, reg, length, buf));
+    }
+
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &pointer;
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = length;
+    msgs[1].buf = (uint8_t *)buf;
+
+    return(i2cdev_rdwr(dev, msgs, 2));
+}
+
+// write a register. Returns 0 or an errno value, like i2c_data_write.
+int
+tempd_i2cdev_write(struct tempd_i2cdev *dev, int address, int reg, int length,
+                   const char *buf)
+{
+    struct i2c_msg msg;
+    uint8_t data[1 + 2];
+
+    if (dev->smbus_only) {
+        char copy[2];
+
+        if ((size_t)length > sizeof(copy)) {
+            return(EOPNOTSUPP);
+        }
+        memcpy(copy, buf, length);
+        return(i2cdev_smbus(dev, address, I2C_SMBUS_WRITE, reg, length,
+                            copy));
+    }
+
+    if ((size_t)length > sizeof(data) - 1) {
+        return(EOPNOTSUPP);
+    }
+    data[0] = reg;
+    memcpy(&data[1], buf, length);
+
+    msg.addr = address;
+    msg.flags = 0;
+    msg.len = 1 + length;
+    msg.buf = data;
+
+    return(i2cdev_rdwr(dev, &msg, 1));
+}
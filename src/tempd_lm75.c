@@ -0,0 +1,118 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * LM75-class device configuration: resolution and one-shot conversion
+ ***************************************************************************/
+
+#include <string.h>
+#include <strings.h>
+
+#include "config.h"
+#include "util.h"
+#include "tempd_lm75.h"
+
+static const struct tempd_lm75_part lm75_parts[] = {
+    { "lm75",   9,  false, 0 },
+    { "lm75a",  11, false, 0 },
+    { "lm75b",  11, false, 0 },
+    { "ds75",   0,  false, 0 },
+    { "ds7505", 0,  true,  25000 },
+    { "tmp75",  0,  true,  37500 },
+    { "tmp175", 0,  true,  37500 },
+    { "tmp275", 0,  true,  37500 },
+};
+
+// look up a part by device type (case insensitive). Returns NULL if it's
+// not a known part.
+const struct tempd_lm75_part *
+tempd_lm75_find_part(const char *type)
+{
+    size_t idx;
+
+    if (type == NULL) {
+        return(NULL);
+    }
+
+    for (idx = 0; idx < ARRAY_SIZE(lm75_parts); idx++) {
+        if (strcasecmp(lm75_parts[idx].type, type) == 0) {
+            return(&lm75_parts[idx]);
+        }
+    }
+
+    return(NULL);
+}
+
+// the power-on state of a part (NULL for an unknown one): converting
+// continuously, at its lowest resolution
+void
+tempd_lm75_init(struct tempd_lm75 *lm75, const struct tempd_lm75_part *part)
+{
+    memset(lm75, 0, sizeof(*lm75));
+    lm75->part = part;
+    lm75->resolution = part != NULL && part->resolution != 0
+                       ? part->resolution : LM75_MIN_RESOLUTION;
+}
+
+// work out the configuration from the device's current configuration
+// register, the resolution wanted (0 to keep the current one) and whether
+// to use one-shot conversions. Settings the part doesn't have are left
+// alone. Returns true if the register has to be written.
+bool
+tempd_lm75_configure(struct tempd_lm75 *lm75, uint8_t config, int resolution,
+                     bool oneshot)
+{
+    const struct tempd_lm75_part *part = lm75->part;
+
+    lm75->config = config & ~LM75_CONFIG_ONESHOT;
+    if (part == NULL) {
+        return(false);
+    }
+
+    if (part->resolution == 0) {
+        if (resolution != 0) {
+            lm75->config &= ~LM75_CONFIG_RES_MASK;
+            lm75->config |= (resolution - LM75_MIN_RESOLUTION)
+                            << LM75_CONFIG_RES_SHIFT;
+        }
+        lm75->resolution = LM75_MIN_RESOLUTION +
+                           ((lm75->config & LM75_CONFIG_RES_MASK)
+                            >> LM75_CONFIG_RES_SHIFT);
+    }
+
+    lm75->oneshot = oneshot && part->oneshot;
+    if (lm75->oneshot) {
+        lm75->config |= LM75_CONFIG_SHUTDOWN;
+    } else {
+        lm75->config &= ~LM75_CONFIG_SHUTDOWN;
+    }
+    lm75->converting = false;
+
+    return(lm75->config != (config & ~LM75_CONFIG_ONESHOT));
+}
+
+// longest time a one-shot conversion takes, at the current resolution
+int
+tempd_lm75_conversion_ms(const struct tempd_lm75 *lm75)
+{
+    int conversion_us = lm75->part != NULL ? lm75->part->conversion_us : 0;
+
+    conversion_us <<= lm75->resolution - LM75_MIN_RESOLUTION;
+    return(DIV_ROUND_UP(conversion_us, 1000));
+}
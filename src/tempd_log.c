@@ -0,0 +1,159 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Deduplicated, rate-limited logging of sensor events
+ ***************************************************************************/
+
+#include <stdlib.h>
+
+#include "config.h"
+#include "ovs-thread.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_log.h"
+#include "tempd_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_log);
+
+#define LOG_INTERVAL        60000   // ms between summaries
+#define LOG_BURST           20      // first occurrences logged per interval
+#define LOG_MAX_SUMMARIES   20      // summary lines per interval
+#define LOG_MAX_KEYS        1024    // keys tracked, over all events
+
+struct log_key {
+    long long since;            // first occurrence not logged
+    long long last;             // last occurrence
+    unsigned int n_suppressed;  // occurrences not logged since the summary
+};
+
+static struct ovs_mutex log_mutex = OVS_MUTEX_INITIALIZER;
+static struct tempd_log_event *log_events;
+static size_t log_n_keys;
+static int log_budget = LOG_BURST;
+static unsigned int log_overflow;
+static long long log_next_summary;
+
+// count an occurrence of an event for a key. Returns true if it should be
+// logged: it's the first one for the key in a while, and the log budget
+// for this interval hasn't been used up.
+bool
+tempd_log_check(struct tempd_log_event *event, const char *key)
+{
+    struct log_key *entry;
+    long long now = time_msec();
+    bool result = false;
+
+    ovs_mutex_lock(&log_mutex);
+
+    if (log_next_summary == 0) {
+        log_next_summary = now + LOG_INTERVAL;
+    }
+    if (event->keys == NULL) {
+        event->keys = xmalloc(sizeof(*event->keys));
+        shash_init(event->keys);
+        event->next = log_events;
+        log_events = event;
+    }
+
+    entry = shash_find_data(event->keys, key);
+    if (entry == NULL && log_n_keys >= LOG_MAX_KEYS) {
+        // too many sources to keep track of: just count it
+        log_overflow++;
+    } else if (entry == NULL) {
+        entry = xzalloc(sizeof(*entry));
+        entry->last = now;
+        shash_add(event->keys, key, entry);
+        log_n_keys++;
+
+        if (log_budget > 0) {
+            log_budget--;
+            result = true;
+        } else {
+            entry->since = now;
+            entry->n_suppressed = 1;
+        }
+    } else {
+        if (entry->n_suppressed == 0) {
+            entry->since = now;
+        }
+        entry->n_suppressed++;
+        entry->last = now;
+    }
+
+    ovs_mutex_unlock(&log_mutex);
+
+    tempd_stats_count(result ? STATS_EVENTS_LOGGED : STATS_EVENTS_COALESCED, 1);
+    return(result);
+}
+
+// once per interval, log what has been suppressed and forget keys that
+// have been quiet
+void
+tempd_log_run(void)
+{
+    struct tempd_log_event *event;
+    long long now = time_msec();
+    unsigned int n_other = 0;
+    int n_summaries = 0;
+
+    ovs_mutex_lock(&log_mutex);
+
+    if (now < log_next_summary) {
+        ovs_mutex_unlock(&log_mutex);
+        return;
+    }
+
+    for (event = log_events; event != NULL; event = event->next) {
+        struct shash_node *node, *next;
+
+        SHASH_FOR_EACH_SAFE(node, next, event->keys) {
+            struct log_key *entry = node->data;
+
+            if (entry->n_suppressed > 0) {
+                if (n_summaries < LOG_MAX_SUMMARIES) {
+                    VLOG_WARN("%s (%s): %u more in %lld s", event->name,
+                              node->name, entry->n_suppressed,
+                              (now - entry->since + 999) / 1000);
+                    n_summaries++;
+                } else {
+                    n_other += entry->n_suppressed;
+                }
+                entry->n_suppressed = 0;
+            } else if (now - entry->last >= LOG_INTERVAL) {
+                free(entry);
+                shash_delete(event->keys, node);
+                log_n_keys--;
+            }
+        }
+    }
+
+    if (n_other > 0 || log_overflow > 0) {
+        VLOG_WARN("%u more sensor events in the last %d s",
+                  n_other + log_overflow, LOG_INTERVAL / 1000);
+    }
+
+    log_overflow = 0;
+    log_budget = LOG_BURST;
+    log_next_summary = now + LOG_INTERVAL;
+
+    ovs_mutex_unlock(&log_mutex);
+}
@@ -0,0 +1,493 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * OpenMetrics exposition on a unix domain socket
+ ***************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "poll-loop.h"
+#include "shash.h"
+#include "stream.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_metrics.h"
+#include "tempd_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_metrics);
+
+#define METRICS_MAX_CONNS       8       // clients served at once
+#define METRICS_MAX_REQUEST     4096    // bytes of request accepted
+#define METRICS_TIMEOUT_MS      5000    // time allowed per connection
+
+// metric families with per-sensor samples, in the order they're reported
+enum metrics_family {
+    FAMILY_TEMPERATURE = 0,
+    FAMILY_STATUS,
+    FAMILY_FAN,
+    FAMILY_READS,
+    FAMILY_FAULTS,
+    N_FAMILIES
+};
+
+// must match metrics_family enum
+static const char *family_headers[] = {
+    "# TYPE tempd_temperature_celsius gauge\n"
+    "# UNIT tempd_temperature_celsius celsius\n"
+    "# HELP tempd_temperature_celsius Filtered sensor temperature.\n",
+    "# TYPE tempd_sensor_status stateset\n"
+    "# HELP tempd_sensor_status Sensor alarm status.\n",
+    "# TYPE tempd_fan_demand stateset\n"
+    "# HELP tempd_fan_demand Fan speed requested by the sensor.\n",
+    "# TYPE tempd_sensor_reads counter\n"
+    "# HELP tempd_sensor_reads Sensor device reads.\n",
+    "# TYPE tempd_sensor_faults counter\n"
+    "# HELP tempd_sensor_faults Failed sensor device reads.\n"
+};
+
+// the published state of a sensor, and its cached text
+struct metrics_sensor {
+    char *labels;                   // label set, without the braces
+    int temp;
+    enum sensorstatus status;
+    enum fanspeed fan_demand;
+    uint64_t n_reads;
+    uint64_t n_faults;
+    char *text[N_FAMILIES];         // samples of each family
+};
+
+// a client connection
+struct metrics_conn {
+    struct stream *stream;
+    struct ds request;
+    struct ds reply;
+    size_t sent;            // bytes of the reply sent so far
+    long long deadline;     // time_msec() at which the connection is dropped
+};
+
+static struct pstream *pstream;
+static struct metrics_conn conns[METRICS_MAX_CONNS];
+static int n_conns;
+
+static struct shash metrics_sensors = SHASH_INITIALIZER(&metrics_sensors);
+static struct ds sensor_text = DS_EMPTY_INITIALIZER;
+static bool sensor_text_valid = false;
+
+// listen on the unix socket at path. Returns 0 or an errno value.
+int
+tempd_metrics_open(const char *path)
+{
+    char *name = xasprintf("punix:%s", path);
+    int error;
+
+    error = pstream_open(name, &pstream, DSCP_DEFAULT);
+    if (error) {
+        VLOG_ERR("%s: listen failed (%s)", name, ovs_strerror(error));
+    }
+    free(name);
+
+    return(error);
+}
+
+static void
+metrics_sensor_destroy(struct metrics_sensor *ms)
+{
+    int family;
+
+    for (family = 0; family < N_FAMILIES; family++) {
+        free(ms->text[family]);
+    }
+    free(ms->labels);
+    free(ms);
+}
+
+static void
+metrics_conn_close(struct metrics_conn *conn)
+{
+    stream_close(conn->stream);
+    ds_destroy(&conn->request);
+    ds_destroy(&conn->reply);
+    *conn = conns[--n_conns];
+}
+
+void
+tempd_metrics_close(void)
+{
+    struct shash_node *node;
+
+    while (n_conns > 0) {
+        metrics_conn_close(&conns[0]);
+    }
+    pstream_close(pstream);
+    pstream = NULL;
+
+    SHASH_FOR_EACH(node, &metrics_sensors) {
+        metrics_sensor_destroy(node->data);
+    }
+    shash_clear(&metrics_sensors);
+    ds_destroy(&sensor_text);
+    sensor_text_valid = false;
+}
+
+// append a label value, escaped
+static void
+metrics_put_label(struct ds *ds, const char *value)
+{
+    for (; *value != '\0'; value++) {
+        if (*value == '\\' || *value == '"') {
+            ds_put_char(ds, '\\');
+            ds_put_char(ds, *value);
+        } else if (*value == '\n') {
+            ds_put_cstr(ds, "\\n");
+        } else {
+            ds_put_char(ds, *value);
+        }
+    }
+}
+
+// format the samples of one family for a sensor
+static char *
+metrics_sensor_text(const struct metrics_sensor *ms,
+                    enum metrics_family family)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    int idx;
+
+    switch (family) {
+    case FAMILY_TEMPERATURE:
+        ds_put_format(&ds, "tempd_temperature_celsius{%s} %.3f\n",
+                      ms->labels, ms->temp / MILI_DEGREES_FLOAT);
+        break;
+    case FAMILY_STATUS:
+        for (idx = SENSOR_STATUS_UNINITIALIZED;
+                idx <= SENSOR_STATUS_EMERGENCY; idx++) {
+            ds_put_format(&ds, "tempd_sensor_status{%s,tempd_sensor_status="
+                          "\"%s\"} %d\n", ms->labels, sensor_status[idx],
+                          ms->status == idx);
+        }
+        break;
+    case FAMILY_FAN:
+        for (idx = SENSOR_FAN_NORMAL; idx <= SENSOR_FAN_MAX; idx++) {
+            ds_put_format(&ds, "tempd_fan_demand{%s,tempd_fan_demand="
+                          "\"%s\"} %d\n", ms->labels, fan_speed[idx],
+                          ms->fan_demand == idx);
+        }
+        break;
+    case FAMILY_READS:
+        ds_put_format(&ds, "tempd_sensor_reads_total{%s} %"PRIu64"\n",
+                      ms->labels, ms->n_reads);
+        break;
+    case FAMILY_FAULTS:
+        ds_put_format(&ds, "tempd_sensor_faults_total{%s} %"PRIu64"\n",
+                      ms->labels, ms->n_faults);
+        break;
+    default:
+        OVS_NOT_REACHED();
+    }
+
+    return(ds_steal_cstr(&ds));
+}
+
+// refresh the cached text of a family, if its value changed
+static void
+metrics_sensor_set(struct metrics_sensor *ms, enum metrics_family family,
+                   bool changed)
+{
+    if (changed || ms->text[family] == NULL) {
+        free(ms->text[family]);
+        ms->text[family] = metrics_sensor_text(ms, family);
+        sensor_text_valid = false;
+    }
+}
+
+// bring a sensor's metrics up to date with its state. Called after each
+// pass; only the samples whose values changed are formatted again.
+void
+tempd_metrics_update(const struct locl_sensor *sensor)
+{
+    struct metrics_sensor *ms;
+    bool changed;
+
+    if (pstream == NULL) {
+        return;
+    }
+
+    ms = shash_find_data(&metrics_sensors, sensor->name);
+    if (ms == NULL) {
+        struct ds labels = DS_EMPTY_INITIALIZER;
+
+        ds_put_cstr(&labels, "sensor=\"");
+        metrics_put_label(&labels, sensor->name);
+        ds_put_cstr(&labels, "\",subsystem=\"");
+        metrics_put_label(&labels, sensor->subsystem->name);
+        ds_put_cstr(&labels, "\",location=\"");
+        metrics_put_label(&labels, sensor->yaml_sensor->location);
+        ds_put_char(&labels, '"');
+
+        ms = xzalloc(sizeof(*ms));
+        ms->labels = ds_steal_cstr(&labels);
+        shash_add(&metrics_sensors, sensor->name, ms);
+    }
+
+    changed = ms->temp != sensor->temp;
+    ms->temp = sensor->temp;
+    metrics_sensor_set(ms, FAMILY_TEMPERATURE, changed);
+
+    changed = ms->status != sensor->status;
+    ms->status = sensor->status;
+    metrics_sensor_set(ms, FAMILY_STATUS, changed);
+
+    changed = ms->fan_demand != sensor->fan_demand;
+    ms->fan_demand = sensor->fan_demand;
+    metrics_sensor_set(ms, FAMILY_FAN, changed);
+
+    changed = ms->n_reads != sensor->breaker.n_reads;
+    ms->n_reads = sensor->breaker.n_reads;
+    metrics_sensor_set(ms, FAMILY_READS, changed);
+
+    changed = ms->n_faults != sensor->breaker.n_faults;
+    ms->n_faults = sensor->breaker.n_faults;
+    metrics_sensor_set(ms, FAMILY_FAULTS, changed);
+}
+
+// forget a sensor that has been removed
+void
+tempd_metrics_remove(const char *name)
+{
+    struct metrics_sensor *ms = shash_find_and_delete(&metrics_sensors, name);
+
+    if (ms != NULL) {
+        metrics_sensor_destroy(ms);
+        sensor_text_valid = false;
+    }
+}
+
+// the latency histograms, from the pipeline statistics. Bucket limits are
+// powers of two microseconds, which are exact in six decimals of seconds.
+static void
+metrics_format_latency(struct ds *ds)
+{
+    int idx;
+    int bucket;
+
+    ds_put_cstr(ds, "# TYPE tempd_latency_seconds histogram\n"
+                "# UNIT tempd_latency_seconds seconds\n"
+                "# HELP tempd_latency_seconds Time taken by each operation.\n");
+    for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+        const char *name = tempd_stats_histogram_name(idx);
+        struct tempd_stats_histogram hist;
+        uint64_t total = 0;
+
+        tempd_stats_get_histogram(idx, &hist);
+        for (bucket = 0; bucket < STATS_N_BUCKETS - 1; bucket++) {
+            total += hist.buckets[bucket];
+            ds_put_format(ds, "tempd_latency_seconds_bucket{operation=\"%s\","
+                          "le=\"%.6f\"} %"PRIu64"\n", name,
+                          (UINT64_C(1) << bucket) / 1e6, total);
+        }
+        total += hist.buckets[bucket];
+        ds_put_format(ds, "tempd_latency_seconds_bucket{operation=\"%s\","
+                      "le=\"+Inf\"} %"PRIu64"\n", name, total);
+        ds_put_format(ds, "tempd_latency_seconds_count{operation=\"%s\"} %"
+                      PRIu64"\n", name, total);
+        ds_put_format(ds, "tempd_latency_seconds_sum{operation=\"%s\"} "
+                      "%.6f\n", name, hist.sum / 1e6);
+    }
+}
+
+// append the full exposition text. The sensor samples are only gathered
+// again after a change; the histograms are formatted each time (their size
+// doesn't depend on the number of sensors).
+void
+tempd_metrics_format(struct ds *ds)
+{
+    struct shash_node *node;
+    int family;
+
+    if (!sensor_text_valid) {
+        ds_clear(&sensor_text);
+        for (family = 0; family < N_FAMILIES; family++) {
+            ds_put_cstr(&sensor_text, family_headers[family]);
+            SHASH_FOR_EACH(node, &metrics_sensors) {
+                const struct metrics_sensor *ms = node->data;
+
+                ds_put_cstr(&sensor_text, ms->text[family]);
+            }
+        }
+        sensor_text_valid = true;
+    }
+
+    ds_put_buffer(ds, sensor_text.string, sensor_text.length);
+    metrics_format_latency(ds);
+    ds_put_cstr(ds, "# EOF\n");
+}
+
+// build the reply once the request is complete: an HTTP request ends with
+// an empty line, anything else with its first line or the end of input.
+// Returns false if more of the request is needed.
+static bool
+metrics_conn_reply(struct metrics_conn *conn, bool eof)
+{
+    const char *request = ds_cstr(&conn->request);
+    bool http = strncmp(request, "GET ", 4) == 0;
+    struct ds body = DS_EMPTY_INITIALIZER;
+
+    if (!eof) {
+        if (http ? (strstr(request, "\r\n\r\n") == NULL &&
+                    strstr(request, "\n\n") == NULL)
+                 : strchr(request, '\n') == NULL) {
+            return(false);
+        }
+    }
+
+    tempd_metrics_format(&body);
+    if (http) {
+        ds_put_format(&conn->reply, "HTTP/1.0 200 OK\r\n"
+                      "Content-Type: application/openmetrics-text; "
+                      "version=1.0.0; charset=utf-8\r\n"
+                      "Content-Length: %"PRIuSIZE"\r\n"
+                      "Connection: close\r\n\r\n", body.length);
+    }
+    ds_put_buffer(&conn->reply, body.string, body.length);
+    ds_destroy(&body);
+
+    return(true);
+}
+
+// make progress on a connection. Returns false once it's finished with.
+static bool
+metrics_conn_run(struct metrics_conn *conn)
+{
+    stream_run(conn->stream);
+
+    if (time_msec() >= conn->deadline) {
+        return(false);
+    }
+
+    if (conn->reply.length == 0) {
+        char buf[512];
+        int retval;
+
+        retval = stream_recv(conn->stream, buf, sizeof(buf));
+        if (retval == -EAGAIN) {
+            return(true);
+        } else if (retval < 0) {
+            return(false);
+        }
+
+        ds_put_buffer(&conn->request, buf, retval);
+        if (conn->request.length > METRICS_MAX_REQUEST) {
+            return(false);
+        }
+        if (!metrics_conn_reply(conn, retval == 0)) {
+            return(true);
+        }
+    }
+
+    while (conn->sent < conn->reply.length) {
+        int retval = stream_send(conn->stream, conn->reply.string + conn->sent,
+                                 conn->reply.length - conn->sent);
+        if (retval == -EAGAIN) {
+            return(true);
+        } else if (retval < 0) {
+            return(false);
+        }
+        conn->sent += retval;
+    }
+
+    return(false);
+}
+
+// accept new clients and serve the existing ones
+void
+tempd_metrics_run(void)
+{
+    int idx;
+
+    if (pstream == NULL) {
+        return;
+    }
+
+    while (n_conns < METRICS_MAX_CONNS) {
+        struct metrics_conn *conn;
+        struct stream *stream;
+        int error;
+
+        error = pstream_accept(pstream, &stream);
+        if (error) {
+            if (error != EAGAIN) {
+                static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+                VLOG_WARN_RL(&rl, "metrics accept failed (%s)",
+                             ovs_strerror(error));
+            }
+            break;
+        }
+
+        conn = &conns[n_conns++];
+        conn->stream = stream;
+        ds_init(&conn->request);
+        ds_init(&conn->reply);
+        conn->sent = 0;
+        conn->deadline = time_msec() + METRICS_TIMEOUT_MS;
+    }
+
+    for (idx = 0; idx < n_conns; ) {
+        if (metrics_conn_run(&conns[idx])) {
+            idx++;
+        } else {
+            // the last connection moves into this slot
+            metrics_conn_close(&conns[idx]);
+        }
+    }
+}
+
+void
+tempd_metrics_wait(void)
+{
+    int idx;
+
+    if (pstream == NULL) {
+        return;
+    }
+
+    // with every slot busy, new clients wait in the listen backlog
+    if (n_conns < METRICS_MAX_CONNS) {
+        pstream_wait(pstream);
+    }
+
+    for (idx = 0; idx < n_conns; idx++) {
+        struct metrics_conn *conn = &conns[idx];
+
+        stream_run_wait(conn->stream);
+        if (conn->reply.length == 0) {
+            stream_recv_wait(conn->stream);
+        } else {
+            stream_send_wait(conn->stream);
+        }
+        poll_timer_wait_until(conn->deadline);
+    }
+}
@@ -0,0 +1,770 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor state mirroring for a hot standby
+ ***************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "json.h"
+#include "jsonrpc.h"
+#include "poll-loop.h"
+#include "shash.h"
+#include "stream.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd.h"
+#include "tempd_mirror.h"
+#include "tempd_window.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_mirror);
+
+#define MIRROR_MAX_CONNS        4           // standbys served at once
+#define MIRROR_MAX_BACKLOG      (1024 * 1024)   // bytes queued per standby
+#define MIRROR_MAX_RECV         50          // messages handled per run
+
+// the scalar values of a sensor's state, in the order they're sent
+enum mirror_value {
+    VALUE_TEMP = 0,
+    VALUE_RAW_TEMP,
+    VALUE_MIN,
+    VALUE_MAX,
+    VALUE_FAULT_COUNT,
+    VALUE_SAMPLE_TIME,
+    VALUE_STATUS,
+    VALUE_FAN_SPEED,
+    VALUE_FAN_DEMAND,
+    VALUE_FILTER_VALUE,
+    VALUE_FILTER_EMA,
+    VALUE_FILTER_PRIMED,
+    N_VALUES
+};
+
+// fields of a "state" entry: the name, the values, the filter history,
+// the trend readings and the windows (which an older peer doesn't send)
+#define MIRROR_N_FIELDS (N_VALUES + 4)
+
+// fields of a window bucket, in the order they're sent
+#define MIRROR_BUCKET_FIELDS 5
+
+// a rolling statistics window's buckets, oldest first
+struct mirror_window {
+    long long length;                   // msec
+    int n;
+    struct window_bucket buckets[WINDOW_BUCKETS + 1];
+};
+
+// the mirrored state of a sensor. It's compared with memcmp(), so it's
+// always zeroed before it's filled in (field by field, leaving the
+// padding alone).
+struct mirror_state {
+    long long values[N_VALUES];
+    int n_history;
+    int history[FILTER_HISTORY];        // oldest first
+    int n_trend;
+    long long when[TREND_MAX_WINDOW];   // oldest first
+    int temp[TREND_MAX_WINDOW];
+    int n_windows;
+    struct mirror_window windows[WINDOW_MAX];
+};
+
+static char *mirror_path = NULL;
+static bool active = false;
+
+// active: the listener, its standbys, and the state they were last sent
+// standby: the connection to the active instance, and the state received
+static struct pstream *pstream;
+static struct jsonrpc *conns[MIRROR_MAX_CONNS];
+static int n_conns;
+static struct jsonrpc_session *session;
+static unsigned int session_seqno;
+static struct shash states = SHASH_INITIALIZER(&states);
+static struct json *removed;            // names removed since the last pass
+
+static uint64_t n_updates;              // sensor states sent or received
+static int n_restored = -1;             // sensors restored at takeover
+
+// start as a standby of the instance serving the unix socket at path
+void
+tempd_mirror_open(const char *path)
+{
+    char *name = xasprintf("unix:%s", path);
+
+    mirror_path = xstrdup(path);
+    session = jsonrpc_session_open(name, true);
+    session_seqno = jsonrpc_session_get_seqno(session);
+    free(name);
+}
+
+static void
+mirror_clear_states(void)
+{
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &states) {
+        free(node->data);
+    }
+    shash_clear(&states);
+}
+
+static void
+mirror_conn_close(int idx)
+{
+    jsonrpc_close(conns[idx]);
+    conns[idx] = conns[--n_conns];
+}
+
+void
+tempd_mirror_close(void)
+{
+    while (n_conns > 0) {
+        mirror_conn_close(0);
+    }
+    pstream_close(pstream);
+    pstream = NULL;
+    jsonrpc_session_close(session);
+    session = NULL;
+
+    mirror_clear_states();
+    json_destroy(removed);
+    removed = NULL;
+    free(mirror_path);
+    mirror_path = NULL;
+    active = false;
+}
+
+// take a copy of a sensor's state
+static void
+mirror_capture(const struct locl_sensor *sensor, struct mirror_state *state)
+{
+    const struct tempd_filter *filter = &sensor->filter;
+    const struct tempd_trend *trend = &sensor->trend;
+    int oldest;
+    int idx;
+
+    memset(state, 0, sizeof(*state));
+    state->values[VALUE_TEMP] = sensor->temp;
+    state->values[VALUE_RAW_TEMP] = sensor->raw_temp;
+    state->values[VALUE_MIN] = sensor->min;
+    state->values[VALUE_MAX] = sensor->max;
+    state->values[VALUE_FAULT_COUNT] = sensor->fault_count;
+    state->values[VALUE_SAMPLE_TIME] = sensor->sample_time;
+    state->values[VALUE_STATUS] = sensor->status;
+    state->values[VALUE_FAN_SPEED] = sensor->fan_speed;
+    state->values[VALUE_FAN_DEMAND] = sensor->fan_demand;
+    state->values[VALUE_FILTER_VALUE] = filter->value;
+    state->values[VALUE_FILTER_EMA] = filter->ema;
+    state->values[VALUE_FILTER_PRIMED] = filter->primed;
+
+    state->n_history = filter->n_history;
+    for (idx = 0; idx < filter->n_history; idx++) {
+        oldest = filter->next - filter->n_history + FILTER_HISTORY;
+        state->history[idx] = filter->history[(oldest + idx) % FILTER_HISTORY];
+    }
+
+    state->n_trend = trend->n;
+    oldest = (trend->next - trend->n + trend->window) % trend->window;
+    for (idx = 0; idx < trend->n; idx++) {
+        state->when[idx] = trend->when[(oldest + idx) % trend->window];
+        state->temp[idx] = trend->temp[(oldest + idx) % trend->window];
+    }
+
+    state->n_windows = sensor->n_windows;
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        struct window_bucket buckets[WINDOW_BUCKETS + 1];
+        struct mirror_window *window = &state->windows[idx];
+        int bucket;
+
+        window->length = sensor->windows[idx].length;
+        window->n = tempd_window_buckets(&sensor->windows[idx], buckets);
+        for (bucket = 0; bucket < window->n; bucket++) {
+            window->buckets[bucket].start = buckets[bucket].start;
+            window->buckets[bucket].min = buckets[bucket].min;
+            window->buckets[bucket].max = buckets[bucket].max;
+            window->buckets[bucket].sum = buckets[bucket].sum;
+            window->buckets[bucket].count = buckets[bucket].count;
+        }
+    }
+}
+
+// carry on from a mirrored window: the one of the same length, if the
+// active instance kept one (the windows are our own settings)
+static void
+mirror_restore_window(struct tempd_window *window,
+                      const struct mirror_state *state)
+{
+    int idx;
+    int bucket;
+
+    tempd_window_init(window, window->length);
+    for (idx = 0; idx < state->n_windows; idx++) {
+        const struct mirror_window *mirrored = &state->windows[idx];
+
+        if (mirrored->length != window->length) {
+            continue;
+        }
+        for (bucket = 0; bucket < mirrored->n; bucket++) {
+            tempd_window_add_bucket(window, &mirrored->buckets[bucket]);
+        }
+        break;
+    }
+}
+
+// carry on from a mirrored state. The filter, trend and window settings
+// are our own: the trend keeps as many of the readings as its window
+// holds, and windows of lengths the active instance didn't keep start
+// empty.
+static void
+mirror_restore(struct locl_sensor *sensor, const struct mirror_state *state)
+{
+    struct tempd_filter *filter = &sensor->filter;
+    int idx;
+
+    sensor->temp = state->values[VALUE_TEMP];
+    sensor->raw_temp = state->values[VALUE_RAW_TEMP];
+    sensor->min = state->values[VALUE_MIN];
+    sensor->max = state->values[VALUE_MAX];
+    sensor->fault_count = state->values[VALUE_FAULT_COUNT];
+    sensor->sample_time = state->values[VALUE_SAMPLE_TIME];
+    sensor->status = state->values[VALUE_STATUS];
+    sensor->fan_speed = state->values[VALUE_FAN_SPEED];
+    sensor->fan_demand = state->values[VALUE_FAN_DEMAND];
+
+    memcpy(filter->history, state->history,
+           state->n_history * sizeof(filter->history[0]));
+    filter->n_history = state->n_history;
+    filter->next = state->n_history % FILTER_HISTORY;
+    filter->value = state->values[VALUE_FILTER_VALUE];
+    filter->ema = state->values[VALUE_FILTER_EMA];
+    filter->primed = state->values[VALUE_FILTER_PRIMED] != 0;
+
+    tempd_trend_init(&sensor->trend, sensor->trend.window);
+    for (idx = 0; idx < state->n_trend; idx++) {
+        tempd_trend_add(&sensor->trend, state->when[idx], state->temp[idx]);
+    }
+
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        mirror_restore_window(&sensor->windows[idx], state);
+    }
+}
+
+static struct json *
+mirror_state_to_json(const char *name, const struct mirror_state *state)
+{
+    struct json *json = json_array_create_empty();
+    struct json *history = json_array_create_empty();
+    struct json *trend = json_array_create_empty();
+    struct json *windows = json_array_create_empty();
+    int idx;
+
+    json_array_add(json, json_string_create(name));
+    for (idx = 0; idx < N_VALUES; idx++) {
+        json_array_add(json, json_integer_create(state->values[idx]));
+    }
+    for (idx = 0; idx < state->n_history; idx++) {
+        json_array_add(history, json_integer_create(state->history[idx]));
+    }
+    json_array_add(json, history);
+    for (idx = 0; idx < state->n_trend; idx++) {
+        json_array_add(trend, json_integer_create(state->when[idx]));
+        json_array_add(trend, json_integer_create(state->temp[idx]));
+    }
+    json_array_add(json, trend);
+    for (idx = 0; idx < state->n_windows; idx++) {
+        const struct mirror_window *window = &state->windows[idx];
+        struct json *buckets = json_array_create_empty();
+        int bucket;
+
+        json_array_add(buckets, json_integer_create(window->length));
+        for (bucket = 0; bucket < window->n; bucket++) {
+            const struct window_bucket *b = &window->buckets[bucket];
+
+            json_array_add(buckets, json_integer_create(b->start));
+            json_array_add(buckets, json_integer_create(b->min));
+            json_array_add(buckets, json_integer_create(b->max));
+            json_array_add(buckets, json_integer_create(b->sum));
+            json_array_add(buckets, json_integer_create(b->count));
+        }
+        json_array_add(windows, buckets);
+    }
+    json_array_add(json, windows);
+
+    return(json);
+}
+
+// get an integer in [min, max]
+static bool
+mirror_parse_int(const struct json *json, long long min, long long max,
+                 long long *value)
+{
+    if (json->type != JSON_INTEGER) {
+        return(false);
+    }
+    *value = json_integer(json);
+
+    return(*value >= min && *value <= max);
+}
+
+// parse the windows of a "state" entry: for each, its length, then the
+// start, minimum, maximum, sum and count of each bucket
+static bool
+mirror_parse_windows(const struct json *json, struct mirror_state *state)
+{
+    const struct json_array *windows;
+    int idx;
+
+    if (json->type != JSON_ARRAY || json_array(json)->n > WINDOW_MAX) {
+        return(false);
+    }
+    windows = json_array(json);
+    state->n_windows = windows->n;
+    for (idx = 0; idx < state->n_windows; idx++) {
+        struct mirror_window *window = &state->windows[idx];
+        const struct json_array *buckets;
+        long long value;
+        int bucket;
+
+        if (windows->elems[idx]->type != JSON_ARRAY) {
+            return(false);
+        }
+        buckets = json_array(windows->elems[idx]);
+        if (buckets->n < 1
+                || (buckets->n - 1) % MIRROR_BUCKET_FIELDS != 0
+                || (buckets->n - 1) / MIRROR_BUCKET_FIELDS
+                   > WINDOW_BUCKETS + 1
+                || !mirror_parse_int(buckets->elems[0], 1, LLONG_MAX,
+                                     &window->length)) {
+            return(false);
+        }
+        window->n = (buckets->n - 1) / MIRROR_BUCKET_FIELDS;
+        for (bucket = 0; bucket < window->n; bucket++) {
+            struct json **elems = &buckets->elems[1 + bucket *
+                                                  MIRROR_BUCKET_FIELDS];
+            struct window_bucket *b = &window->buckets[bucket];
+
+            if (!mirror_parse_int(elems[0], LLONG_MIN, LLONG_MAX, &b->start)
+                    || !mirror_parse_int(elems[3], LLONG_MIN, LLONG_MAX,
+                                         &b->sum)) {
+                return(false);
+            }
+            if (!mirror_parse_int(elems[1], INT_MIN, INT_MAX, &value)) {
+                return(false);
+            }
+            b->min = value;
+            if (!mirror_parse_int(elems[2], INT_MIN, INT_MAX, &value)) {
+                return(false);
+            }
+            b->max = value;
+            if (!mirror_parse_int(elems[4], 0, INT_MAX, &value)) {
+                return(false);
+            }
+            b->count = value;
+        }
+    }
+
+    return(true);
+}
+
+// parse a "state" entry. Returns the sensor name, or NULL if the entry is
+// malformed.
+static const char *
+mirror_parse_state(const struct json *json, struct mirror_state *state)
+{
+    const struct json_array *fields, *history, *trend;
+    long long value;
+    int idx;
+
+    if (json->type != JSON_ARRAY) {
+        return(NULL);
+    }
+    fields = json_array(json);
+    if ((fields->n != MIRROR_N_FIELDS && fields->n != MIRROR_N_FIELDS - 1)
+            || fields->elems[0]->type != JSON_STRING
+            || fields->elems[N_VALUES + 1]->type != JSON_ARRAY
+            || fields->elems[N_VALUES + 2]->type != JSON_ARRAY) {
+        return(NULL);
+    }
+
+    memset(state, 0, sizeof(*state));
+    for (idx = 0; idx < N_VALUES; idx++) {
+        long long min = INT_MIN, max = INT_MAX;
+
+        if (idx == VALUE_FILTER_EMA || idx == VALUE_SAMPLE_TIME) {
+            min = LLONG_MIN;
+            max = LLONG_MAX;
+        } else if (idx == VALUE_STATUS) {
+            min = SENSOR_STATUS_UNINITIALIZED;
+            max = SENSOR_STATUS_EMERGENCY;
+        } else if (idx == VALUE_FAN_SPEED || idx == VALUE_FAN_DEMAND) {
+            min = SENSOR_FAN_NORMAL;
+            max = SENSOR_FAN_MAX;
+        }
+        if (!mirror_parse_int(fields->elems[idx + 1], min, max,
+                              &state->values[idx])) {
+            return(NULL);
+        }
+    }
+
+    history = json_array(fields->elems[N_VALUES + 1]);
+    if (history->n > FILTER_HISTORY) {
+        return(NULL);
+    }
+    state->n_history = history->n;
+    for (idx = 0; idx < state->n_history; idx++) {
+        if (!mirror_parse_int(history->elems[idx], INT_MIN, INT_MAX,
+                              &value)) {
+            return(NULL);
+        }
+        state->history[idx] = value;
+    }
+
+    trend = json_array(fields->elems[N_VALUES + 2]);
+    if (trend->n % 2 != 0 || trend->n / 2 > TREND_MAX_WINDOW) {
+        return(NULL);
+    }
+    state->n_trend = trend->n / 2;
+    for (idx = 0; idx < state->n_trend; idx++) {
+        if (!mirror_parse_int(trend->elems[2 * idx], LLONG_MIN, LLONG_MAX,
+                              &state->when[idx])
+                || !mirror_parse_int(trend->elems[2 * idx + 1], INT_MIN,
+                                     INT_MAX, &value)) {
+            return(NULL);
+        }
+        state->temp[idx] = value;
+    }
+
+    if (fields->n == MIRROR_N_FIELDS
+            && !mirror_parse_windows(fields->elems[N_VALUES + 3], state)) {
+        return(NULL);
+    }
+
+    return(json_string(fields->elems[0]));
+}
+
+// standby: handle a message from the active instance
+static void
+mirror_receive(const struct jsonrpc_msg *msg)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    const struct json_array *params;
+    size_t idx;
+
+    if (msg->type != JSONRPC_NOTIFY || msg->params == NULL
+            || msg->params->type != JSON_ARRAY) {
+        return;
+    }
+    params = json_array(msg->params);
+
+    if (!strcmp(msg->method, "state")) {
+        for (idx = 0; idx < params->n; idx++) {
+            struct mirror_state state, *copy;
+            const char *name;
+
+            name = mirror_parse_state(params->elems[idx], &state);
+            if (name == NULL) {
+                VLOG_WARN_RL(&rl, "ignoring malformed sensor state");
+                continue;
+            }
+            copy = shash_find_data(&states, name);
+            if (copy == NULL) {
+                copy = xmalloc(sizeof(*copy));
+                shash_add(&states, name, copy);
+            }
+            *copy = state;
+            n_updates++;
+        }
+    } else if (!strcmp(msg->method, "remove")) {
+        for (idx = 0; idx < params->n; idx++) {
+            struct shash_node *node;
+
+            if (params->elems[idx]->type != JSON_STRING) {
+                continue;
+            }
+            node = shash_find(&states, json_string(params->elems[idx]));
+            if (node != NULL) {
+                free(node->data);
+                shash_delete(&states, node);
+            }
+        }
+    }
+}
+
+// active: send a notification to every standby
+static void
+mirror_send(const char *method, const struct json *params)
+{
+    int idx;
+
+    for (idx = 0; idx < n_conns; idx++) {
+        jsonrpc_send(conns[idx],
+                     jsonrpc_create_notify(method, json_clone(params)));
+    }
+}
+
+// active: send everything we have to a new standby
+static void
+mirror_send_snapshot(struct jsonrpc *conn)
+{
+    struct json *params = json_array_create_empty();
+    struct shash_node *node;
+
+    SHASH_FOR_EACH(node, &states) {
+        json_array_add(params, mirror_state_to_json(node->name, node->data));
+    }
+    jsonrpc_send(conn, jsonrpc_create_notify("state", params));
+}
+
+static void
+mirror_run_active(void)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+    struct stream *stream;
+    int idx;
+
+    if (pstream != NULL && pstream_accept(pstream, &stream) == 0) {
+        if (n_conns < MIRROR_MAX_CONNS) {
+            conns[n_conns] = jsonrpc_open(stream);
+            mirror_send_snapshot(conns[n_conns]);
+            n_conns++;
+        } else {
+            VLOG_WARN_RL(&rl, "%s: too many standbys, dropping connection",
+                         mirror_path);
+            stream_close(stream);
+        }
+    }
+
+    for (idx = 0; idx < n_conns; ) {
+        struct jsonrpc *conn = conns[idx];
+        struct jsonrpc_msg *msg;
+        int n;
+
+        jsonrpc_run(conn);
+        for (n = 0; n < MIRROR_MAX_RECV && !jsonrpc_recv(conn, &msg); n++) {
+            if (msg->type == JSONRPC_REQUEST && !strcmp(msg->method, "echo")) {
+                jsonrpc_send(conn, jsonrpc_create_reply(json_clone(msg->params),
+                                                        msg->id));
+            }
+            jsonrpc_msg_destroy(msg);
+        }
+
+        // a standby that can't keep up is dropped; it gets a fresh
+        // snapshot when it reconnects
+        if (jsonrpc_get_status(conn)
+                || jsonrpc_get_backlog(conn) > MIRROR_MAX_BACKLOG) {
+            VLOG_WARN_RL(&rl, "%s: dropping standby connection",
+                         mirror_path);
+            mirror_conn_close(idx);
+        } else {
+            idx++;
+        }
+    }
+}
+
+static void
+mirror_run_standby(void)
+{
+    struct jsonrpc_msg *msg;
+    int n;
+
+    jsonrpc_session_run(session);
+
+    // the active instance sends everything again when we (re)connect, and
+    // whatever we held may have been removed meanwhile. (A disconnection
+    // doesn't clear anything: it's usually the active instance going away,
+    // which is when we need the state.)
+    if (jsonrpc_session_is_connected(session)
+            && jsonrpc_session_get_seqno(session) != session_seqno) {
+        session_seqno = jsonrpc_session_get_seqno(session);
+        mirror_clear_states();
+        VLOG_INFO("%s: mirroring the active ops-tempd", mirror_path);
+    }
+
+    for (n = 0; n < MIRROR_MAX_RECV; n++) {
+        msg = jsonrpc_session_recv(session);
+        if (msg == NULL) {
+            break;
+        }
+        mirror_receive(msg);
+        jsonrpc_msg_destroy(msg);
+    }
+}
+
+void
+tempd_mirror_run(void)
+{
+    if (active) {
+        mirror_run_active();
+    } else if (session != NULL) {
+        mirror_run_standby();
+    }
+}
+
+void
+tempd_mirror_wait(void)
+{
+    int idx;
+
+    if (active) {
+        if (pstream != NULL) {
+            pstream_wait(pstream);
+        }
+        for (idx = 0; idx < n_conns; idx++) {
+            jsonrpc_wait(conns[idx]);
+            jsonrpc_recv_wait(conns[idx]);
+        }
+    } else if (session != NULL) {
+        jsonrpc_session_wait(session);
+        jsonrpc_session_recv_wait(session);
+    }
+}
+
+bool
+tempd_mirror_is_active(void)
+{
+    return(active);
+}
+
+// we have the lock: carry on from the mirrored state of each sensor, and
+// serve our own state to the next standby
+void
+tempd_mirror_activate(const struct shash *sensors)
+{
+    struct shash_node *node;
+    char *name;
+    int error;
+
+    jsonrpc_session_close(session);
+    session = NULL;
+
+    n_restored = 0;
+    SHASH_FOR_EACH(node, sensors) {
+        const struct mirror_state *state = shash_find_data(&states,
+                                                           node->name);
+
+        if (state != NULL) {
+            mirror_restore(node->data, state);
+            n_restored++;
+        }
+    }
+    VLOG_INFO("taking over with the mirrored state of %d of %"PRIuSIZE
+              " sensors", n_restored, shash_count(sensors));
+
+    // the next pass sends the state of every sensor
+    mirror_clear_states();
+    removed = json_array_create_empty();
+    active = true;
+
+    name = xasprintf("punix:%s", mirror_path);
+    error = pstream_open(name, &pstream, DSCP_DEFAULT);
+    if (error) {
+        VLOG_ERR("%s: listen failed (%s), no standby can mirror this "
+                 "process", name, ovs_strerror(error));
+    }
+    free(name);
+}
+
+// active: after each publish, send the standbys the state of those of the
+// sensors published that changed (and of those removed)
+void
+tempd_mirror_publish(struct locl_sensor *const *sensors, size_t n)
+{
+    struct json *params;
+    size_t idx;
+
+    if (!active) {
+        return;
+    }
+
+    if (json_array(removed)->n > 0) {
+        mirror_send("remove", removed);
+        json_destroy(removed);
+        removed = json_array_create_empty();
+    }
+
+    params = json_array_create_empty();
+    for (idx = 0; idx < n; idx++) {
+        const char *name = sensors[idx]->name;
+        struct mirror_state state, *sent;
+
+        mirror_capture(sensors[idx], &state);
+        sent = shash_find_data(&states, name);
+        if (sent != NULL && !memcmp(sent, &state, sizeof(state))) {
+            continue;
+        }
+        if (sent == NULL) {
+            sent = xmalloc(sizeof(*sent));
+            shash_add(&states, name, sent);
+        }
+        *sent = state;
+        json_array_add(params, mirror_state_to_json(name, sent));
+        n_updates++;
+    }
+    if (json_array(params)->n > 0) {
+        mirror_send("state", params);
+    }
+    json_destroy(params);
+}
+
+// a sensor is going away
+void
+tempd_mirror_remove(const char *name)
+{
+    struct shash_node *node;
+
+    if (!active) {
+        return;
+    }
+
+    node = shash_find(&states, name);
+    if (node != NULL) {
+        free(node->data);
+        shash_delete(&states, node);
+        json_array_add(removed, json_string_create(name));
+    }
+}
+
+void
+tempd_mirror_dump(struct ds *ds)
+{
+    ds_put_format(ds, "\nMirror: %s\n", mirror_path);
+    if (active) {
+        ds_put_cstr(ds, "\tRole: active\n");
+        ds_put_format(ds, "\tStandbys: %d\n", n_conns);
+        ds_put_format(ds, "\tUpdates sent: %"PRIu64"\n", n_updates);
+        if (n_restored >= 0) {
+            ds_put_format(ds, "\tSensors restored at takeover: %d\n",
+                          n_restored);
+        }
+    } else {
+        ds_put_cstr(ds, "\tRole: standby\n");
+        ds_put_format(ds, "\tConnected: %s\n",
+                      session != NULL && jsonrpc_session_is_connected(session)
+                      ? "yes" : "no");
+        ds_put_format(ds, "\tSensors mirrored: %"PRIuSIZE"\n",
+                      shash_count(&states));
+        ds_put_format(ds, "\tUpdates received: %"PRIu64"\n", n_updates);
+    }
+}
@@ -0,0 +1,230 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Publishing sensor state to the Temp_sensor table
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "smap.h"
+#include "util.h"
+#include "vswitch-idl.h"
+#include "tempd_publish.h"
+#include "tempd_sensor.h"
+#include "tempd_stats.h"
+
+// set an external_ids key to value (or remove it, if value is NULL) in ids,
+// if it isn't already. ids is cloned from the row the first time.
+static void
+tempd_update_external_id(const struct ovsrec_temp_sensor *cfg,
+                         struct smap *ids, bool *cloned,
+                         const char *key, const char *value)
+{
+    const char *current = smap_get(&cfg->external_ids, key);
+
+    if (value == NULL ? current == NULL
+                      : current != NULL && strcmp(current, value) == 0) {
+        return;
+    }
+
+    if (!*cloned) {
+        smap_clone(ids, &cfg->external_ids);
+        *cloned = true;
+    }
+
+    if (value == NULL) {
+        smap_remove(ids, key);
+    } else {
+        smap_replace(ids, key, value);
+    }
+}
+
+// publish a sensor's trend and alarm prediction into its external_ids
+// (in ids, cloned from the row if anything has to be written)
+static void
+tempd_publish_trend(const struct ovsrec_temp_sensor *cfg,
+                    const struct locl_sensor *sensor,
+                    struct smap *ids, bool *cloned)
+{
+    char slope_str[16];
+    char eta_str[24];
+    const char *slope_value = NULL;
+    const char *level_value = NULL;
+    const char *eta_value = NULL;
+    enum sensorstatus level;
+    long long eta;
+    int threshold;
+    int slope;
+
+    if (tempd_trend_slope(&sensor->trend, &slope)) {
+        slope = (slope / TREND_SLOPE_QUANTUM) * TREND_SLOPE_QUANTUM;
+        snprintf(slope_str, sizeof(slope_str), "%d", slope);
+        slope_value = slope_str;
+    }
+
+    if (tempd_next_alarm(sensor, &threshold, &level) &&
+            tempd_trend_time_to(&sensor->trend, sensor->temp,
+                                threshold, &eta)) {
+        eta = (eta / MSEC_PER_SEC / TREND_TIME_QUANTUM) * TREND_TIME_QUANTUM;
+        snprintf(eta_str, sizeof(eta_str), "%lld", eta);
+        level_value = sensor_status_to_string(level);
+        eta_value = eta_str;
+    }
+
+    tempd_update_external_id(cfg, ids, cloned, "trend_slope", slope_value);
+    tempd_update_external_id(cfg, ids, cloned, "trend_next_alarm",
+                             level_value);
+    tempd_update_external_id(cfg, ids, cloned, "trend_time_to_alarm",
+                             eta_value);
+}
+
+// round a temperature to the nearest WINDOW_AVG_QUANTUM
+static int
+tempd_round_avg(int temp)
+{
+    int half = temp < 0 ? -WINDOW_AVG_QUANTUM / 2 : WINDOW_AVG_QUANTUM / 2;
+
+    return((temp + half) / WINDOW_AVG_QUANTUM * WINDOW_AVG_QUANTUM);
+}
+
+// publish a sensor's rolling statistics as of now into its external_ids:
+// min_<window>, max_<window> and avg_<window> (removed while a window has
+// no readings). Averages are rounded, to avoid writing insignificant
+// changes.
+static void
+tempd_publish_windows(const struct ovsrec_temp_sensor *cfg,
+                      struct locl_sensor *sensor, long long now,
+                      struct smap *ids, bool *cloned)
+{
+    struct tempd_window_stats stats;
+    char label[16];
+    char key[24];
+    char value[3][16];
+    bool valid;
+    int idx;
+
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        tempd_window_label(sensor->windows[idx].length, label, sizeof(label));
+        valid = tempd_window_get(&sensor->windows[idx], now, &stats);
+        if (valid) {
+            snprintf(value[0], sizeof(value[0]), "%d", stats.min);
+            snprintf(value[1], sizeof(value[1]), "%d", stats.max);
+            snprintf(value[2], sizeof(value[2]), "%d",
+                     tempd_round_avg(stats.avg));
+        }
+
+        snprintf(key, sizeof(key), "min_%s", label);
+        tempd_update_external_id(cfg, ids, cloned, key,
+                                 valid ? value[0] : NULL);
+        snprintf(key, sizeof(key), "max_%s", label);
+        tempd_update_external_id(cfg, ids, cloned, key,
+                                 valid ? value[1] : NULL);
+        snprintf(key, sizeof(key), "avg_%s", label);
+        tempd_update_external_id(cfg, ids, cloned, key,
+                                 valid ? value[2] : NULL);
+    }
+}
+
+// bump a sensor's sequence number, which tells readers of the row that
+// something in it changed. It carries on from the row's, so it never goes
+// back when ops-tempd restarts (or a standby takes over).
+static void
+tempd_publish_seq(const struct ovsrec_temp_sensor *cfg,
+                  struct locl_sensor *sensor, struct smap *ids, bool *cloned)
+{
+    char seq_str[24];
+
+    if (sensor->publish_seq == 0) {
+        const char *seq = smap_get(&cfg->external_ids, "seq");
+
+        if (seq == NULL || !str_to_llong(seq, 10, &sensor->publish_seq)) {
+            sensor->publish_seq = 0;
+        }
+    }
+    sensor->publish_seq++;
+
+    snprintf(seq_str, sizeof(seq_str), "%lld", sensor->publish_seq);
+    tempd_update_external_id(cfg, ids, cloned, "seq", seq_str);
+}
+
+// bring a Temp_sensor row up to date with a sensor's state as of now. Only
+// the columns that differ are written, along with a new sequence number.
+// Returns true if anything was written.
+bool
+tempd_publish_sensor(const struct ovsrec_temp_sensor *cfg,
+                     struct locl_sensor *sensor, long long now)
+{
+    const char *status;
+    struct smap ids;
+    bool cloned = false;
+    bool change = false;
+
+    // note: only apply changes - don't blindly set data
+
+    // calculate and set status
+    status = sensor_status_to_string(sensor->status);
+    if (strcmp(status, cfg->status) != 0) {
+        ovsrec_temp_sensor_set_status(cfg, status);
+        change = true;
+    }
+    // set temperature
+    if (cfg->temperature != sensor->temp) {
+        ovsrec_temp_sensor_set_temperature(cfg, sensor->temp);
+        change = true;
+    }
+    // set min
+    if (cfg->min != sensor->min) {
+        ovsrec_temp_sensor_set_min(cfg, sensor->min);
+        change = true;
+    }
+    // set max
+    if (cfg->max != sensor->max) {
+        ovsrec_temp_sensor_set_max(cfg, sensor->max);
+        change = true;
+    }
+    // calculate and set fan speed
+    status = sensor_speed_to_string(sensor->fan_demand);
+    if (strcmp(status, cfg->fan_state) != 0) {
+        ovsrec_temp_sensor_set_fan_state(cfg, status);
+        change = true;
+    }
+    // set location (note: should never change)
+    if (strcmp(sensor->yaml_sensor->location, cfg->location) != 0) {
+        ovsrec_temp_sensor_set_location(cfg, sensor->yaml_sensor->location);
+        change = true;
+    }
+    // set trend information, rolling statistics and staleness
+    tempd_publish_trend(cfg, sensor, &ids, &cloned);
+    tempd_publish_windows(cfg, sensor, now, &ids, &cloned);
+    tempd_update_external_id(cfg, &ids, &cloned, "stale",
+                             sensor->stale ? "true" : NULL);
+
+    if (change || cloned) {
+        tempd_publish_seq(cfg, sensor, &ids, &cloned);
+        ovsrec_temp_sensor_set_external_ids(cfg, &ids);
+        smap_destroy(&ids);
+        tempd_stats_count(STATS_ROWS_WRITTEN, 1);
+        change = true;
+    }
+
+    return(change);
+}
@@ -0,0 +1,453 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Recording and replay of raw sensor samples
+ ***************************************************************************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "ovs-thread.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_record.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_record);
+
+#define RECORD_MAGIC        "TEMPDREC"
+#define RECORD_MAGIC_LEN    8
+#define RECORD_VERSION      1
+#define RECORD_HEADER_LEN   (RECORD_MAGIC_LEN + 4 + 8)
+
+#define RECORD_DEFINE       1
+#define RECORD_SAMPLE       2
+#define RECORD_SAMPLE_LEN   10
+#define RECORD_MAX_IDS      65536
+
+// a sensor known to the recorder
+struct record_sensor {
+    uint16_t id;
+    unsigned int generation;    // file in which the id was last defined
+};
+
+struct tempd_recorder {
+    struct ovs_mutex mutex;     // the watchdog thread records samples too
+    char *file_name;
+    char *old_name;             // file_name.1
+    FILE *stream;
+    size_t max_size;
+    size_t size;                // bytes in the current file
+    unsigned int generation;    // incremented on each new file
+    long long last;             // time of the last sample in the file
+    struct shash sensors;       // struct record_sensor
+    int n_ids;
+
+    // counters
+    uint64_t n_samples;
+    uint64_t n_rotations;
+    uint64_t n_errors;
+};
+
+struct tempd_replay {
+    char *file_name;
+    FILE *stream;
+    bool have_header;
+    long long last;             // time of the last sample
+    char *names[RECORD_MAX_IDS];
+    char *error;
+};
+
+static void
+put_u16(unsigned char *p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void
+put_u32(unsigned char *p, uint32_t value)
+{
+    put_u16(p, value & 0xffff);
+    put_u16(p + 2, value >> 16);
+}
+
+static void
+put_u64(unsigned char *p, uint64_t value)
+{
+    put_u32(p, value & 0xffffffff);
+    put_u32(p + 4, value >> 32);
+}
+
+static uint16_t
+get_u16(const unsigned char *p)
+{
+    return(p[0] | (p[1] << 8));
+}
+
+static uint32_t
+get_u32(const unsigned char *p)
+{
+    return(get_u16(p) | ((uint32_t)get_u16(p + 2) << 16));
+}
+
+static uint64_t
+get_u64(const unsigned char *p)
+{
+    return(get_u32(p) | ((uint64_t)get_u32(p + 4) << 32));
+}
+
+static void
+recorder_write(struct tempd_recorder *rec, const void *data, size_t len)
+    OVS_REQUIRES(rec->mutex)
+{
+    static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
+
+    if (rec->stream == NULL || fwrite(data, 1, len, rec->stream) != len) {
+        rec->n_errors++;
+        VLOG_WARN_RL(&rl, "%s: write failed (%s)", rec->file_name,
+                     ovs_strerror(errno));
+        return;
+    }
+    rec->size += len;
+}
+
+// start a new log file, with a header based at time when
+static int
+recorder_start_file(struct tempd_recorder *rec, long long when)
+    OVS_REQUIRES(rec->mutex)
+{
+    unsigned char header[RECORD_HEADER_LEN];
+
+    rec->stream = fopen(rec->file_name, "wb");
+    if (rec->stream == NULL) {
+        return(errno);
+    }
+
+    memcpy(header, RECORD_MAGIC, RECORD_MAGIC_LEN);
+    put_u32(header + RECORD_MAGIC_LEN, RECORD_VERSION);
+    put_u64(header + RECORD_MAGIC_LEN + 4, (uint64_t)when);
+
+    rec->size = 0;
+    rec->last = when;
+    rec->generation++;
+    recorder_write(rec, header, sizeof(header));
+    return(0);
+}
+
+// move the current log to file_name.1 and start a new one
+static void
+recorder_rotate(struct tempd_recorder *rec, long long when)
+    OVS_REQUIRES(rec->mutex)
+{
+    int error;
+
+    fclose(rec->stream);
+    rec->stream = NULL;
+    if (rename(rec->file_name, rec->old_name) != 0) {
+        VLOG_WARN("%s: rename to %s failed (%s)", rec->file_name,
+                  rec->old_name, ovs_strerror(errno));
+    }
+
+    error = recorder_start_file(rec, when);
+    if (error) {
+        VLOG_ERR("%s: open failed (%s), recording stopped", rec->file_name,
+                 ovs_strerror(error));
+    }
+    rec->n_rotations++;
+}
+
+// open a log for recording. On error, returns NULL and sets *errorp to a
+// malloc'd message.
+struct tempd_recorder *
+tempd_recorder_open(const char *file_name, size_t max_size, char **errorp)
+{
+    struct tempd_recorder *rec = xzalloc(sizeof(*rec));
+    int error;
+
+    ovs_mutex_init(&rec->mutex);
+    rec->file_name = xstrdup(file_name);
+    rec->old_name = xasprintf("%s.1", file_name);
+    rec->max_size = max_size;
+    shash_init(&rec->sensors);
+
+    ovs_mutex_lock(&rec->mutex);
+    error = recorder_start_file(rec, time_msec());
+    ovs_mutex_unlock(&rec->mutex);
+
+    if (error) {
+        *errorp = xasprintf("%s: open failed (%s)", file_name,
+                            ovs_strerror(error));
+        tempd_recorder_close(rec);
+        return(NULL);
+    }
+    return(rec);
+}
+
+void
+tempd_recorder_close(struct tempd_recorder *rec)
+{
+    struct shash_node *node;
+
+    if (rec == NULL) {
+        return;
+    }
+
+    if (rec->stream != NULL) {
+        fclose(rec->stream);
+    }
+    SHASH_FOR_EACH(node, &rec->sensors) {
+        free(node->data);
+    }
+    shash_destroy(&rec->sensors);
+    ovs_mutex_destroy(&rec->mutex);
+    free(rec->file_name);
+    free(rec->old_name);
+    free(rec);
+}
+
+// append a raw sample of sensor name, read at (monotonic) time when
+void
+tempd_recorder_sample(struct tempd_recorder *rec, const char *name,
+                      long long when, const char raw[2], int status)
+{
+    unsigned char buf[RECORD_SAMPLE_LEN];
+    struct record_sensor *sensor;
+    size_t name_len = strlen(name);
+
+    ovs_mutex_lock(&rec->mutex);
+
+    sensor = shash_find_data(&rec->sensors, name);
+    if (sensor == NULL) {
+        if (rec->n_ids >= RECORD_MAX_IDS) {
+            rec->n_errors++;
+            goto out;
+        }
+        sensor = xzalloc(sizeof(*sensor));
+        sensor->id = rec->n_ids++;
+        shash_add(&rec->sensors, name, sensor);
+    }
+
+    if (rec->stream != NULL &&
+            rec->size + 4 + name_len + RECORD_SAMPLE_LEN > rec->max_size) {
+        recorder_rotate(rec, when);
+    }
+    if (rec->stream == NULL) {
+        goto out;
+    }
+
+    // samples from the watchdog thread and the main loop can arrive
+    // slightly out of order; keep the deltas positive
+    if (when < rec->last) {
+        when = rec->last;
+    }
+
+    if (sensor->generation != rec->generation) {
+        buf[0] = RECORD_DEFINE;
+        put_u16(buf + 1, sensor->id);
+        buf[3] = name_len > UINT8_MAX ? UINT8_MAX : name_len;
+        recorder_write(rec, buf, 4);
+        recorder_write(rec, name, buf[3]);
+        sensor->generation = rec->generation;
+    }
+
+    buf[0] = RECORD_SAMPLE;
+    put_u16(buf + 1, sensor->id);
+    put_u32(buf + 3, (uint32_t)(when - rec->last));
+    buf[7] = raw[0];
+    buf[8] = raw[1];
+    buf[9] = status > UINT8_MAX ? UINT8_MAX : status;
+    recorder_write(rec, buf, sizeof(buf));
+
+    rec->last = when;
+    rec->n_samples++;
+
+out:
+    ovs_mutex_unlock(&rec->mutex);
+}
+
+// push recorded samples out to the file
+void
+tempd_recorder_flush(struct tempd_recorder *rec)
+{
+    ovs_mutex_lock(&rec->mutex);
+    if (rec->stream != NULL && fflush(rec->stream) != 0) {
+        rec->n_errors++;
+    }
+    ovs_mutex_unlock(&rec->mutex);
+}
+
+void
+tempd_recorder_dump(struct tempd_recorder *rec, struct ds *ds)
+{
+    ovs_mutex_lock(&rec->mutex);
+    ds_put_format(ds, "\nRecording: %s\n", rec->file_name);
+    ds_put_format(ds, "\tSize: %"PRIuSIZE" of %"PRIuSIZE" bytes\n",
+                  rec->size, rec->max_size);
+    ds_put_format(ds, "\tSensors: %d\n", rec->n_ids);
+    ds_put_format(ds, "\tSamples: %"PRIu64"\n", rec->n_samples);
+    ds_put_format(ds, "\tRotations: %"PRIu64"\n", rec->n_rotations);
+    ds_put_format(ds, "\tErrors: %"PRIu64"\n", rec->n_errors);
+    ovs_mutex_unlock(&rec->mutex);
+}
+
+// open a log for replay. On error, returns NULL and sets *errorp to a
+// malloc'd message.
+struct tempd_replay *
+tempd_replay_open(const char *file_name, char **errorp)
+{
+    struct tempd_replay *replay;
+    FILE *stream;
+
+    stream = fopen(file_name, "rb");
+    if (stream == NULL) {
+        *errorp = xasprintf("%s: open failed (%s)", file_name,
+                            ovs_strerror(errno));
+        return(NULL);
+    }
+
+    replay = xzalloc(sizeof(*replay));
+    replay->file_name = xstrdup(file_name);
+    replay->stream = stream;
+    return(replay);
+}
+
+static void
+replay_clear_names(struct tempd_replay *replay)
+{
+    int idx;
+
+    for (idx = 0; idx < RECORD_MAX_IDS; idx++) {
+        free(replay->names[idx]);
+        replay->names[idx] = NULL;
+    }
+}
+
+void
+tempd_replay_close(struct tempd_replay *replay)
+{
+    if (replay == NULL) {
+        return;
+    }
+
+    replay_clear_names(replay);
+    fclose(replay->stream);
+    free(replay->file_name);
+    free(replay->error);
+    free(replay);
+}
+
+// stop the replay with an error
+static bool
+replay_fail(struct tempd_replay *replay, const char *reason)
+{
+    long offset = ftell(replay->stream);
+
+    replay->error = xasprintf("%s: %s at offset %ld", replay->file_name,
+                              reason, offset);
+    return(false);
+}
+
+// read exactly len bytes
+static bool
+replay_read(struct tempd_replay *replay, void *buf, size_t len)
+{
+    return(fread(buf, 1, len, replay->stream) == len);
+}
+
+// get the next sample from the log. Returns false at the end of the log,
+// or on an error (see tempd_replay_error).
+bool
+tempd_replay_next(struct tempd_replay *replay, struct tempd_record *record)
+{
+    unsigned char buf[RECORD_HEADER_LEN];
+    char name[UINT8_MAX + 1];
+    uint16_t id;
+    int type;
+
+    if (replay->error != NULL) {
+        return(false);
+    }
+
+    while ((type = getc(replay->stream)) != EOF) {
+        if (type == RECORD_MAGIC[0]) {
+            buf[0] = type;
+            if (!replay_read(replay, buf + 1, RECORD_HEADER_LEN - 1) ||
+                    memcmp(buf, RECORD_MAGIC, RECORD_MAGIC_LEN) != 0) {
+                return(replay_fail(replay, "bad header"));
+            }
+            if (get_u32(buf + RECORD_MAGIC_LEN) != RECORD_VERSION) {
+                return(replay_fail(replay, "unsupported version"));
+            }
+            // ids are only valid within the file that defines them
+            replay_clear_names(replay);
+            replay->last = (long long)get_u64(buf + RECORD_MAGIC_LEN + 4);
+            replay->have_header = true;
+            continue;
+        }
+
+        if (!replay->have_header) {
+            return(replay_fail(replay, "not a recording"));
+        }
+
+        if (type == RECORD_DEFINE) {
+            if (!replay_read(replay, buf, 3) ||
+                    !replay_read(replay, name, buf[2])) {
+                return(replay_fail(replay, "truncated record"));
+            }
+            id = get_u16(buf);
+            free(replay->names[id]);
+            replay->names[id] = xmemdup0(name, buf[2]);
+        } else if (type == RECORD_SAMPLE) {
+            if (!replay_read(replay, buf, RECORD_SAMPLE_LEN - 1)) {
+                return(replay_fail(replay, "truncated record"));
+            }
+            id = get_u16(buf);
+            if (replay->names[id] == NULL) {
+                return(replay_fail(replay, "undefined sensor"));
+            }
+            replay->last += get_u32(buf + 2);
+
+            record->name = replay->names[id];
+            record->when = replay->last;
+            record->raw[0] = buf[6];
+            record->raw[1] = buf[7];
+            record->status = buf[8];
+            return(true);
+        } else {
+            return(replay_fail(replay, "bad record type"));
+        }
+    }
+
+    return(false);
+}
+
+// get the reason the replay stopped early, or NULL if it reached the end
+const char *
+tempd_replay_error(const struct tempd_replay *replay)
+{
+    return(replay->error);
+}
@@ -0,0 +1,411 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Sensor state machine: sample decoding, fault tracking, alarm and fan
+ * hysteresis
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "config.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_probes.h"
+#include "tempd_sensor.h"
+#include "tempd_stats.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_sensor);
+
+// must match sensorstatus enum
+const char *sensor_status[] =
+{
+    "uninitialized",
+    "normal",
+    "min",
+    "max",
+    "low_critical",
+    "critical",
+    "fault",
+    "emergency"
+};
+
+// must match fanspeed enum
+const char *fan_speed[] = {
+    "normal",
+    "medium",
+    "fast",
+    "max"
+};
+
+// map sensorstatus enum to the equivalent string
+const char *
+sensor_status_to_string(enum sensorstatus status)
+{
+    if (status < sizeof(sensor_status)/sizeof(const char *)) {
+        return(sensor_status[status]);
+    } else {
+        return(sensor_status[SENSOR_STATUS_UNINITIALIZED]);
+    }
+}
+
+// map fanspeed enum to the equivalent string
+const char *
+sensor_speed_to_string(enum fanspeed speed)
+{
+    if (speed < sizeof(fan_speed)/sizeof(const char *)) {
+        return(fan_speed[speed]);
+    } else {
+        return(fan_speed[SENSOR_FAN_NORMAL]);
+    }
+}
+
+// decode the two-byte lm75 temperature register into milidegrees (C)
+// The register is a left-justified two's complement value: the first byte
+// is whole degrees, and the second byte's highest (resolution - 8) bits are
+// binary fractions of a degree
+int
+lm75_decode(const char *buf, int resolution)
+{
+    int16_t raw;
+    int fraction_bits = resolution - 8;
+
+    raw = (int16_t)(((unsigned char)buf[0] << 8) | (unsigned char)buf[1]);
+    raw >>= 16 - resolution;
+
+    // convert to milidegrees (C)
+    return(raw * MILI_DEGREES / (1 << fraction_bits));
+}
+
+// take the result of a sensor's batched read (--i2c-dev), copying its raw
+// register into buf: 0 or errno, or -1 if it wasn't read in a batch. A
+// result only holds for the pass it was read in, so it's dropped whether
+// or not it's used.
+int
+tempd_take_batch(struct locl_sensor *sensor, char buf[2])
+{
+    int rc = sensor->batch_status;
+
+    if (rc != -1) {
+        memcpy(buf, sensor->batch_raw, sizeof(sensor->batch_raw));
+        sensor->batch_status = -1;
+    }
+
+    return(rc);
+}
+
+// initialize a sensor's state. The caller fills in the device and bus.
+void
+tempd_init_sensor(struct locl_sensor *sensor, char *name,
+                  struct locl_subsystem *subsystem,
+                  const YamlSensor *yaml_sensor,
+                  const struct tempd_filter_config *filter, int trend_window)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->name = name;
+    sensor->subsystem = subsystem;
+    sensor->yaml_sensor = yaml_sensor;
+    sensor->yaml_device = NULL;
+    sensor->bus = NULL;
+    tempd_breaker_init(&sensor->breaker, SENSOR_BREAKER_TRIP);
+    sensor->min = 1000000;
+    sensor->max = -1000000;
+    sensor->temp = 0;
+    sensor->raw_temp = 0;
+    tempd_filter_init(&sensor->filter, filter);
+    sensor->status = SENSOR_STATUS_NORMAL;
+    sensor->fan_speed = SENSOR_FAN_NORMAL;
+    sensor->fan_demand = SENSOR_FAN_NORMAL;
+    tempd_trend_init(&sensor->trend, trend_window);
+    sensor->test_temp = -1;     // no test temperature override set
+    sensor->watchdog_slot = -1;
+    sensor->watchdog_count = 0;
+    sensor->lm75.resolution = LM75_MIN_RESOLUTION;
+    sensor->batch_status = -1;
+}
+
+// give a sensor the rolling statistics windows in config, in windows (an
+// array of config->n, owned by the caller)
+void
+tempd_init_windows(struct locl_sensor *sensor, struct tempd_window *windows,
+                   const struct tempd_window_config *config)
+{
+    int idx;
+
+    for (idx = 0; idx < config->n; idx++) {
+        tempd_window_init(&windows[idx], config->length[idx]);
+    }
+    sensor->windows = windows;
+    sensor->n_windows = config->n;
+}
+
+// add a sensor's (filtered) temperature, read at time when, to its windows
+void
+tempd_add_to_windows(struct locl_sensor *sensor, long long when)
+{
+    int idx;
+
+    for (idx = 0; idx < sensor->n_windows; idx++) {
+        tempd_window_add(&sensor->windows[idx], when, sensor->temp);
+    }
+}
+
+// apply the result of a raw sample to a sensor: track read faults, and
+// record the temperature if the read succeeded
+void
+tempd_apply_sample(struct locl_sensor *sensor, int rc, int temp, long long when)
+{
+    if (0 != rc) {
+        // if we've hit the retry limit, mark it as failed
+        if (sensor->fault_count > MAX_FAIL_RETRY) {
+            if (sensor->status != SENSOR_STATUS_FAILED) {
+                TEMPD_PROBE3(status, sensor->name, sensor->status,
+                             SENSOR_STATUS_FAILED);
+                tempd_stats_count(STATS_STATUS_CHANGES, 1);
+            }
+            sensor->status = SENSOR_STATUS_FAILED;
+        } else {
+            tempd_stats_count(STATS_RETRIES, 1);
+        }
+        // otherwise, don't change the temp or status, but increment the retry
+        // count
+        sensor->fault_count++;
+        return;
+    }
+
+    // if we succeeded in reading the temp, then clear the retry count
+    sensor->fault_count = 0;
+    sensor->sample_time = when;
+
+    if (sensor->status == SENSOR_STATUS_FAILED) {
+        // we need to kick this sensor back into a working state
+        TEMPD_PROBE3(status, sensor->name, SENSOR_STATUS_FAILED,
+                     SENSOR_STATUS_NORMAL);
+        sensor->status = SENSOR_STATUS_NORMAL;
+        tempd_stats_count(STATS_STATUS_CHANGES, 1);
+    }
+
+    sensor->raw_temp = temp;
+    sensor->temp = tempd_filter_apply(&sensor->filter, temp);
+    tempd_trend_add(&sensor->trend, when, sensor->temp);
+    tempd_add_to_windows(sensor, when);
+
+    VLOG_DBG("%s: %4.1fc (raw %4.1fc)", sensor->yaml_sensor->device,
+             ((float)sensor->temp)/MILI_DEGREES_FLOAT,
+             ((float)sensor->raw_temp)/MILI_DEGREES_FLOAT);
+}
+
+// get the threshold (milidegrees) of the next alarm level above the
+// sensor's current status. Returns false if there's no higher level.
+bool
+tempd_next_alarm(const struct locl_sensor *sensor, int *threshold,
+                 enum sensorstatus *level)
+{
+    const YamlAlarmThresholds *alarm = &sensor->yaml_sensor->alarm_thresholds;
+
+    switch (sensor->status) {
+    case SENSOR_STATUS_NORMAL:
+        *level = SENSOR_STATUS_MAX;
+        *threshold = alarm->max_on * MILI_DEGREES;
+        return(true);
+    case SENSOR_STATUS_MAX:
+        *level = SENSOR_STATUS_CRITICAL;
+        *threshold = alarm->critical_on * MILI_DEGREES;
+        return(true);
+    case SENSOR_STATUS_CRITICAL:
+        *level = SENSOR_STATUS_EMERGENCY;
+        *threshold = alarm->emergency_on * MILI_DEGREES;
+        return(true);
+    default:
+        return(false);
+    }
+}
+
+// get the threshold (milidegrees) of the next fan speed above the sensor's
+// current speed. Returns false if the fans are already at max.
+bool
+tempd_next_fan_threshold(const struct locl_sensor *sensor, int *threshold)
+{
+    const YamlFanThresholds *fan = &sensor->yaml_sensor->fan_thresholds;
+
+    switch (sensor->fan_speed) {
+    case SENSOR_FAN_NORMAL:
+        *threshold = fan->medium_on * MILI_DEGREES;
+        return(true);
+    case SENSOR_FAN_MEDIUM:
+        *threshold = fan->fast_on * MILI_DEGREES;
+        return(true);
+    case SENSOR_FAN_FAST:
+        *threshold = fan->max_on * MILI_DEGREES;
+        return(true);
+    default:
+        return(false);
+    }
+}
+// recalculate a sensor's alarm status and fan speed from its temperature.
+// The fan demand is raised one step early if the next fan threshold is
+// predicted within trend_lead seconds (0 to disable).
+void
+tempd_evaluate_sensor(struct locl_sensor *sensor, int trend_lead)
+{
+    const YamlSensor *yaml_sensor = sensor->yaml_sensor;
+    enum sensorstatus old_status = sensor->status;
+    enum fanspeed old_demand = sensor->fan_demand;
+    long long eta;
+    int threshold;
+
+    // decreasing alarms
+
+    if (SENSOR_STATUS_FAILED == sensor->status) {
+        // no temp to report, unable to read sensor
+        return;
+    }
+
+    // adjust min and max values
+    if (sensor->min > sensor->temp) {
+        sensor->min = sensor->temp;
+    }
+
+    if (sensor->max < sensor->temp) {
+        sensor->max = sensor->temp;
+    }
+
+    // note: the published status follows the filtered temperature, so a
+    // single noisy reading can't raise it. A raw reading over the emergency
+    // threshold is acted on by the emergency confirmation instead (see
+    // tempd_check_emergency), which samples the raw value again.
+
+    // decreasing alarms
+    if (SENSOR_STATUS_EMERGENCY == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.emergency_off) {
+        sensor->status = SENSOR_STATUS_CRITICAL;
+    }
+
+    if (SENSOR_STATUS_CRITICAL == sensor->status &&
+            (float)sensor->temp /MILI_DEGREES_FLOAT<= yaml_sensor->alarm_thresholds.critical_off) {
+        sensor->status = SENSOR_STATUS_MAX;
+    }
+
+    if (SENSOR_STATUS_MAX == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.max_off) {
+        sensor->status = SENSOR_STATUS_NORMAL;
+    }
+
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.low_crit) {
+        sensor->status = SENSOR_STATUS_MIN;
+    }
+
+    if (SENSOR_STATUS_MIN == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT > yaml_sensor->alarm_thresholds.min) {
+        sensor->status = SENSOR_STATUS_NORMAL;
+    }
+
+    // increasing alarms
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.max_on) {
+        sensor->status = SENSOR_STATUS_MAX;
+    }
+
+    if (SENSOR_STATUS_MAX == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.critical_on) {
+        sensor->status = SENSOR_STATUS_CRITICAL;
+    }
+
+    if (SENSOR_STATUS_CRITICAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->alarm_thresholds.emergency_on) {
+        sensor->status = SENSOR_STATUS_EMERGENCY;
+    }
+
+    if (SENSOR_STATUS_NORMAL == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.min) {
+        sensor->status = SENSOR_STATUS_MIN;
+    }
+
+    if (SENSOR_STATUS_MIN == sensor->status &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->alarm_thresholds.low_crit) {
+        sensor->status = SENSOR_STATUS_LOWCRIT;
+    }
+
+    // calculate requested fan speed
+    if (SENSOR_FAN_NORMAL == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.medium_on) {
+        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    }
+
+    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.fast_on) {
+        sensor->fan_speed = SENSOR_FAN_FAST;
+    }
+
+    if (SENSOR_FAN_FAST == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT >= yaml_sensor->fan_thresholds.max_on) {
+        sensor->fan_speed = SENSOR_FAN_MAX;
+    }
+
+    if (SENSOR_FAN_MAX == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.max_off) {
+        sensor->fan_speed = SENSOR_FAN_FAST;
+    }
+
+    if (SENSOR_FAN_FAST == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.fast_off) {
+        sensor->fan_speed = SENSOR_FAN_MEDIUM;
+    }
+
+    if (SENSOR_FAN_MEDIUM == sensor->fan_speed &&
+            (float)sensor->temp/MILI_DEGREES_FLOAT <= yaml_sensor->fan_thresholds.medium_off) {
+        sensor->fan_speed = SENSOR_FAN_NORMAL;
+    }
+
+    // ask for the next fan speed early if the temperature is predicted to
+    // reach its threshold within the lead time
+    sensor->fan_demand = sensor->fan_speed;
+    if (trend_lead > 0 && tempd_next_fan_threshold(sensor, &threshold) &&
+            tempd_trend_time_to(&sensor->trend, sensor->temp,
+                                threshold, &eta) &&
+            eta <= (long long)trend_lead * MSEC_PER_SEC) {
+        sensor->fan_demand = sensor->fan_speed + 1;
+    }
+
+    if (sensor->status != old_status) {
+        TEMPD_PROBE3(status, sensor->name, old_status, sensor->status);
+        tempd_stats_count(STATS_STATUS_CHANGES, 1);
+    }
+    if (sensor->fan_demand != old_demand) {
+        TEMPD_PROBE3(fan, sensor->name, old_demand, sensor->fan_demand);
+        tempd_stats_count(STATS_FAN_CHANGES, 1);
+    }
+}
+
+// mark a sensor stale if its last good reading is more than max_age
+// milliseconds old (or it has never had one). Returns true if that changed.
+bool
+tempd_check_stale(struct locl_sensor *sensor, long long now, long long max_age)
+{
+    bool stale = sensor->sample_time == 0 ||
+                 now - sensor->sample_time > max_age;
+
+    if (stale == sensor->stale) {
+        return(false);
+    }
+    sensor->stale = stale;
+
+    return(true);
+}
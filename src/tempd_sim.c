@@ -0,0 +1,606 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Simulated i2c sensor backend
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "hash.h"
+#include "ovs-atomic.h"
+#include "shash.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "tempd_sim.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_sim);
+
+#define SIM_MAX_ARGS    8
+
+enum sim_rule_type {
+    SIM_RULE_SUBSYSTEM,
+    SIM_RULE_ALARM,
+    SIM_RULE_FAN,
+    SIM_RULE_TEMP,
+    SIM_RULE_LATENCY,
+    SIM_RULE_ERROR,
+    SIM_RULE_HANG
+};
+
+// one scenario file rule
+struct sim_rule {
+    enum sim_rule_type type;
+    char *glob;
+    double args[SIM_MAX_ARGS];
+    bool flag;              // subsystem: shutdown allowed
+    // temp rule options (0 if not given)
+    int ramp_rate;
+    int ramp_limit;
+    long long step_at;      // milliseconds
+    int step_temp;
+    bool has_step;
+    int noise;
+};
+
+// simulated sensor. The YamlSensor is handed out to ops-tempd, and the
+// rest of the structure is found from it on each read.
+struct sim_sensor {
+    YamlSensor yaml;
+    char *device_name;
+    char *location;
+    int base;               // milidegrees
+    int ramp_rate;          // milidegrees per second
+    int ramp_limit;         // milidegrees
+    bool has_step;
+    long long step_at;      // milliseconds after start
+    int step_temp;          // milidegrees
+    int noise;              // milidegrees
+    int latency;            // microseconds per read
+    int error_pct;          // percent of reads that fail
+    long long hang_start;   // milliseconds after start
+    long long hang_end;
+    int hang_timeout;       // microseconds
+    uint32_t rng;           // per-sensor random state
+};
+
+struct sim_subsystem {
+    char *name;
+    bool emergency_shutdown;
+    int n_sensors;
+    struct sim_sensor *sensors;
+    YamlDevice device;      // one device (and bus) per subsystem
+};
+
+struct tempd_sim {
+    struct sim_rule *rules;
+    size_t n_rules;
+    uint32_t seed;
+    long long start;        // time_msec() when the scenario was loaded
+    struct shash subsystems;    // struct sim_subsystem
+
+    // counters (sensors are read from the watchdog thread too)
+    atomic_uint64_t n_reads;
+    atomic_uint64_t n_errors;
+    atomic_uint64_t n_hangs;
+    atomic_uint64_t n_shutdowns;
+};
+
+static void
+sim_count(atomic_uint64_t *counter)
+{
+    uint64_t orig;
+
+    atomic_add_relaxed(counter, 1, &orig);
+}
+
+static uint64_t
+sim_counter(const atomic_uint64_t *counter)
+{
+    uint64_t value;
+
+    atomic_read_relaxed(CONST_CAST(atomic_uint64_t *, counter), &value);
+    return(value);
+}
+
+// xorshift32: cheap, deterministic per sensor
+static uint32_t
+sim_random(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return(x);
+}
+
+// parse the numbers following the glob on a rule line
+static bool
+sim_parse_args(char **save, struct sim_rule *rule, int count)
+{
+    int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        char *token = strtok_r(NULL, " \t", save);
+        char *end;
+
+        if (token == NULL) {
+            return(false);
+        }
+        rule->args[idx] = strtod(token, &end);
+        if (*end != '\0') {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+// parse the options of a temp rule
+static bool
+sim_parse_temp_options(char **save, struct sim_rule *rule)
+{
+    char *token;
+
+    while ((token = strtok_r(NULL, " \t", save)) != NULL) {
+        char *arg1 = strtok_r(NULL, " \t", save);
+        char *arg2 = NULL;
+
+        if (arg1 == NULL) {
+            return(false);
+        }
+        if (strcmp(token, "ramp") == 0 || strcmp(token, "step") == 0) {
+            arg2 = strtok_r(NULL, " \t", save);
+            if (arg2 == NULL) {
+                return(false);
+            }
+        }
+
+        if (strcmp(token, "ramp") == 0) {
+            rule->ramp_rate = atoi(arg1);
+            rule->ramp_limit = atoi(arg2);
+        } else if (strcmp(token, "step") == 0) {
+            rule->has_step = true;
+            rule->step_at = atoll(arg1) * 1000;
+            rule->step_temp = atoi(arg2);
+        } else if (strcmp(token, "noise") == 0) {
+            rule->noise = abs(atoi(arg1));
+        } else {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+// parse one scenario line into a rule. Returns false on a syntax error.
+static bool
+sim_parse_line(struct tempd_sim *sim, char *line)
+{
+    struct sim_rule rule;
+    char *save = NULL;
+    char *keyword;
+    char *glob;
+    char *token;
+
+    keyword = strtok_r(line, " \t", &save);
+    if (keyword == NULL) {
+        return(true);
+    }
+
+    if (strcmp(keyword, "seed") == 0) {
+        token = strtok_r(NULL, " \t", &save);
+        if (token == NULL) {
+            return(false);
+        }
+        sim->seed = strtoul(token, NULL, 0);
+        return(true);
+    }
+
+    glob = strtok_r(NULL, " \t", &save);
+    if (glob == NULL) {
+        return(false);
+    }
+
+    memset(&rule, 0, sizeof(rule));
+    if (strcmp(keyword, "subsystem") == 0) {
+        rule.type = SIM_RULE_SUBSYSTEM;
+        if (!sim_parse_args(&save, &rule, 1) || rule.args[0] < 1) {
+            return(false);
+        }
+        token = strtok_r(NULL, " \t", &save);
+        if (token != NULL) {
+            if (strcmp(token, "shutdown") != 0) {
+                return(false);
+            }
+            rule.flag = true;
+        }
+    } else if (strcmp(keyword, "alarm") == 0) {
+        rule.type = SIM_RULE_ALARM;
+        if (!sim_parse_args(&save, &rule, 8)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "fan") == 0) {
+        rule.type = SIM_RULE_FAN;
+        if (!sim_parse_args(&save, &rule, 6)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "temp") == 0) {
+        rule.type = SIM_RULE_TEMP;
+        if (!sim_parse_args(&save, &rule, 1) ||
+                !sim_parse_temp_options(&save, &rule)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "latency") == 0) {
+        rule.type = SIM_RULE_LATENCY;
+        if (!sim_parse_args(&save, &rule, 1)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "error") == 0) {
+        rule.type = SIM_RULE_ERROR;
+        if (!sim_parse_args(&save, &rule, 1)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "hang") == 0) {
+        rule.type = SIM_RULE_HANG;
+        if (!sim_parse_args(&save, &rule, 3)) {
+            return(false);
+        }
+    } else {
+        return(false);
+    }
+
+    rule.glob = xstrdup(glob);
+    sim->rules = xrealloc(sim->rules, (sim->n_rules + 1) * sizeof(rule));
+    sim->rules[sim->n_rules++] = rule;
+    return(true);
+}
+
+// load a scenario file. On error, returns NULL and sets *errorp to a
+// malloc'd message.
+struct tempd_sim *
+tempd_sim_load(const char *file_name, char **errorp)
+{
+    struct tempd_sim *sim;
+    char line[512];
+    int line_number = 0;
+    FILE *stream;
+
+    stream = fopen(file_name, "r");
+    if (stream == NULL) {
+        *errorp = xasprintf("%s: open failed (%s)", file_name,
+                            ovs_strerror(errno));
+        return(NULL);
+    }
+
+    sim = xzalloc(sizeof(*sim));
+    sim->seed = 1;
+    shash_init(&sim->subsystems);
+    atomic_init(&sim->n_reads, 0);
+    atomic_init(&sim->n_errors, 0);
+    atomic_init(&sim->n_hangs, 0);
+    atomic_init(&sim->n_shutdowns, 0);
+
+    while (fgets(line, sizeof(line), stream) != NULL) {
+        char *comment = strchr(line, '#');
+
+        line_number++;
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (!sim_parse_line(sim, line)) {
+            *errorp = xasprintf("%s:%d: syntax error", file_name, line_number);
+            fclose(stream);
+            tempd_sim_destroy(sim);
+            return(NULL);
+        }
+    }
+    fclose(stream);
+
+    sim->start = time_msec();
+    VLOG_INFO("Loaded simulation scenario %s (%"PRIuSIZE" rules)",
+              file_name, sim->n_rules);
+    return(sim);
+}
+
+static void
+sim_free_subsystem(struct sim_subsystem *subsys)
+{
+    int idx;
+
+    for (idx = 0; idx < subsys->n_sensors; idx++) {
+        free(subsys->sensors[idx].device_name);
+        free(subsys->sensors[idx].location);
+    }
+    free(subsys->sensors);
+    free(subsys->device.name);
+    free(subsys->device.bus);
+    free(subsys->name);
+    free(subsys);
+}
+
+void
+tempd_sim_destroy(struct tempd_sim *sim)
+{
+    struct shash_node *node;
+    size_t idx;
+
+    if (sim == NULL) {
+        return;
+    }
+
+    SHASH_FOR_EACH(node, &sim->subsystems) {
+        sim_free_subsystem(node->data);
+    }
+    shash_destroy(&sim->subsystems);
+
+    for (idx = 0; idx < sim->n_rules; idx++) {
+        free(sim->rules[idx].glob);
+    }
+    free(sim->rules);
+    free(sim);
+}
+
+// find the last rule of a type matching name
+static const struct sim_rule *
+sim_find_rule(const struct tempd_sim *sim, enum sim_rule_type type,
+              const char *name)
+{
+    size_t idx;
+
+    for (idx = sim->n_rules; idx > 0; idx--) {
+        const struct sim_rule *rule = &sim->rules[idx - 1];
+
+        if (rule->type == type && fnmatch(rule->glob, name, 0) == 0) {
+            return(rule);
+        }
+    }
+    return(NULL);
+}
+
+// resolve the scenario rules for one sensor
+static void
+sim_init_sensor(const struct tempd_sim *sim, struct sim_subsystem *subsys,
+                struct sim_sensor *sensor, int number)
+{
+    const struct sim_rule *rule;
+    YamlAlarmThresholds *alarm = &sensor->yaml.alarm_thresholds;
+    YamlFanThresholds *fan = &sensor->yaml.fan_thresholds;
+    char *name = xasprintf("%s-%d", subsys->name, number);
+
+    sensor->device_name = xasprintf("sim%d", number);
+    sensor->location = xasprintf("Simulated sensor %d", number);
+    sensor->yaml.number = number;
+    sensor->yaml.location = sensor->location;
+    sensor->yaml.device = sensor->device_name;
+    sensor->yaml.type = "lm75";
+
+    rule = sim_find_rule(sim, SIM_RULE_ALARM, name);
+    alarm->emergency_on = rule ? rule->args[0] : 95;
+    alarm->emergency_off = rule ? rule->args[1] : 90;
+    alarm->critical_on = rule ? rule->args[2] : 85;
+    alarm->critical_off = rule ? rule->args[3] : 80;
+    alarm->max_on = rule ? rule->args[4] : 75;
+    alarm->max_off = rule ? rule->args[5] : 70;
+    alarm->min = rule ? rule->args[6] : 5;
+    alarm->low_crit = rule ? rule->args[7] : 0;
+
+    rule = sim_find_rule(sim, SIM_RULE_FAN, name);
+    fan->max_on = rule ? rule->args[0] : 70;
+    fan->max_off = rule ? rule->args[1] : 65;
+    fan->fast_on = rule ? rule->args[2] : 60;
+    fan->fast_off = rule ? rule->args[3] : 55;
+    fan->medium_on = rule ? rule->args[4] : 50;
+    fan->medium_off = rule ? rule->args[5] : 45;
+
+    rule = sim_find_rule(sim, SIM_RULE_TEMP, name);
+    sensor->base = rule ? (int)rule->args[0] : 30000;
+    if (rule != NULL) {
+        sensor->ramp_rate = rule->ramp_rate;
+        sensor->ramp_limit = rule->ramp_limit;
+        sensor->has_step = rule->has_step;
+        sensor->step_at = rule->step_at;
+        sensor->step_temp = rule->step_temp;
+        sensor->noise = rule->noise;
+    }
+
+    rule = sim_find_rule(sim, SIM_RULE_LATENCY, name);
+    sensor->latency = rule ? (int)rule->args[0] : 0;
+
+    rule = sim_find_rule(sim, SIM_RULE_ERROR, name);
+    sensor->error_pct = rule ? (int)rule->args[0] : 0;
+
+    rule = sim_find_rule(sim, SIM_RULE_HANG, name);
+    if (rule != NULL) {
+        sensor->hang_start = (long long)(rule->args[0] * 1000);
+        sensor->hang_end = sensor->hang_start + (long long)(rule->args[1] * 1000);
+        sensor->hang_timeout = (int)rule->args[2];
+    }
+
+    sensor->rng = hash_string(name, sim->seed) | 1;
+    free(name);
+}
+
+// create the simulated sensors for a subsystem. Returns the number of
+// sensors, or -1 if the scenario doesn't describe the subsystem.
+int
+tempd_sim_add_subsystem(struct tempd_sim *sim, const char *name,
+                        bool *emergency_shutdown)
+{
+    const struct sim_rule *rule;
+    struct sim_subsystem *subsys;
+    int idx;
+
+    subsys = shash_find_data(&sim->subsystems, name);
+    if (subsys == NULL) {
+        rule = sim_find_rule(sim, SIM_RULE_SUBSYSTEM, name);
+        if (rule == NULL) {
+            VLOG_ERR("No simulated sensors for subsystem %s", name);
+            return(-1);
+        }
+
+        subsys = xzalloc(sizeof(*subsys));
+        subsys->name = xstrdup(name);
+        subsys->emergency_shutdown = rule->flag;
+        subsys->n_sensors = (int)rule->args[0];
+        subsys->sensors = xcalloc(subsys->n_sensors, sizeof(*subsys->sensors));
+        subsys->device.name = xstrdup("sim");
+        subsys->device.bus = xasprintf("%s-sim", name);
+        for (idx = 0; idx < subsys->n_sensors; idx++) {
+            sim_init_sensor(sim, subsys, &subsys->sensors[idx], idx + 1);
+        }
+        shash_add(&sim->subsystems, name, subsys);
+    }
+
+    *emergency_shutdown = subsys->emergency_shutdown;
+    return(subsys->n_sensors);
+}
+
+void
+tempd_sim_remove_subsystem(struct tempd_sim *sim, const char *name)
+{
+    struct sim_subsystem *subsys = shash_find_and_delete(&sim->subsystems, name);
+
+    if (subsys != NULL) {
+        sim_free_subsystem(subsys);
+    }
+}
+
+const YamlSensor *
+tempd_sim_get_sensor(struct tempd_sim *sim, const char *name, int idx)
+{
+    struct sim_subsystem *subsys = shash_find_data(&sim->subsystems, name);
+
+    if (subsys == NULL || idx < 0 || idx >= subsys->n_sensors) {
+        return(NULL);
+    }
+    return(&subsys->sensors[idx].yaml);
+}
+
+const YamlDevice *
+tempd_sim_get_device(struct tempd_sim *sim, const char *name)
+{
+    struct sim_subsystem *subsys = shash_find_data(&sim->subsystems, name);
+
+    return(subsys ? &subsys->device : NULL);
+}
+
+// simulated temperature (milidegrees) at elapsed milliseconds
+static int
+sim_temperature(struct sim_sensor *sensor, long long elapsed)
+{
+    long long temp = sensor->base;
+
+    if (sensor->ramp_rate != 0) {
+        temp += (long long)sensor->ramp_rate * elapsed / 1000;
+        if ((sensor->ramp_rate > 0 && temp > sensor->ramp_limit) ||
+                (sensor->ramp_rate < 0 && temp < sensor->ramp_limit)) {
+            temp = sensor->ramp_limit;
+        }
+    }
+
+    if (sensor->has_step && elapsed >= sensor->step_at) {
+        temp = sensor->step_temp;
+    }
+
+    if (sensor->noise != 0) {
+        temp += (long long)(sim_random(&sensor->rng) % (2 * sensor->noise + 1))
+                - sensor->noise;
+    }
+
+    return((int)temp);
+}
+
+// read the (LM75 format) temperature register of a simulated sensor
+// returns 0 on success, like i2c_data_read
+int
+tempd_sim_read(struct tempd_sim *sim, const YamlSensor *yaml_sensor,
+               int len, void *buf_)
+{
+    struct sim_sensor *sensor = CONTAINER_OF(yaml_sensor, struct sim_sensor,
+                                             yaml);
+    long long elapsed = time_msec() - sim->start;
+    unsigned char *buf = buf_;
+    int reg;
+
+    sim_count(&sim->n_reads);
+
+    if (elapsed >= sensor->hang_start && elapsed < sensor->hang_end) {
+        sim_count(&sim->n_hangs);
+        usleep(sensor->hang_timeout);
+        return(ETIMEDOUT);
+    }
+
+    if (sensor->latency > 0) {
+        usleep(sensor->latency);
+    }
+
+    if (sensor->error_pct > 0 &&
+            (int)(sim_random(&sensor->rng) % 100) < sensor->error_pct) {
+        sim_count(&sim->n_errors);
+        return(EIO);
+    }
+
+    if (len < 2) {
+        return(EINVAL);
+    }
+
+    // 9-bit two's complement in the top bits of a 16-bit register, in
+    // half degree steps
+    reg = (sim_temperature(sensor, elapsed) / 500) * 128;
+    buf[0] = (reg >> 8) & 0xff;
+    buf[1] = reg & 0xff;
+
+    return(0);
+}
+
+// record a (simulated) emergency shutdown
+void
+tempd_sim_shutdown(struct tempd_sim *sim)
+{
+    sim_count(&sim->n_shutdowns);
+}
+
+void
+tempd_sim_dump(const struct tempd_sim *sim, struct ds *ds)
+{
+    ds_put_format(ds, "\nSimulation:\n");
+    ds_put_format(ds, "\tSubsystems: %"PRIuSIZE"\n",
+                  shash_count(&sim->subsystems));
+    ds_put_format(ds, "\tElapsed: %lld ms\n", time_msec() - sim->start);
+    ds_put_format(ds, "\tReads: %"PRIu64"\n", sim_counter(&sim->n_reads));
+    ds_put_format(ds, "\tInjected errors: %"PRIu64"\n",
+                  sim_counter(&sim->n_errors));
+    ds_put_format(ds, "\tHung reads: %"PRIu64"\n", sim_counter(&sim->n_hangs));
+    ds_put_format(ds, "\tEmergency shutdowns: %"PRIu64"\n",
+                  sim_counter(&sim->n_shutdowns));
+}
@@ -0,0 +1,373 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Pipeline counters and latency histograms
+ ***************************************************************************/
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "config.h"
+#include "dynamic-string.h"
+#include "ovs-atomic.h"
+#include "ovs-thread.h"
+#include "timeval.h"
+#include "util.h"
+#include "tempd_stats.h"
+
+// must match tempd_counter enum
+static const char *counter_names[] = {
+    "reads",
+    "faults",
+    "retries",
+    "status_changes",
+    "fan_changes",
+    "rows_written",
+    "rows_deleted",
+    "events_logged",
+    "events_coalesced",
+    "bus_lock_timeouts",
+    "i2c_transfers"
+};
+
+// must match tempd_histogram enum
+static const char *histogram_names[] = {
+    "read",
+    "pass",
+    "commit",
+    "reconfigure",
+    "bus_lock",
+    "batch_read"
+};
+
+struct stats_histogram {
+    atomic_uint64_t count;
+    atomic_uint64_t sum;                // microseconds
+    atomic_uint64_t buckets[STATS_N_BUCKETS];
+};
+
+// the statistics of one thread. Only that thread writes to it.
+struct stats_block {
+    struct stats_block *next;
+    atomic_uint64_t counters[STATS_N_COUNTERS];
+    struct stats_histogram histograms[STATS_N_HISTOGRAMS];
+};
+
+// a snapshot of the statistics of all threads
+struct stats_totals {
+    uint64_t counters[STATS_N_COUNTERS];
+    struct tempd_stats_histogram histograms[STATS_N_HISTOGRAMS];
+};
+
+// protects the block list and the reset snapshot. It's only taken when a
+// thread records its first statistic, and to report or reset.
+static struct ovs_mutex stats_mutex = OVS_MUTEX_INITIALIZER;
+static struct stats_block *blocks OVS_GUARDED_BY(stats_mutex);
+static struct stats_totals baseline OVS_GUARDED_BY(stats_mutex);
+static long long baseline_time OVS_GUARDED_BY(stats_mutex);
+
+DEFINE_STATIC_PER_THREAD_DATA(struct stats_block *, stats_thread_block, NULL);
+
+// get the calling thread's block, adding one if it doesn't have one yet.
+// Blocks are never freed, so the counts of a thread that has exited are
+// still reported.
+static struct stats_block *
+stats_get_block(void)
+{
+    struct stats_block **blockp = stats_thread_block_get();
+
+    if (*blockp == NULL) {
+        struct stats_block *block = xzalloc(sizeof(*block));
+
+        ovs_mutex_lock(&stats_mutex);
+        block->next = blocks;
+        blocks = block;
+        ovs_mutex_unlock(&stats_mutex);
+        *blockp = block;
+    }
+
+    return(*blockp);
+}
+
+// add to a value that only the calling thread writes
+static inline void
+stats_add(atomic_uint64_t *value, uint64_t n)
+{
+    uint64_t old;
+
+    atomic_read_relaxed(value, &old);
+    atomic_store_relaxed(value, old + n);
+}
+
+static uint64_t
+stats_read(atomic_uint64_t *value)
+{
+    uint64_t result;
+
+    atomic_read_relaxed(value, &result);
+    return(result);
+}
+
+void
+tempd_stats_count(enum tempd_counter counter, unsigned int n)
+{
+    stats_add(&stats_get_block()->counters[counter], n);
+}
+
+// get a start time for tempd_stats_record()
+long long
+tempd_stats_start(void)
+{
+    return(time_usec());
+}
+
+// record the time since start in a histogram
+void
+tempd_stats_record(enum tempd_histogram histogram, long long start)
+{
+    struct stats_histogram *hist = &stats_get_block()->histograms[histogram];
+    long long elapsed = time_usec() - start;
+    int bucket = 0;
+
+    if (elapsed > 0) {
+        bucket = MIN(log_2_floor(elapsed) + 1, STATS_N_BUCKETS - 1);
+    } else {
+        elapsed = 0;
+    }
+
+    stats_add(&hist->count, 1);
+    stats_add(&hist->sum, elapsed);
+    stats_add(&hist->buckets[bucket], 1);
+}
+
+// add up the blocks of all threads
+static void
+stats_collect(struct stats_totals *totals) OVS_REQUIRES(stats_mutex)
+{
+    struct stats_block *block;
+    int idx;
+    int bucket;
+
+    memset(totals, 0, sizeof(*totals));
+    for (block = blocks; block != NULL; block = block->next) {
+        for (idx = 0; idx < STATS_N_COUNTERS; idx++) {
+            totals->counters[idx] += stats_read(&block->counters[idx]);
+        }
+        for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+            struct stats_histogram *hist = &block->histograms[idx];
+
+            totals->histograms[idx].count += stats_read(&hist->count);
+            totals->histograms[idx].sum += stats_read(&hist->sum);
+            for (bucket = 0; bucket < STATS_N_BUCKETS; bucket++) {
+                totals->histograms[idx].buckets[bucket] +=
+                    stats_read(&hist->buckets[bucket]);
+            }
+        }
+    }
+}
+
+// start counting from zero again
+void
+tempd_stats_reset(void)
+{
+    ovs_mutex_lock(&stats_mutex);
+    stats_collect(&baseline);
+    baseline_time = time_msec();
+    ovs_mutex_unlock(&stats_mutex);
+}
+
+// get the totals since the last reset
+static long long
+stats_get(struct stats_totals *totals)
+{
+    long long since;
+    int idx;
+    int bucket;
+
+    ovs_mutex_lock(&stats_mutex);
+    stats_collect(totals);
+    for (idx = 0; idx < STATS_N_COUNTERS; idx++) {
+        totals->counters[idx] -= baseline.counters[idx];
+    }
+    for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+        totals->histograms[idx].count -= baseline.histograms[idx].count;
+        totals->histograms[idx].sum -= baseline.histograms[idx].sum;
+        for (bucket = 0; bucket < STATS_N_BUCKETS; bucket++) {
+            totals->histograms[idx].buckets[bucket] -=
+                baseline.histograms[idx].buckets[bucket];
+        }
+    }
+    since = baseline_time;
+    ovs_mutex_unlock(&stats_mutex);
+
+    return(since);
+}
+
+// upper limit (microseconds) of the bucket holding the given percentile.
+// The bucket counts are used as the total, since the count may have been
+// read at a slightly different moment.
+static uint64_t
+stats_percentile(const uint64_t *buckets, int percent)
+{
+    uint64_t total = 0;
+    uint64_t target;
+    uint64_t seen = 0;
+    int bucket;
+
+    for (bucket = 0; bucket < STATS_N_BUCKETS; bucket++) {
+        total += buckets[bucket];
+    }
+    if (total == 0) {
+        return(0);
+    }
+
+    target = (total * percent + 99) / 100;
+    for (bucket = 0; bucket < STATS_N_BUCKETS - 1; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    return(UINT64_C(1) << bucket);
+}
+
+static void
+stats_format_text(struct ds *ds, const struct stats_totals *totals,
+                  long long seconds)
+{
+    int idx;
+    int bucket;
+
+    ds_put_format(ds, "Statistics for the last %lld seconds\n", seconds);
+
+    ds_put_cstr(ds, "\nCounters:\n");
+    for (idx = 0; idx < STATS_N_COUNTERS; idx++) {
+        ds_put_format(ds, "  %-16s %12"PRIu64"\n", counter_names[idx],
+                      totals->counters[idx]);
+    }
+
+    ds_put_format(ds, "\nLatency (usec):   %12s %10s %10s %10s %10s\n",
+                  "count", "average", "p50 <=", "p90 <=", "p99 <=");
+    for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+        const uint64_t *buckets = totals->histograms[idx].buckets;
+        uint64_t count = totals->histograms[idx].count;
+
+        ds_put_format(ds, "  %-16s %12"PRIu64" %10"PRIu64" %10"PRIu64
+                      " %10"PRIu64" %10"PRIu64"\n", histogram_names[idx],
+                      count, count ? totals->histograms[idx].sum / count : 0,
+                      stats_percentile(buckets, 50),
+                      stats_percentile(buckets, 90),
+                      stats_percentile(buckets, 99));
+    }
+
+    // the non-empty buckets, by upper limit
+    for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+        const uint64_t *buckets = totals->histograms[idx].buckets;
+
+        if (totals->histograms[idx].count == 0) {
+            continue;
+        }
+        ds_put_format(ds, "\n%s buckets (usec):\n", histogram_names[idx]);
+        for (bucket = 0; bucket < STATS_N_BUCKETS; bucket++) {
+            if (buckets[bucket] == 0) {
+                continue;
+            }
+            if (bucket == STATS_N_BUCKETS - 1) {
+                ds_put_format(ds, "  >= %-10"PRIu64,
+                              UINT64_C(1) << (bucket - 1));
+            } else {
+                ds_put_format(ds, "  <  %-10"PRIu64, UINT64_C(1) << bucket);
+            }
+            ds_put_format(ds, " %12"PRIu64"\n", buckets[bucket]);
+        }
+    }
+}
+
+static void
+stats_format_json(struct ds *ds, const struct stats_totals *totals,
+                  long long seconds)
+{
+    int idx;
+    int bucket;
+
+    ds_put_format(ds, "{\"seconds\":%lld,\"counters\":{", seconds);
+    for (idx = 0; idx < STATS_N_COUNTERS; idx++) {
+        ds_put_format(ds, "%s\"%s\":%"PRIu64, idx ? "," : "",
+                      counter_names[idx], totals->counters[idx]);
+    }
+
+    ds_put_cstr(ds, "},\"latency_usec\":{");
+    for (idx = 0; idx < STATS_N_HISTOGRAMS; idx++) {
+        const uint64_t *buckets = totals->histograms[idx].buckets;
+
+        ds_put_format(ds, "%s\"%s\":{\"count\":%"PRIu64",\"sum\":%"PRIu64
+                      ",\"p50\":%"PRIu64",\"p90\":%"PRIu64",\"p99\":%"PRIu64
+                      ",\"buckets\":[", idx ? "," : "", histogram_names[idx],
+                      totals->histograms[idx].count,
+                      totals->histograms[idx].sum,
+                      stats_percentile(buckets, 50),
+                      stats_percentile(buckets, 90),
+                      stats_percentile(buckets, 99));
+        for (bucket = 0; bucket < STATS_N_BUCKETS; bucket++) {
+            ds_put_format(ds, "%s%"PRIu64, bucket ? "," : "",
+                          buckets[bucket]);
+        }
+        ds_put_cstr(ds, "]}");
+    }
+    ds_put_cstr(ds, "}}\n");
+}
+
+// get the totals of a histogram since startup. Unlike the report, this
+// ignores resets, so the counts only ever go up.
+void
+tempd_stats_get_histogram(enum tempd_histogram histogram,
+                          struct tempd_stats_histogram *result)
+{
+    struct stats_totals totals;
+
+    ovs_mutex_lock(&stats_mutex);
+    stats_collect(&totals);
+    ovs_mutex_unlock(&stats_mutex);
+
+    *result = totals.histograms[histogram];
+}
+
+const char *
+tempd_stats_histogram_name(enum tempd_histogram histogram)
+{
+    return(histogram_names[histogram]);
+}
+
+// report the statistics since the last reset, as text or as a single JSON
+// object. JSON bucket N is the count of times under 2^N microseconds (and
+// at least 2^(N-1), for N > 0).
+void
+tempd_stats_format(struct ds *ds, bool json)
+{
+    struct stats_totals totals;
+    long long seconds = (time_msec() - stats_get(&totals)) / 1000;
+
+    if (json) {
+        stats_format_json(ds, &totals, seconds);
+    } else {
+        stats_format_text(ds, &totals, seconds);
+    }
+}
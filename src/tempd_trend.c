@@ -0,0 +1,132 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Temperature trend estimation
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "tempd_trend.h"
+
+// times in the sums are kept relative to a base time, which is moved up
+// once readings get this far (milliseconds) from it. This keeps the sum of
+// squared times well inside 64 bits.
+#define TREND_REBASE_MS     (1LL << 22)
+
+#define MSEC_PER_MIN        60000
+
+void
+tempd_trend_init(struct tempd_trend *trend, int window)
+{
+    memset(trend, 0, sizeof(*trend));
+
+    if (window < TREND_MIN_WINDOW) {
+        window = TREND_MIN_WINDOW;
+    } else if (window > TREND_MAX_WINDOW) {
+        window = TREND_MAX_WINDOW;
+    }
+    trend->window = window;
+}
+
+// move the base time of the sums up by delta
+static void
+trend_rebase(struct tempd_trend *trend, long long delta)
+{
+    trend->sum_tt += trend->n * delta * delta - 2 * delta * trend->sum_t;
+    trend->sum_ty -= delta * trend->sum_y;
+    trend->sum_t -= trend->n * delta;
+    trend->base += delta;
+}
+
+// add a reading (time in milliseconds, temperature in milidegrees)
+void
+tempd_trend_add(struct tempd_trend *trend, long long when, int temp)
+{
+    long long t;
+
+    if (trend->n == 0) {
+        trend->base = when;
+    }
+
+    // drop the oldest reading once the window is full
+    if (trend->n == trend->window) {
+        t = trend->when[trend->next] - trend->base;
+        trend->sum_t -= t;
+        trend->sum_y -= trend->temp[trend->next];
+        trend->sum_tt -= t * t;
+        trend->sum_ty -= t * trend->temp[trend->next];
+        trend->n--;
+    }
+
+    if (when - trend->base >= TREND_REBASE_MS) {
+        // rebase on the oldest reading left in the window
+        int oldest = (trend->next - trend->n + trend->window) % trend->window;
+        trend_rebase(trend, (trend->n ? trend->when[oldest] : when) - trend->base);
+    }
+
+    t = when - trend->base;
+    trend->sum_t += t;
+    trend->sum_y += temp;
+    trend->sum_tt += t * t;
+    trend->sum_ty += t * temp;
+    trend->n++;
+
+    trend->when[trend->next] = when;
+    trend->temp[trend->next] = temp;
+    trend->next = (trend->next + 1) % trend->window;
+}
+
+// get the slope of the fit, in milidegrees per minute
+// returns false if there aren't enough readings spread over time
+bool
+tempd_trend_slope(const struct tempd_trend *trend, int *slope)
+{
+    long long num;
+    long long den;
+
+    if (trend->n < TREND_MIN_WINDOW) {
+        return(false);
+    }
+
+    num = trend->n * trend->sum_ty - trend->sum_t * trend->sum_y;
+    den = trend->n * trend->sum_tt - trend->sum_t * trend->sum_t;
+    if (den <= 0) {
+        return(false);
+    }
+
+    *slope = (int)((double)num * MSEC_PER_MIN / (double)den);
+    return(true);
+}
+
+// predict the time (milliseconds) until the temperature rises from temp to
+// threshold (both milidegrees). Returns false if it isn't rising towards it.
+bool
+tempd_trend_time_to(const struct tempd_trend *trend, int temp, int threshold,
+                    long long *msec)
+{
+    int slope;
+
+    if (temp >= threshold || !tempd_trend_slope(trend, &slope) || slope <= 0) {
+        return(false);
+    }
+
+    *msec = (long long)(threshold - temp) * MSEC_PER_MIN / slope;
+    return(true);
+}
@@ -0,0 +1,876 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Virtual sensors
+ ***************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "shash.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "config-yaml.h"
+#include "tempd.h"
+#include "tempd_sensor.h"
+#include "tempd_virtual.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_virtual);
+
+// thresholds (degrees) of a virtual sensor without alarm or fan rules
+#define VIRTUAL_NO_THRESHOLD    1000.0
+
+enum virtual_op {
+    VOP_LOAD,       // push an input's temperature, or NaN if it failed
+    VOP_CONST,      // push a constant
+    VOP_SCALE,      // multiply the top n values by a weight
+    VOP_MAX,        // replace the top n values by their largest,
+    VOP_MIN,        // smallest,
+    VOP_AVG,        // or mean (leaving out NaNs),
+    VOP_SUM,        // or their sum
+    VOP_DIFF        // replace the top two values by their difference
+};
+
+// parsed expression
+struct virtual_expr {
+    enum virtual_op op;
+    char *glob;                     // VOP_LOAD: sensor name or glob
+    double value;                   // VOP_CONST: value, VOP_SCALE: weight
+    struct virtual_expr **args;     // function arguments, or VOP_SCALE's one
+    size_t n_args;
+};
+
+// compiled instruction
+struct virtual_insn {
+    enum virtual_op op;
+    size_t n;                       // VOP_LOAD: input index, else operands
+    double value;                   // VOP_CONST, VOP_SCALE
+};
+
+// the virtual sensors reading a physical sensor
+struct virtual_users {
+    size_t n;
+    struct virtual_sensor *users[];
+};
+
+struct virtual_sensor {
+    char *name;
+    char *subsystem;
+    char *text;                     // expression, as given
+    YamlSensor yaml;                // thresholds; the device is the text
+    struct virtual_expr *expr;
+    struct locl_sensor *sensor;     // NULL while the subsystem is absent
+
+    // program, while bound
+    struct virtual_insn *program;
+    size_t n_insns;
+    struct locl_sensor **inputs;
+    size_t n_inputs;
+    size_t depth;                   // stack needed
+    bool valid;                     // program gives exactly one value
+    bool dirty;                     // an input changed since it was run
+};
+
+enum virtual_rule_type {
+    VIRTUAL_RULE_LOCATION,
+    VIRTUAL_RULE_ALARM,
+    VIRTUAL_RULE_FAN
+};
+
+struct virtual_rule {
+    enum virtual_rule_type type;
+    char *glob;
+    char *text;                     // location
+    double args[8];                 // thresholds
+};
+
+struct tempd_virtual {
+    struct virtual_sensor *sensors;
+    size_t n_sensors;
+    struct virtual_rule *rules;
+    size_t n_rules;
+    double *stack;                  // evaluation stack, for all programs
+    size_t stack_size;
+};
+
+static const char *const virtual_functions[] = {
+    [VOP_MAX] = "max",
+    [VOP_MIN] = "min",
+    [VOP_AVG] = "avg",
+    [VOP_SUM] = "sum",
+    [VOP_DIFF] = "diff",
+};
+
+static void
+virtual_expr_destroy(struct virtual_expr *expr)
+{
+    size_t idx;
+
+    if (expr == NULL) {
+        return;
+    }
+    for (idx = 0; idx < expr->n_args; idx++) {
+        virtual_expr_destroy(expr->args[idx]);
+    }
+    free(expr->args);
+    free(expr->glob);
+    free(expr);
+}
+
+static void
+virtual_skip_space(const char **p)
+{
+    while (isspace((unsigned char)**p)) {
+        (*p)++;
+    }
+}
+
+// get the word (name, glob or number) at *p, if any
+static char *
+virtual_parse_word(const char **p)
+{
+    size_t length;
+    char *word;
+
+    virtual_skip_space(p);
+    length = strcspn(*p, "(), \t");
+    if (length == 0) {
+        return(NULL);
+    }
+    word = xmemdup0(*p, length);
+    *p += length;
+    return(word);
+}
+
+// parse an expression at *p. Returns NULL on a syntax error.
+static struct virtual_expr *
+virtual_parse_expr(const char **p)
+{
+    struct virtual_expr *expr = xzalloc(sizeof(*expr));
+    char *word = virtual_parse_word(p);
+    char *end;
+    int op;
+
+    if (word == NULL) {
+        free(expr);
+        return(NULL);
+    }
+    virtual_skip_space(p);
+
+    expr->value = strtod(word, &end);
+    if (*end == '\0') {
+        free(word);
+        if (**p == '\0' || strchr("),", **p) != NULL) {
+            expr->op = VOP_CONST;
+            return(expr);
+        }
+
+        // a number followed by an expression is a weight
+        expr->op = VOP_SCALE;
+        expr->args = xmalloc(sizeof(*expr->args));
+        expr->args[0] = virtual_parse_expr(p);
+        expr->n_args = 1;
+        if (expr->args[0] == NULL) {
+            expr->n_args = 0;
+            virtual_expr_destroy(expr);
+            return(NULL);
+        }
+        return(expr);
+    }
+
+    if (**p != '(') {
+        expr->op = VOP_LOAD;
+        expr->glob = word;
+        return(expr);
+    }
+
+    for (op = VOP_MAX; op <= VOP_DIFF; op++) {
+        if (strcmp(word, virtual_functions[op]) == 0) {
+            break;
+        }
+    }
+    free(word);
+    if (op > VOP_DIFF) {
+        free(expr);
+        return(NULL);
+    }
+    expr->op = op;
+
+    // arguments
+    (*p)++;
+    for (;;) {
+        struct virtual_expr *arg = virtual_parse_expr(p);
+
+        if (arg == NULL) {
+            virtual_expr_destroy(expr);
+            return(NULL);
+        }
+        expr->args = xrealloc(expr->args,
+                              (expr->n_args + 1) * sizeof(*expr->args));
+        expr->args[expr->n_args++] = arg;
+
+        virtual_skip_space(p);
+        if (**p == ')') {
+            (*p)++;
+            break;
+        } else if (**p != ',') {
+            virtual_expr_destroy(expr);
+            return(NULL);
+        }
+        (*p)++;
+    }
+
+    if (op == VOP_DIFF && expr->n_args != 2) {
+        virtual_expr_destroy(expr);
+        return(NULL);
+    }
+    return(expr);
+}
+
+// parse the numbers following the glob on a rule line
+static bool
+virtual_parse_args(char **save, struct virtual_rule *rule, int count)
+{
+    int idx;
+
+    for (idx = 0; idx < count; idx++) {
+        char *token = strtok_r(NULL, " \t", save);
+        char *end;
+
+        if (token == NULL) {
+            return(false);
+        }
+        rule->args[idx] = strtod(token, &end);
+        if (*end != '\0') {
+            return(false);
+        }
+    }
+    return(strtok_r(NULL, " \t", save) == NULL);
+}
+
+// parse a virtual sensor definition
+static bool
+virtual_parse_sensor(struct tempd_virtual *virt, char **save)
+{
+    struct virtual_sensor vs;
+    char *subsystem = strtok_r(NULL, " \t", save);
+    char *name = strtok_r(NULL, " \t", save);
+    char *text = strtok_r(NULL, "", save);
+    const char *p = text;
+    size_t length;
+
+    if (subsystem == NULL || name == NULL || text == NULL) {
+        return(false);
+    }
+
+    memset(&vs, 0, sizeof(vs));
+    vs.expr = virtual_parse_expr(&p);
+    virtual_skip_space(&p);
+    if (vs.expr == NULL || *p != '\0') {
+        virtual_expr_destroy(vs.expr);
+        return(false);
+    }
+
+    vs.name = xstrdup(name);
+    vs.subsystem = xstrdup(subsystem);
+    vs.text = xstrdup(text + strspn(text, " \t"));
+    length = strlen(vs.text);
+    while (length > 0 && isspace((unsigned char)vs.text[length - 1])) {
+        vs.text[--length] = '\0';
+    }
+    virt->sensors = xrealloc(virt->sensors,
+                             (virt->n_sensors + 1) * sizeof(vs));
+    virt->sensors[virt->n_sensors++] = vs;
+    return(true);
+}
+
+// parse one line into a sensor or rule. Returns false on a syntax error.
+static bool
+virtual_parse_line(struct tempd_virtual *virt, char *line)
+{
+    struct virtual_rule rule;
+    char *save = NULL;
+    char *keyword;
+    char *glob;
+
+    keyword = strtok_r(line, " \t", &save);
+    if (keyword == NULL) {
+        return(true);
+    }
+
+    if (strcmp(keyword, "virtual") == 0) {
+        return(virtual_parse_sensor(virt, &save));
+    }
+
+    glob = strtok_r(NULL, " \t", &save);
+    if (glob == NULL) {
+        return(false);
+    }
+
+    memset(&rule, 0, sizeof(rule));
+    if (strcmp(keyword, "location") == 0) {
+        char *text = strtok_r(NULL, "", &save);
+
+        if (text == NULL) {
+            return(false);
+        }
+        rule.type = VIRTUAL_RULE_LOCATION;
+        rule.text = xstrdup(text + strspn(text, " \t"));
+    } else if (strcmp(keyword, "alarm") == 0) {
+        rule.type = VIRTUAL_RULE_ALARM;
+        if (!virtual_parse_args(&save, &rule, 8)) {
+            return(false);
+        }
+    } else if (strcmp(keyword, "fan") == 0) {
+        rule.type = VIRTUAL_RULE_FAN;
+        if (!virtual_parse_args(&save, &rule, 6)) {
+            return(false);
+        }
+    } else {
+        return(false);
+    }
+
+    rule.glob = xstrdup(glob);
+    virt->rules = xrealloc(virt->rules, (virt->n_rules + 1) * sizeof(rule));
+    virt->rules[virt->n_rules++] = rule;
+    return(true);
+}
+
+// find the last rule of a type matching name
+static const struct virtual_rule *
+virtual_find_rule(const struct tempd_virtual *virt,
+                  enum virtual_rule_type type, const char *name)
+{
+    size_t idx;
+
+    for (idx = virt->n_rules; idx > 0; idx--) {
+        const struct virtual_rule *rule = &virt->rules[idx - 1];
+
+        if (rule->type == type && fnmatch(rule->glob, name, 0) == 0) {
+            return(rule);
+        }
+    }
+    return(NULL);
+}
+
+// resolve the rules for one virtual sensor
+static void
+virtual_init_sensor(const struct tempd_virtual *virt,
+                    struct virtual_sensor *vs, int number)
+{
+    const struct virtual_rule *rule;
+    YamlAlarmThresholds *alarm = &vs->yaml.alarm_thresholds;
+    YamlFanThresholds *fan = &vs->yaml.fan_thresholds;
+    double high = VIRTUAL_NO_THRESHOLD;
+    double low = -VIRTUAL_NO_THRESHOLD;
+
+    rule = virtual_find_rule(virt, VIRTUAL_RULE_LOCATION, vs->name);
+    vs->yaml.number = number;
+    vs->yaml.location = rule ? rule->text : vs->name;
+    vs->yaml.device = vs->text;
+    vs->yaml.type = "virtual";
+
+    rule = virtual_find_rule(virt, VIRTUAL_RULE_ALARM, vs->name);
+    alarm->emergency_on = rule ? rule->args[0] : high;
+    alarm->emergency_off = rule ? rule->args[1] : high;
+    alarm->critical_on = rule ? rule->args[2] : high;
+    alarm->critical_off = rule ? rule->args[3] : high;
+    alarm->max_on = rule ? rule->args[4] : high;
+    alarm->max_off = rule ? rule->args[5] : high;
+    alarm->min = rule ? rule->args[6] : low;
+    alarm->low_crit = rule ? rule->args[7] : low;
+
+    rule = virtual_find_rule(virt, VIRTUAL_RULE_FAN, vs->name);
+    fan->max_on = rule ? rule->args[0] : high;
+    fan->max_off = rule ? rule->args[1] : high;
+    fan->fast_on = rule ? rule->args[2] : high;
+    fan->fast_off = rule ? rule->args[3] : high;
+    fan->medium_on = rule ? rule->args[4] : high;
+    fan->medium_off = rule ? rule->args[5] : high;
+}
+
+// load a virtual sensor definitions file. On error, returns NULL and sets
+// *errorp to a malloc'd message.
+struct tempd_virtual *
+tempd_virtual_load(const char *file_name, char **errorp)
+{
+    struct tempd_virtual *virt;
+    char line[1024];
+    int line_number = 0;
+    FILE *stream;
+    size_t idx;
+
+    stream = fopen(file_name, "r");
+    if (stream == NULL) {
+        *errorp = xasprintf("%s: open failed (%s)", file_name,
+                            ovs_strerror(errno));
+        return(NULL);
+    }
+
+    virt = xzalloc(sizeof(*virt));
+
+    while (fgets(line, sizeof(line), stream) != NULL) {
+        char *comment = strchr(line, '#');
+
+        line_number++;
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (!virtual_parse_line(virt, line)) {
+            *errorp = xasprintf("%s:%d: syntax error", file_name, line_number);
+            fclose(stream);
+            tempd_virtual_destroy(virt);
+            return(NULL);
+        }
+    }
+    fclose(stream);
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        virtual_init_sensor(virt, &virt->sensors[idx], (int)idx);
+    }
+
+    VLOG_INFO("Loaded %"PRIuSIZE" virtual sensors from %s", virt->n_sensors,
+              file_name);
+    return(virt);
+}
+
+static void
+virtual_unbind_sensor(struct virtual_sensor *vs)
+{
+    size_t idx;
+
+    for (idx = 0; idx < vs->n_inputs; idx++) {
+        free(vs->inputs[idx]->virtual_users);
+        vs->inputs[idx]->virtual_users = NULL;
+    }
+    free(vs->inputs);
+    free(vs->program);
+    vs->inputs = NULL;
+    vs->program = NULL;
+    vs->n_inputs = 0;
+    vs->n_insns = 0;
+    vs->depth = 0;
+    vs->valid = false;
+}
+
+void
+tempd_virtual_destroy(struct tempd_virtual *virt)
+{
+    size_t idx;
+
+    if (virt == NULL) {
+        return;
+    }
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        struct virtual_sensor *vs = &virt->sensors[idx];
+
+        virtual_unbind_sensor(vs);
+        if (vs->sensor != NULL) {
+            vs->sensor->virtual = NULL;
+        }
+        virtual_expr_destroy(vs->expr);
+        free(vs->name);
+        free(vs->subsystem);
+        free(vs->text);
+    }
+    free(virt->sensors);
+
+    for (idx = 0; idx < virt->n_rules; idx++) {
+        free(virt->rules[idx].glob);
+        free(virt->rules[idx].text);
+    }
+    free(virt->rules);
+    free(virt->stack);
+    free(virt);
+}
+
+// the number of virtual sensors in a subsystem
+int
+tempd_virtual_count(const struct tempd_virtual *virt, const char *subsystem)
+{
+    size_t idx;
+    int count = 0;
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        if (strcmp(virt->sensors[idx].subsystem, subsystem) == 0) {
+            count++;
+        }
+    }
+    return(count);
+}
+
+// get the idx'th virtual sensor of a subsystem, and its name
+const YamlSensor *
+tempd_virtual_get_sensor(const struct tempd_virtual *virt,
+                         const char *subsystem, int idx, const char **namep)
+{
+    size_t sensor_idx;
+
+    for (sensor_idx = 0; sensor_idx < virt->n_sensors; sensor_idx++) {
+        const struct virtual_sensor *vs = &virt->sensors[sensor_idx];
+
+        if (strcmp(vs->subsystem, subsystem) == 0 && idx-- == 0) {
+            *namep = vs->name;
+            return(&vs->yaml);
+        }
+    }
+    return(NULL);
+}
+
+// a sensor has been created for a virtual sensor (with the YamlSensor
+// given by tempd_virtual_get_sensor)
+void
+tempd_virtual_attach(struct tempd_virtual *virt OVS_UNUSED,
+                     const YamlSensor *yaml, struct locl_sensor *sensor)
+{
+    struct virtual_sensor *vs = CONTAINER_OF(yaml, struct virtual_sensor,
+                                             yaml);
+
+    vs->sensor = sensor;
+    sensor->virtual = vs;
+}
+
+// a virtual sensor's sensor is about to be freed. Its inputs must have
+// been unbound already.
+void
+tempd_virtual_detach(struct locl_sensor *sensor)
+{
+    sensor->virtual->sensor = NULL;
+    sensor->virtual = NULL;
+}
+
+struct virtual_compiler {
+    struct virtual_sensor *vs;
+    const struct shash *sensors;
+    size_t depth;
+    bool ok;
+};
+
+static void
+virtual_emit(struct virtual_compiler *c, enum virtual_op op, size_t n,
+             double value)
+{
+    struct virtual_sensor *vs = c->vs;
+
+    vs->program = xrealloc(vs->program,
+                           (vs->n_insns + 1) * sizeof(*vs->program));
+    vs->program[vs->n_insns].op = op;
+    vs->program[vs->n_insns].n = n;
+    vs->program[vs->n_insns].value = value;
+    vs->n_insns++;
+}
+
+static void
+virtual_push(struct virtual_compiler *c, size_t n)
+{
+    c->depth += n;
+    c->vs->depth = MAX(c->vs->depth, c->depth);
+}
+
+static void
+virtual_load(struct virtual_compiler *c, struct locl_sensor *input)
+{
+    struct virtual_sensor *vs = c->vs;
+
+    vs->inputs = xrealloc(vs->inputs, (vs->n_inputs + 1) * sizeof(input));
+    vs->inputs[vs->n_inputs] = input;
+    virtual_emit(c, VOP_LOAD, vs->n_inputs++, 0);
+    virtual_push(c, 1);
+}
+
+// compile an expression, returning the number of values it leaves on the
+// stack
+static size_t
+virtual_compile(struct virtual_compiler *c, const struct virtual_expr *expr)
+{
+    const struct shash_node *node;
+    struct locl_sensor *input;
+    size_t count = 0;
+    size_t idx;
+
+    switch (expr->op) {
+    case VOP_LOAD:
+        // only physical sensors can be read
+        if (strpbrk(expr->glob, "*?[") == NULL) {
+            input = shash_find_data(c->sensors, expr->glob);
+            if (input != NULL && input->virtual == NULL) {
+                virtual_load(c, input);
+                count++;
+            }
+        } else {
+            SHASH_FOR_EACH(node, c->sensors) {
+                input = node->data;
+                if (input->virtual == NULL &&
+                        fnmatch(expr->glob, node->name, 0) == 0) {
+                    virtual_load(c, input);
+                    count++;
+                }
+            }
+        }
+        return(count);
+
+    case VOP_CONST:
+        virtual_emit(c, VOP_CONST, 0, expr->value);
+        virtual_push(c, 1);
+        return(1);
+
+    case VOP_SCALE:
+        count = virtual_compile(c, expr->args[0]);
+        virtual_emit(c, VOP_SCALE, count, expr->value);
+        return(count);
+
+    case VOP_DIFF:
+        for (idx = 0; idx < expr->n_args; idx++) {
+            if (virtual_compile(c, expr->args[idx]) != 1) {
+                c->ok = false;
+            }
+        }
+        virtual_emit(c, VOP_DIFF, 2, 0);
+        if (c->ok) {
+            c->depth--;
+        }
+        return(1);
+
+    case VOP_MAX:
+    case VOP_MIN:
+    case VOP_AVG:
+    case VOP_SUM:
+        for (idx = 0; idx < expr->n_args; idx++) {
+            count += virtual_compile(c, expr->args[idx]);
+        }
+        virtual_emit(c, expr->op, count, 0);
+        // no arguments at all still gives a (NaN) result
+        c->depth -= count;
+        virtual_push(c, 1);
+        return(1);
+    }
+
+    OVS_NOT_REACHED();
+}
+
+static void
+virtual_add_user(struct locl_sensor *input, struct virtual_sensor *vs)
+{
+    struct virtual_users *users = input->virtual_users;
+    size_t n = users != NULL ? users->n : 0;
+
+    users = xrealloc(users, sizeof(*users) + (n + 1) * sizeof(vs));
+    users->users[n] = vs;
+    users->n = n + 1;
+    input->virtual_users = users;
+}
+
+// compile the programs of all present virtual sensors against the current
+// set of physical sensors
+void
+tempd_virtual_bind(struct tempd_virtual *virt, const struct shash *sensors)
+{
+    size_t depth = 0;
+    size_t idx;
+
+    tempd_virtual_unbind(virt);
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        struct virtual_sensor *vs = &virt->sensors[idx];
+        struct virtual_compiler c;
+        size_t input;
+
+        if (vs->sensor == NULL) {
+            continue;
+        }
+
+        c.vs = vs;
+        c.sensors = sensors;
+        c.depth = 0;
+        c.ok = true;
+        vs->valid = virtual_compile(&c, vs->expr) == 1 && c.ok;
+        if (!vs->valid) {
+            VLOG_INFO("Virtual sensor %s can't be evaluated: a sensor in "
+                      "\"%s\" is missing or matches more than one sensor",
+                      vs->name, vs->text);
+        }
+        depth = MAX(depth, vs->depth);
+
+        for (input = 0; input < vs->n_inputs; input++) {
+            virtual_add_user(vs->inputs[input], vs);
+        }
+        vs->dirty = true;
+    }
+
+    if (depth > virt->stack_size) {
+        virt->stack = xrealloc(virt->stack, depth * sizeof(*virt->stack));
+        virt->stack_size = depth;
+    }
+}
+
+// forget the sensors all programs read, before any of them are freed
+void
+tempd_virtual_unbind(struct tempd_virtual *virt)
+{
+    size_t idx;
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        virtual_unbind_sensor(&virt->sensors[idx]);
+    }
+}
+
+// a physical sensor's temperature or status changed
+void
+tempd_virtual_touch(const struct locl_sensor *sensor)
+{
+    size_t idx;
+
+    for (idx = 0; idx < sensor->virtual_users->n; idx++) {
+        sensor->virtual_users->users[idx]->dirty = true;
+    }
+}
+
+// reduce the top n values on the stack to one
+static double
+virtual_reduce(enum virtual_op op, const double *values, size_t n)
+{
+    double result = NAN;
+    size_t count = 0;
+    size_t idx;
+
+    if (op == VOP_SUM) {
+        result = n > 0 ? 0 : NAN;
+        for (idx = 0; idx < n; idx++) {
+            result += values[idx];
+        }
+        return(result);
+    }
+
+    // max, min and avg leave out failed sensors
+    for (idx = 0; idx < n; idx++) {
+        if (isnan(values[idx])) {
+            continue;
+        }
+        if (count++ == 0) {
+            result = values[idx];
+        } else if (op == VOP_MAX) {
+            result = MAX(result, values[idx]);
+        } else if (op == VOP_MIN) {
+            result = MIN(result, values[idx]);
+        } else {
+            result += values[idx];
+        }
+    }
+    if (op == VOP_AVG && count > 0) {
+        result /= count;
+    }
+    return(result);
+}
+
+static double
+virtual_evaluate(const struct virtual_sensor *vs, double *stack)
+{
+    const struct locl_sensor *input;
+    size_t sp = 0;
+    size_t idx;
+    size_t arg;
+
+    if (!vs->valid) {
+        return(NAN);
+    }
+
+    for (idx = 0; idx < vs->n_insns; idx++) {
+        const struct virtual_insn *insn = &vs->program[idx];
+
+        switch (insn->op) {
+        case VOP_LOAD:
+            input = vs->inputs[insn->n];
+            if (input->status == SENSOR_STATUS_FAILED ||
+                    input->status == SENSOR_STATUS_UNINITIALIZED) {
+                stack[sp++] = NAN;
+            } else {
+                stack[sp++] = input->temp;
+            }
+            break;
+
+        case VOP_CONST:
+            stack[sp++] = insn->value;
+            break;
+
+        case VOP_SCALE:
+            for (arg = sp - insn->n; arg < sp; arg++) {
+                stack[arg] *= insn->value;
+            }
+            break;
+
+        case VOP_DIFF:
+            stack[sp - 2] -= stack[sp - 1];
+            sp--;
+            break;
+
+        case VOP_MAX:
+        case VOP_MIN:
+        case VOP_AVG:
+        case VOP_SUM:
+            sp -= insn->n;
+            stack[sp] = virtual_reduce(insn->op, &stack[sp], insn->n);
+            sp++;
+            break;
+        }
+    }
+
+    return(stack[0]);
+}
+
+// evaluate the virtual sensors with changed inputs, and run their results
+// through the sensor state machine. Each sensor evaluated is passed to
+// evaluated().
+void
+tempd_virtual_run(struct tempd_virtual *virt, long long now, int trend_lead,
+                  void (*evaluated)(struct locl_sensor *))
+{
+    size_t idx;
+
+    for (idx = 0; idx < virt->n_sensors; idx++) {
+        struct virtual_sensor *vs = &virt->sensors[idx];
+        double value;
+        int rc;
+
+        if (vs->sensor == NULL || !vs->dirty) {
+            continue;
+        }
+
+        value = virtual_evaluate(vs, virt->stack);
+        rc = isnan(value) || fabs(value) > INT_MAX ? EIO : 0;
+        tempd_apply_sample(vs->sensor, rc, rc ? 0 : (int)lround(value), now);
+        tempd_evaluate_sensor(vs->sensor, trend_lead);
+        evaluated(vs->sensor);
+
+        // a failure is counted on every pass until the sensor is marked
+        // as failed, like a physical sensor that can't be read
+        vs->dirty = rc != 0 && vs->sensor->status != SENSOR_STATUS_FAILED;
+    }
+}
@@ -0,0 +1,305 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Emergency watchdog thread for the platform Temperature daemon
+ ***************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "compiler.h"
+#include "ovs-atomic.h"
+#include "ovs-thread.h"
+#include "timeval.h"
+#include "util.h"
+#include "openvswitch/vlog.h"
+#include "tempd_watchdog.h"
+
+VLOG_DEFINE_THIS_MODULE(tempd_watchdog);
+
+// one sensor owned by the watchdog thread
+// the sample fields are only written by the watchdog thread, and are
+// protected by a sequence lock: seq is odd while a write is in progress
+struct watchdog_slot {
+    void *sensor;               // NULL if the slot is free
+    bool busy;                  // the watchdog thread is using the sensor
+    atomic_uint32_t seq;
+    atomic_int rc;
+    atomic_int temp;
+    atomic_llong when;
+    atomic_uint32_t count;
+};
+
+// protects the slot table layout, the sensor pointers and busy flags in
+// it, and the watchdog's writes to the samples. It's only held for short
+// bookkeeping: the watchdog thread reads and checks a sensor (which may
+// take a whole emergency confirmation burst) without it, with the slot
+// marked busy.
+static struct ovs_mutex watchdog_mutex = OVS_MUTEX_INITIALIZER;
+
+// signalled when a slot stops being busy
+static pthread_cond_t watchdog_cond = PTHREAD_COND_INITIALIZER;
+
+// slot table. Only the main loop changes its size, so the main loop may
+// read samples from it without taking watchdog_mutex.
+static struct watchdog_slot *slots;
+static int n_slots;
+
+static struct tempd_watchdog_settings settings;
+static pthread_t watchdog_thread;
+static bool running = false;
+static atomic_bool exiting;
+
+// apply the requested scheduling policy and cpu affinity to this thread
+static void
+watchdog_set_scheduling(void)
+{
+    int error;
+
+    if (settings.priority > 0) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = settings.priority;
+        error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error) {
+            VLOG_WARN("Unable to set watchdog real-time priority %d (%s)",
+                      settings.priority, ovs_strerror(error));
+        }
+    }
+
+    if (settings.cpu >= 0) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(settings.cpu, &cpus);
+        error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (error) {
+            VLOG_WARN("Unable to pin watchdog to cpu %d (%s)",
+                      settings.cpu, ovs_strerror(error));
+        }
+    }
+}
+
+// publish a reading into a slot (watchdog thread only)
+static void
+watchdog_publish(struct watchdog_slot *slot, int rc, int temp, long long when)
+{
+    uint32_t seq;
+    uint32_t count;
+
+    atomic_read_relaxed(&slot->seq, &seq);
+    atomic_read_relaxed(&slot->count, &count);
+
+    atomic_store_relaxed(&slot->seq, seq + 1);
+    atomic_thread_fence(memory_order_release);
+
+    atomic_store_relaxed(&slot->rc, rc);
+    atomic_store_relaxed(&slot->temp, temp);
+    atomic_store_relaxed(&slot->when, when);
+    atomic_store_relaxed(&slot->count, count + 1);
+
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+static void *
+watchdog_main(void *aux OVS_UNUSED)
+{
+    watchdog_set_scheduling();
+
+    for (;;) {
+        long long start = time_msec();
+        long long elapsed;
+        bool stop;
+        int idx;
+
+        atomic_read_relaxed(&exiting, &stop);
+        if (stop) {
+            break;
+        }
+
+        // the table may grow (and move) while a sensor is being read, so
+        // slots are looked up again by index each time the lock is taken
+        for (idx = 0; ; idx++) {
+            void *sensor;
+            int temp = 0;
+            int rc;
+
+            ovs_mutex_lock(&watchdog_mutex);
+            if (idx >= n_slots) {
+                ovs_mutex_unlock(&watchdog_mutex);
+                break;
+            }
+            sensor = slots[idx].sensor;
+            slots[idx].busy = sensor != NULL;
+            ovs_mutex_unlock(&watchdog_mutex);
+
+            if (sensor == NULL) {
+                continue;
+            }
+
+            rc = settings.read(sensor, &temp);
+
+            ovs_mutex_lock(&watchdog_mutex);
+            watchdog_publish(&slots[idx], rc, temp, time_msec());
+            ovs_mutex_unlock(&watchdog_mutex);
+
+            if (rc == 0) {
+                settings.check(sensor, temp);
+            }
+
+            ovs_mutex_lock(&watchdog_mutex);
+            slots[idx].busy = false;
+            xpthread_cond_broadcast(&watchdog_cond);
+            ovs_mutex_unlock(&watchdog_mutex);
+        }
+
+        elapsed = time_msec() - start;
+        if (elapsed < settings.period) {
+            usleep((settings.period - elapsed) * 1000);
+        }
+    }
+
+    return(NULL);
+}
+
+// start the watchdog thread
+void
+tempd_watchdog_start(const struct tempd_watchdog_settings *new_settings)
+{
+    if (running) {
+        return;
+    }
+
+    settings = *new_settings;
+    atomic_init(&exiting, false);
+    watchdog_thread = ovs_thread_create("tempd_watchdog", watchdog_main, NULL);
+    running = true;
+
+    VLOG_INFO("Emergency watchdog started (period %d ms, priority %d, cpu %d)",
+              settings.period, settings.priority, settings.cpu);
+}
+
+// stop the watchdog thread and wait for it to exit
+void
+tempd_watchdog_stop(void)
+{
+    if (!running) {
+        return;
+    }
+
+    atomic_store_relaxed(&exiting, true);
+    xpthread_join(watchdog_thread, NULL);
+    running = false;
+}
+
+bool
+tempd_watchdog_is_running(void)
+{
+    return(running);
+}
+
+// hand a sensor over to the watchdog thread. Returns its slot number.
+int
+tempd_watchdog_add(void *sensor)
+{
+    struct watchdog_slot *slot;
+    int idx;
+
+    ovs_mutex_lock(&watchdog_mutex);
+
+    for (idx = 0; idx < n_slots; idx++) {
+        if (slots[idx].sensor == NULL) {
+            break;
+        }
+    }
+
+    if (idx == n_slots) {
+        n_slots = n_slots ? n_slots * 2 : 16;
+        slots = xrealloc(slots, n_slots * sizeof(*slots));
+        memset(&slots[idx], 0, (n_slots - idx) * sizeof(*slots));
+    }
+
+    slot = &slots[idx];
+    atomic_store_relaxed(&slot->count, 0);
+    slot->sensor = sensor;
+
+    ovs_mutex_unlock(&watchdog_mutex);
+
+    return(idx);
+}
+
+// take a sensor back from the watchdog thread. When this returns, the
+// watchdog thread is no longer using the sensor. This only waits if the
+// watchdog is in the middle of reading or checking this very sensor.
+void
+tempd_watchdog_remove(int idx)
+{
+    if (idx < 0 || idx >= n_slots) {
+        return;
+    }
+
+    ovs_mutex_lock(&watchdog_mutex);
+    slots[idx].sensor = NULL;
+    while (slots[idx].busy) {
+        ovs_mutex_cond_wait(&watchdog_cond, &watchdog_mutex);
+    }
+    ovs_mutex_unlock(&watchdog_mutex);
+}
+
+// get the latest reading for a sensor owned by the watchdog thread (main
+// loop only). Returns false if the watchdog hasn't read the sensor yet.
+bool
+tempd_watchdog_get(int idx, struct tempd_watchdog_sample *sample)
+{
+    struct watchdog_slot *slot;
+    uint32_t seq1;
+    uint32_t seq2;
+
+    if (idx < 0 || idx >= n_slots) {
+        return(false);
+    }
+
+    slot = &slots[idx];
+    for (;;) {
+        atomic_read_explicit(&slot->seq, &seq1, memory_order_acquire);
+        if (seq1 & 1) {
+            continue;
+        }
+
+        atomic_read_relaxed(&slot->rc, &sample->rc);
+        atomic_read_relaxed(&slot->temp, &sample->temp);
+        atomic_read_relaxed(&slot->when, &sample->when);
+        atomic_read_relaxed(&slot->count, &sample->count);
+
+        atomic_thread_fence(memory_order_acquire);
+        atomic_read_relaxed(&slot->seq, &seq2);
+        if (seq1 == seq2) {
+            break;
+        }
+    }
+
+    return(sample->count != 0);
+}
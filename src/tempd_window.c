@@ -0,0 +1,281 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * Rolling minimum, maximum and average over time windows
+ ***************************************************************************/
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "util.h"
+#include "tempd_window.h"
+
+#define MSEC_PER_SECOND 1000LL
+#define MSEC_PER_MINUTE (60 * MSEC_PER_SECOND)
+#define MSEC_PER_HOUR   (60 * MSEC_PER_MINUTE)
+#define MSEC_PER_DAY    (24 * MSEC_PER_HOUR)
+
+static void
+window_bucket_reset(struct window_bucket *bucket, long long start)
+{
+    bucket->start = start;
+    bucket->min = INT_MAX;
+    bucket->max = INT_MIN;
+    bucket->sum = 0;
+    bucket->count = 0;
+}
+
+void
+tempd_window_init(struct tempd_window *window, long long length)
+{
+    memset(window, 0, sizeof(*window));
+    window->length = length;
+    window->bucket_ms = MAX(DIV_ROUND_UP(length, WINDOW_BUCKETS), 1);
+    window_bucket_reset(&window->current, 0);
+}
+
+// move the current bucket into the ring, if anything went into it, and
+// onto the deques, behind the buckets that it doesn't dominate
+static void
+window_close(struct tempd_window *window)
+{
+    const struct window_bucket *bucket = &window->current;
+    int slot;
+
+    if (bucket->count == 0) {
+        return;
+    }
+
+    slot = (window->head + window->n) % WINDOW_BUCKETS;
+    window->ring[slot] = *bucket;
+    window->n++;
+    window->sum += bucket->sum;
+    window->count += bucket->count;
+
+    while (window->max_n > 0 &&
+           window->ring[window->max_q[(window->max_head + window->max_n - 1)
+                                      % WINDOW_BUCKETS]].max <= bucket->max) {
+        window->max_n--;
+    }
+    window->max_q[(window->max_head + window->max_n++) % WINDOW_BUCKETS] = slot;
+
+    while (window->min_n > 0 &&
+           window->ring[window->min_q[(window->min_head + window->min_n - 1)
+                                      % WINDOW_BUCKETS]].min >= bucket->min) {
+        window->min_n--;
+    }
+    window->min_q[(window->min_head + window->min_n++) % WINDOW_BUCKETS] = slot;
+}
+
+// drop the closed buckets that started a window length or more before the
+// current one. They're the oldest, so they're at the front of the ring, and
+// of the deques if they're in them.
+static void
+window_expire(struct tempd_window *window)
+{
+    long long limit = window->current.start - window->length;
+
+    while (window->n > 0 && window->ring[window->head].start <= limit) {
+        const struct window_bucket *bucket = &window->ring[window->head];
+
+        window->sum -= bucket->sum;
+        window->count -= bucket->count;
+        if (window->max_n > 0 && window->max_q[window->max_head] == window->head) {
+            window->max_head = (window->max_head + 1) % WINDOW_BUCKETS;
+            window->max_n--;
+        }
+        if (window->min_n > 0 && window->min_q[window->min_head] == window->head) {
+            window->min_head = (window->min_head + 1) % WINDOW_BUCKETS;
+            window->min_n--;
+        }
+        window->head = (window->head + 1) % WINDOW_BUCKETS;
+        window->n--;
+    }
+}
+
+// make the bucket that holds time when the current one
+static void
+window_advance(struct tempd_window *window, long long when)
+{
+    long long start = when - when % window->bucket_ms;
+
+    if (start <= window->current.start) {
+        return;
+    }
+
+    window_close(window);
+    window_bucket_reset(&window->current, start);
+    window_expire(window);
+}
+
+// add a reading taken at time when (msec, not earlier than the last one)
+void
+tempd_window_add(struct tempd_window *window, long long when, int temp)
+{
+    struct window_bucket *bucket = &window->current;
+
+    window_advance(window, when);
+    bucket->min = MIN(bucket->min, temp);
+    bucket->max = MAX(bucket->max, temp);
+    bucket->sum += temp;
+    bucket->count++;
+}
+
+// get the statistics of the readings in the window as of time now. Returns
+// false if there aren't any.
+bool
+tempd_window_get(struct tempd_window *window, long long now,
+                 struct tempd_window_stats *stats)
+{
+    const struct window_bucket *bucket = &window->current;
+    long long sum;
+
+    window_advance(window, now);
+
+    stats->count = window->count + bucket->count;
+    if (stats->count == 0) {
+        return(false);
+    }
+
+    stats->min = bucket->min;
+    stats->max = bucket->max;
+    if (window->min_n > 0) {
+        stats->min = MIN(stats->min,
+                         window->ring[window->min_q[window->min_head]].min);
+    }
+    if (window->max_n > 0) {
+        stats->max = MAX(stats->max,
+                         window->ring[window->max_q[window->max_head]].max);
+    }
+
+    sum = window->sum + bucket->sum;
+    stats->avg = (int)((sum + (sum < 0 ? -stats->count : stats->count) / 2)
+                       / stats->count);
+
+    return(true);
+}
+
+// get the buckets holding a window's readings, oldest first: the closed
+// buckets, then the current one if anything went into it (they're carried
+// over to a hot standby). Returns how many there are.
+int
+tempd_window_buckets(const struct tempd_window *window,
+                     struct window_bucket buckets[WINDOW_BUCKETS + 1])
+{
+    int n;
+
+    for (n = 0; n < window->n; n++) {
+        buckets[n] = window->ring[(window->head + n) % WINDOW_BUCKETS];
+    }
+    if (window->current.count > 0) {
+        buckets[n++] = window->current;
+    }
+
+    return(n);
+}
+
+// add the readings of a bucket from tempd_window_buckets() (no earlier
+// than those already added): they go in the bucket holding its start, so
+// they're placed exactly if the bucket came from a window of the same
+// length
+void
+tempd_window_add_bucket(struct tempd_window *window,
+                        const struct window_bucket *bucket)
+{
+    struct window_bucket *current = &window->current;
+
+    if (bucket->count == 0) {
+        return;
+    }
+
+    window_advance(window, bucket->start);
+    current->min = MIN(current->min, bucket->min);
+    current->max = MAX(current->max, bucket->max);
+    current->sum += bucket->sum;
+    current->count += bucket->count;
+}
+
+// parse a comma-separated list of window lengths, each a number followed
+// by s, m, h or d (seconds if there's no unit), or "none"
+bool
+tempd_window_parse(const char *spec, struct tempd_window_config *config)
+{
+    const char *p = spec;
+
+    config->n = 0;
+    if (strcmp(spec, "none") == 0) {
+        return(true);
+    }
+
+    for (;;) {
+        long long unit = MSEC_PER_SECOND;
+        char *end;
+        long value;
+
+        value = strtol(p, &end, 10);
+        if (end == p || value < 1 || config->n >= WINDOW_MAX) {
+            return(false);
+        }
+        switch (*end) {
+        case 's':
+            end++;
+            break;
+        case 'm':
+            unit = MSEC_PER_MINUTE;
+            end++;
+            break;
+        case 'h':
+            unit = MSEC_PER_HOUR;
+            end++;
+            break;
+        case 'd':
+            unit = MSEC_PER_DAY;
+            end++;
+            break;
+        }
+        if (value > 7 * MSEC_PER_DAY / unit) {
+            return(false);
+        }
+        config->length[config->n++] = value * unit;
+
+        if (*end == '\0') {
+            return(true);
+        } else if (*end != ',') {
+            return(false);
+        }
+        p = end + 1;
+    }
+}
+
+// format a window length in the largest unit that divides it ("5m", "24h")
+void
+tempd_window_label(long long length, char *buf, size_t size)
+{
+    if (length % MSEC_PER_HOUR == 0) {
+        snprintf(buf, size, "%lldh", length / MSEC_PER_HOUR);
+    } else if (length % MSEC_PER_MINUTE == 0) {
+        snprintf(buf, size, "%lldm", length / MSEC_PER_MINUTE);
+    } else {
+        snprintf(buf, size, "%llds", length / MSEC_PER_SECOND);
+    }
+}
@@ -0,0 +1,158 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * tempd-batch-test: test of batched read results against the bus breaker
+ *
+ * Sensors on one bus are read in a batch (--i2c-dev) before any of them
+ * is processed, and each then takes its result as lm75_read() does: the
+ * result first, then the breakers. Checks that when the bus breaker opens
+ * in the middle of a batch, the results of the sensors it turns down are
+ * dropped, so that the next pass reads the device instead of recording
+ * them as new (which would publish an old temperature, and fail the bus
+ * breaker's probe with an old error).
+ *
+ *     usage: tempd-batch-test
+ * Exits with status 1 if any check fails.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "util.h"
+#include "tempd_breaker.h"
+#include "tempd_sensor.h"
+
+#define N_SENSORS       (BREAKER_BUS_TRIP + 2)
+
+static int n_failed = 0;
+
+#define CHECK(COND)                                                     \
+    do {                                                                \
+        if (!(COND)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #COND);                         \
+            n_failed++;                                                 \
+        }                                                               \
+    } while (0)
+
+static struct locl_sensor sensors[N_SENSORS];
+static struct tempd_breaker bus_breaker;
+static int n_device_reads;
+
+// one sensor's read, in lm75_read()'s order: returns the result recorded,
+// or -1 if the bus breaker turned it down
+static int
+read_sensor(struct locl_sensor *sensor, long long now)
+{
+    char raw[2];
+    int rc = tempd_take_batch(sensor, raw);
+
+    if (!tempd_breaker_allow(&bus_breaker, now)) {
+        return(-1);
+    }
+    if (rc == -1) {
+        // not read in a batch: the device answers now
+        n_device_reads++;
+        rc = 0;
+    }
+    tempd_breaker_record(&bus_breaker, rc, now);
+
+    return(rc);
+}
+
+static void
+setup(void)
+{
+    struct tempd_filter_config filter = { FILTER_NONE, 0 };
+    int idx;
+
+    tempd_breaker_init(&bus_breaker, BREAKER_BUS_TRIP);
+    for (idx = 0; idx < N_SENSORS; idx++) {
+        tempd_init_sensor(&sensors[idx], "test", NULL, NULL, &filter, 0);
+    }
+    n_device_reads = 0;
+}
+
+static void
+test_take(void)
+{
+    char raw[2] = { 0, 0 };
+
+    setup();
+    CHECK(tempd_take_batch(&sensors[0], raw) == -1);
+
+    sensors[0].batch_status = 0;
+    sensors[0].batch_raw[0] = 0x19;
+    sensors[0].batch_raw[1] = 0x80;
+    CHECK(tempd_take_batch(&sensors[0], raw) == 0);
+    CHECK(raw[0] == 0x19 && (unsigned char)raw[1] == 0x80);
+    CHECK(sensors[0].batch_status == -1);
+    CHECK(tempd_take_batch(&sensors[0], raw) == -1);
+}
+
+static void
+test_breaker_opens_mid_batch(void)
+{
+    long long now = 1000;
+    int idx;
+
+    setup();
+
+    // the bus stops answering: every read in the batch fails
+    for (idx = 0; idx < N_SENSORS; idx++) {
+        sensors[idx].batch_status = EIO;
+    }
+    for (idx = 0; idx < N_SENSORS; idx++) {
+        int rc = read_sensor(&sensors[idx], now);
+
+        CHECK(rc == (idx < BREAKER_BUS_TRIP ? EIO : -1));
+    }
+    CHECK(bus_breaker.state == BREAKER_OPEN);
+
+    // nothing of the batch is left over for the sensors turned down
+    for (idx = 0; idx < N_SENSORS; idx++) {
+        CHECK(sensors[idx].batch_status == -1);
+    }
+
+    // the bus is back by the probe: the sensors turned down read the
+    // device, and the probe closes the breaker at its first backoff
+    now += bus_breaker.backoff;
+    CHECK(read_sensor(&sensors[BREAKER_BUS_TRIP], now) == 0);
+    CHECK(read_sensor(&sensors[BREAKER_BUS_TRIP + 1], now) == 0);
+    CHECK(n_device_reads == 2);
+    CHECK(bus_breaker.state == BREAKER_CLOSED);
+    CHECK(bus_breaker.backoff == BREAKER_MIN_BACKOFF_MS);
+}
+
+int
+main(void)
+{
+    test_take();
+    test_breaker_opens_mid_batch();
+
+    if (n_failed > 0) {
+        fprintf(stderr, "%d checks failed\n", n_failed);
+        return(1);
+    }
+    printf("all checks passed\n");
+    return(0);
+}
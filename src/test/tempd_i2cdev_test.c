@@ -0,0 +1,375 @@
+/*
+ * (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *    not use this file except in compliance with the License. You may obtain
+ *    a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ *    License for the specific language governing permissions and limitations
+ *    under the License.
+ */
+
+/************************************************************************//**
+ * @ingroup ops-tempd
+ *
+ * @file
+ * tempd-i2cdev-test: test of the i2c-dev backend against a fake adapter
+ *
+ * Runs tempd_i2cdev.c against an adapter faked in this process: ioctl is
+ * interposed, and answers the i2c-dev requests on a file descriptor for
+ * /dev/null as the kernel would for a bus of LM75-class devices. An
+ * I2C_RDWR transfer is carried out message by message, and stops at the
+ * first device that isn't there, as a real adapter's does. Checks that
+ * batches go in as few transfers as fit, that a failed batch is retried
+ * one read at a time and only the missing device's read fails, and the
+ * byte order of SMBus-only adapters.
+ *
+ *     usage: tempd-i2cdev-test
+ * Exits with status 1 if any check fails.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "config.h"
+#include "util.h"
+#include "tempd_i2cdev.h"
+
+// the fake bus: a device at each address from FAKE_FIRST_ADDRESS, whose
+// temperature register holds its address and a half degree, and whose
+// configuration register is 0
+#define FAKE_FIRST_ADDRESS  0x08
+#define FAKE_DEVICES        64
+#define FAKE_REGISTERS      2
+
+static struct {
+    bool smbus_only;            // no I2C_FUNC_I2C
+    int missing;                // address that doesn't acknowledge, or -1
+    int transfers;              // I2C_RDWR and I2C_SMBUS requests
+    int slave;                  // I2C_SLAVE address
+    uint8_t pointer[FAKE_DEVICES];
+    uint8_t regs[FAKE_DEVICES][FAKE_REGISTERS][2];
+} fake;
+
+static int n_failed = 0;
+
+#define CHECK(COND)                                                     \
+    do {                                                                \
+        if (!(COND)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #COND);                         \
+            n_failed++;                                                 \
+        }                                                               \
+    } while (0)
+
+static void
+fake_reset(bool smbus_only)
+{
+    int idx;
+
+    memset(&fake, 0, sizeof(fake));
+    fake.smbus_only = smbus_only;
+    fake.missing = -1;
+    for (idx = 0; idx < FAKE_DEVICES; idx++) {
+        fake.regs[idx][0][0] = FAKE_FIRST_ADDRESS + idx;
+        fake.regs[idx][0][1] = 0x80;
+    }
+}
+
+// the device at an address, or NULL if there's none (or it's missing)
+static uint8_t (*fake_device(int address))[2]
+{
+    int idx = address - FAKE_FIRST_ADDRESS;
+
+    if (idx < 0 || idx >= FAKE_DEVICES || address == fake.missing) {
+        return(NULL);
+    }
+
+    return(fake.regs[idx]);
+}
+
+// one I2C_RDWR message: a register pointer write (and data), or a read
+static int
+fake_message(const struct i2c_msg *msg)
+{
+    uint8_t (*regs)[2] = fake_device(msg->addr);
+    uint8_t *pointer;
+
+    if (regs == NULL) {
+        return(ENXIO);
+    }
+
+    pointer = &fake.pointer[msg->addr - FAKE_FIRST_ADDRESS];
+    if (msg->flags & I2C_M_RD) {
+        if (*pointer >= FAKE_REGISTERS || msg->len > 2) {
+            return(EIO);
+        }
+        memcpy(msg->buf, regs[*pointer], msg->len);
+    } else {
+        if (msg->len < 1 || msg->buf[0] >= FAKE_REGISTERS) {
+            return(EIO);
+        }
+        *pointer = msg->buf[0];
+        memcpy(regs[*pointer], msg->buf + 1, MIN(msg->len - 1, 2));
+    }
+
+    return(0);
+}
+
+static int
+fake_smbus(struct i2c_smbus_ioctl_data *args)
+{
+    uint8_t (*regs)[2] = fake_device(fake.slave);
+    uint8_t *reg;
+
+    if (regs == NULL) {
+        return(ENXIO);
+    }
+    if (args->command >= FAKE_REGISTERS) {
+        return(EIO);
+    }
+
+    // SMBus words are low byte first: the register's first byte
+    reg = regs[args->command];
+    if (args->read_write == I2C_SMBUS_READ) {
+        if (args->size == I2C_SMBUS_BYTE_DATA) {
+            args->data->byte = reg[0];
+        } else {
+            args->data->word = reg[0] | (reg[1] << 8);
+        }
+    } else if (args->size == I2C_SMBUS_BYTE_DATA) {
+        reg[0] = args->data->byte;
+    } else {
+        reg[0] = args->data->word & 0xff;
+        reg[1] = args->data->word >> 8;
+    }
+
+    return(0);
+}
+
+// i2c-dev's ioctls, on any file descriptor
+int
+ioctl(int fd OVS_UNUSED, unsigned long request, ...)
+{
+    va_list args;
+    void *arg;
+    int error = 0;
+
+    va_start(args, request);
+    arg = va_arg(args, void *);
+    va_end(args);
+
+    switch (request) {
+    case I2C_FUNCS:
+        *(unsigned long *)arg = fake.smbus_only
+            ? I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_WORD_DATA
+            : I2C_FUNC_I2C;
+        break;
+
+    case I2C_SLAVE:
+        fake.slave = (int)(uintptr_t)arg;
+        break;
+
+    case I2C_RDWR: {
+        struct i2c_rdwr_ioctl_data *data = arg;
+        uint32_t idx;
+
+        fake.transfers++;
+        if (fake.smbus_only || data->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS) {
+            error = EINVAL;
+            break;
+        }
+        for (idx = 0; idx < data->nmsgs && !error; idx++) {
+            error = fake_message(&data->msgs[idx]);
+        }
+        break;
+    }
+
+    case I2C_SMBUS:
+        fake.transfers++;
+        error = fake_smbus(arg);
+        break;
+
+    default:
+        error = ENOTTY;
+        break;
+    }
+
+    if (error) {
+        errno = error;
+        return(-1);
+    }
+
+    return(0);
+}
+
+// a batch reading the temperature of n devices from the first
+static void
+setup_batch(struct tempd_i2cdev_read *reads, char (*bufs)[2], size_t n)
+{
+    size_t idx;
+
+    memset(bufs, 0, n * sizeof(*bufs));
+    for (idx = 0; idx < n; idx++) {
+        reads[idx].address = FAKE_FIRST_ADDRESS + idx;
+        reads[idx].reg = 0;
+        reads[idx].length = 2;
+        reads[idx].buf = bufs[idx];
+        reads[idx].rc = -1;
+    }
+}
+
+// whether a batch read the right temperatures, and failed only where the
+// missing device is
+static bool
+batch_ok(const struct tempd_i2cdev_read *reads, size_t n)
+{
+    size_t idx;
+
+    for (idx = 0; idx < n; idx++) {
+        if (reads[idx].address == fake.missing) {
+            if (reads[idx].rc != ENXIO) {
+                return(false);
+            }
+        } else if (reads[idx].rc != 0 ||
+                   (uint8_t)reads[idx].buf[0] != reads[idx].address ||
+                   (uint8_t)reads[idx].buf[1] != 0x80) {
+            return(false);
+        }
+    }
+
+    return(true);
+}
+
+static void
+test_batch(void)
+{
+    struct tempd_i2cdev_read reads[FAKE_DEVICES];
+    char bufs[FAKE_DEVICES][2];
+    size_t per_transfer = I2C_RDWR_IOCTL_MAX_MSGS / 2;
+    struct tempd_i2cdev *dev;
+
+    fake_reset(false);
+    dev = tempd_i2cdev_open("/dev/null");
+    CHECK(dev != NULL);
+    if (dev == NULL) {
+        return;
+    }
+
+    // a batch goes in one transfer
+    setup_batch(reads, bufs, 3);
+    tempd_i2cdev_read_batch(dev, reads, 3);
+    CHECK(fake.transfers == 1);
+    CHECK(batch_ok(reads, 3));
+
+    // as many reads as fit in each transfer
+    fake.transfers = 0;
+    setup_batch(reads, bufs, per_transfer + 1);
+    tempd_i2cdev_read_batch(dev, reads, per_transfer + 1);
+    CHECK(fake.transfers == 2);
+    CHECK(batch_ok(reads, per_transfer + 1));
+
+    // a device that doesn't answer fails the batch, which is retried one
+    // read at a time: the reads after it succeed, only its own fails
+    fake.transfers = 0;
+    fake.missing = FAKE_FIRST_ADDRESS + 2;
+    setup_batch(reads, bufs, 5);
+    tempd_i2cdev_read_batch(dev, reads, 5);
+    CHECK(fake.transfers == 1 + 5);
+    CHECK(batch_ok(reads, 5));
+
+    // the retries are only made in the transfer that failed
+    fake.transfers = 0;
+    setup_batch(reads, bufs, per_transfer + 3);
+    tempd_i2cdev_read_batch(dev, reads, per_transfer + 3);
+    CHECK(fake.transfers == 1 + per_transfer + 1);
+    CHECK(batch_ok(reads, per_transfer + 3));
+
+    tempd_i2cdev_close(dev);
+}
+
+static void
+test_register(void)
+{
+    struct tempd_i2cdev *dev;
+    char config = 0x61;
+    char buf[2];
+
+    fake_reset(false);
+    dev = tempd_i2cdev_open("/dev/null");
+    CHECK(dev != NULL);
+    if (dev == NULL) {
+        return;
+    }
+
+    CHECK(tempd_i2cdev_write(dev, FAKE_FIRST_ADDRESS, 1, 1, &config) == 0);
+    CHECK(tempd_i2cdev_read(dev, FAKE_FIRST_ADDRESS, 1, 1, buf) == 0);
+    CHECK(buf[0] == 0x61);
+    fake.missing = FAKE_FIRST_ADDRESS;
+    CHECK(tempd_i2cdev_read(dev, FAKE_FIRST_ADDRESS, 0, 2, buf) == ENXIO);
+
+    tempd_i2cdev_close(dev);
+}
+
+static void
+test_smbus(void)
+{
+    struct tempd_i2cdev_read reads[4];
+    char bufs[4][2];
+    struct tempd_i2cdev *dev;
+    char config = 0x01;
+    char buf[1];
+
+    fake_reset(true);
+    dev = tempd_i2cdev_open("/dev/null");
+    CHECK(dev != NULL);
+    if (dev == NULL) {
+        return;
+    }
+
+    // one transfer per read, in the register's byte order
+    setup_batch(reads, bufs, 4);
+    tempd_i2cdev_read_batch(dev, reads, 4);
+    CHECK(fake.transfers == 4);
+    CHECK(batch_ok(reads, 4));
+
+    fake.transfers = 0;
+    fake.missing = FAKE_FIRST_ADDRESS + 1;
+    setup_batch(reads, bufs, 4);
+    tempd_i2cdev_read_batch(dev, reads, 4);
+    CHECK(fake.transfers == 4);
+    CHECK(batch_ok(reads, 4));
+
+    CHECK(tempd_i2cdev_write(dev, FAKE_FIRST_ADDRESS, 1, 1, &config) == 0);
+    CHECK(tempd_i2cdev_read(dev, FAKE_FIRST_ADDRESS, 1, 1, buf) == 0);
+    CHECK(buf[0] == 0x01);
+
+    tempd_i2cdev_close(dev);
+}
+
+int
+main(void)
+{
+    test_batch();
+    test_register();
+    test_smbus();
+
+    if (n_failed > 0) {
+        fprintf(stderr, "%d checks failed\n", n_failed);
+        return(1);
+    }
+    printf("all checks passed\n");
+    return(0);
+}
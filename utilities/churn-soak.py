@@ -0,0 +1,383 @@
+#!/usr/bin/env python3
+#
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+"""
+churn-soak.py - subsystem churn soak test for ops-tempd
+
+Usage: churn-soak.py --tempd=PATH --schema=FILE [options]
+
+Starts a private ovsdb-server with the OpenSwitch schema, and ops-tempd
+against it with simulated sensors (--sim), or with the h/w description files
+in --hw-desc-dir, then repeatedly adds and removes a set of Subsystem rows,
+as line cards coming and going would. Each cycle waits for ops-tempd to
+create the Temp_sensor rows of the new subsystems, then for it to drop the
+subsystems and delete their rows once they're removed, and records:
+
+  - the resident set size of ops-tempd,
+  - the arenas created and the heap in use (ops-tempd/memory json),
+  - the h/w descriptions config-yaml has loaded, which it never frees,
+  - Temp_sensor rows left behind by removed subsystems, and the rows
+    ops-tempd deleted itself (ops-tempd/stats json),
+  - reconfiguration latency (ops-tempd/stats json).
+
+If Temp_sensor isn't a root table in the schema, ovsdb-server deletes the
+rows of a removed subsystem itself, which would hide rows ops-tempd fails
+to delete; the test then runs against a copy of the schema in which
+Temp_sensor is a root table.
+
+The first --warmup cycles aren't measured. The test fails (exit status 1)
+if rows are orphaned, arenas leak, RSS or the heap keep growing beyond the
+limits, or the reconfiguration p99 goes over its limit. ovsdb-server,
+ovsdb-tool, ovsdb-client and ovs-appctl must be in PATH.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Subsystem churn soak test for ops-tempd")
+    parser.add_argument("--tempd", required=True,
+                        help="ops-tempd binary")
+    parser.add_argument("--schema",
+                        default="/usr/share/openvswitch/vswitch.ovsschema",
+                        help="OpenSwitch schema (default: %(default)s)")
+    parser.add_argument("--cycles", type=int, default=200,
+                        help="add/remove cycles (default: %(default)s)")
+    parser.add_argument("--warmup", type=int, default=20,
+                        help="cycles before measuring (default: %(default)s)")
+    parser.add_argument("--subsystems", type=int, default=8,
+                        help="subsystems added per cycle "
+                        "(default: %(default)s)")
+    parser.add_argument("--sensors", type=int, default=16,
+                        help="sensors per subsystem (default: %(default)s)")
+    parser.add_argument("--hw-desc-dir", metavar="DIR",
+                        help="h/w description files for the subsystems, "
+                        "parsed by config-yaml, instead of simulated "
+                        "sensors (--sensors is then ignored)")
+    parser.add_argument("--column", action="append", default=[],
+                        metavar="KEY=JSON",
+                        help="extra column for the Subsystem rows, if the "
+                        "schema needs one (may be repeated)")
+    parser.add_argument("--timeout", type=float, default=30.0,
+                        help="seconds to wait for ops-tempd each step "
+                        "(default: %(default)s)")
+    parser.add_argument("--max-rss-growth", type=int, default=512,
+                        help="KB of RSS growth allowed over the measured "
+                        "cycles (default: %(default)s)")
+    parser.add_argument("--max-heap-growth", type=int, default=128,
+                        help="KB of heap growth allowed over the measured "
+                        "cycles (default: %(default)s)")
+    parser.add_argument("--max-reconfigure-ms", type=float, default=100.0,
+                        help="reconfiguration p99 allowed, in ms "
+                        "(default: %(default)s)")
+    parser.add_argument("--keep", action="store_true",
+                        help="keep the working directory")
+    return parser.parse_args()
+
+
+# whether the server keeps Temp_sensor rows no other row refers to (if no
+# table is marked as a root table, they all are)
+def temp_sensor_is_root(schema):
+    tables = schema["tables"]
+    if not any(table.get("isRoot", False) for table in tables.values()):
+        return True
+    return tables["Temp_sensor"].get("isRoot", False)
+
+
+class Soak(object):
+    def __init__(self, args, workdir):
+        self.args = args
+        self.workdir = workdir
+        self.db_sock = os.path.join(workdir, "db.sock")
+        self.remote = "unix:" + self.db_sock
+        self.tempd_ctl = os.path.join(workdir, "ops-tempd.ctl")
+        self.procs = []
+        with open(args.schema) as schema:
+            schema = json.load(schema)
+        self.db_name = schema["name"]
+        self.schema_file = args.schema
+        if not temp_sensor_is_root(schema):
+            # ops-tempd has to delete the rows itself for the orphan check
+            # to mean anything
+            schema["tables"]["Temp_sensor"]["isRoot"] = True
+            self.schema_file = os.path.join(workdir, "soak.ovsschema")
+            with open(self.schema_file, "w") as copy:
+                json.dump(schema, copy)
+            print("Temp_sensor isn't a root table in {}: using a copy in "
+                  "which it is".format(args.schema))
+        self.extra_columns = {}
+        for column in args.column:
+            key, _, value = column.partition("=")
+            self.extra_columns[key] = json.loads(value)
+
+    def start(self):
+        db_file = os.path.join(self.workdir, "conf.db")
+        subprocess.check_call(["ovsdb-tool", "create", db_file,
+                               self.schema_file])
+        self.spawn("ovsdb-server", [
+            "ovsdb-server", db_file, "--remote=punix:" + self.db_sock,
+            "--unixctl=" + os.path.join(self.workdir, "ovsdb-server.ctl"),
+            "--no-chdir"])
+        self.wait_for(lambda: os.path.exists(self.db_sock),
+                      "ovsdb-server to start")
+
+        argv = [self.args.tempd, "--unixctl=" + self.tempd_ctl,
+                "--no-chdir", self.remote]
+        if self.args.hw_desc_dir is None:
+            sim_file = os.path.join(self.workdir, "soak.sim")
+            with open(sim_file, "w") as sim:
+                sim.write("seed 1\n")
+                sim.write("subsystem soak-* {}\n".format(self.args.sensors))
+                sim.write("temp soak-*-* 30000 noise 500\n")
+            argv.insert(1, "--sim=" + sim_file)
+        self.tempd = self.spawn("ops-tempd", argv)
+        self.wait_for(lambda: os.path.exists(self.tempd_ctl),
+                      "ops-tempd to start")
+
+    def spawn(self, name, argv):
+        log = open(os.path.join(self.workdir, name + ".log"), "w")
+        proc = subprocess.Popen(argv, stdout=log, stderr=subprocess.STDOUT)
+        self.procs.append(proc)
+        return proc
+
+    def stop(self):
+        for proc in reversed(self.procs):
+            if proc.poll() is None:
+                proc.terminate()
+                try:
+                    proc.wait(timeout=10)
+                except subprocess.TimeoutExpired:
+                    proc.kill()
+
+    def wait_for(self, condition, what):
+        deadline = time.time() + self.args.timeout
+        while not condition():
+            if self.tempd_exited():
+                raise RuntimeError("ops-tempd exited while waiting for " +
+                                   what)
+            if time.time() > deadline:
+                raise RuntimeError("timed out waiting for " + what)
+            time.sleep(0.05)
+
+    def tempd_exited(self):
+        return hasattr(self, "tempd") and self.tempd.poll() is not None
+
+    def transact(self, *ops):
+        output = subprocess.check_output(
+            ["ovsdb-client", "transact", self.remote,
+             json.dumps([self.db_name] + list(ops))])
+        result = json.loads(output.decode())
+        for reply in result:
+            if reply is not None and "error" in reply:
+                raise RuntimeError("transaction failed: " + json.dumps(reply))
+        return result
+
+    def appctl(self, *args):
+        output = subprocess.check_output(
+            ["ovs-appctl", "-t", self.tempd_ctl] + list(args))
+        return output.decode()
+
+    def appctl_json(self, *args):
+        return json.loads(self.appctl(*(list(args) + ["json"])))
+
+    def soak_rows(self):
+        reply = self.transact({"op": "select", "table": "Temp_sensor",
+                               "where": [], "columns": ["name"]})
+        return [row["name"] for row in reply[0]["rows"]
+                if row["name"].startswith("soak-")]
+
+    def rss_kb(self):
+        with open("/proc/{}/status".format(self.tempd.pid)) as status:
+            for line in status:
+                if line.startswith("VmRSS:"):
+                    return int(line.split()[1])
+        return 0
+
+    def add_subsystems(self):
+        ops = []
+        for idx in range(self.args.subsystems):
+            row = dict(self.extra_columns)
+            row["name"] = "soak-{}".format(idx)
+            if self.args.hw_desc_dir is not None:
+                row["hw_desc_dir"] = self.args.hw_desc_dir
+            ops.append({"op": "insert", "table": "Subsystem", "row": row})
+        self.transact(*ops)
+
+    def remove_subsystems(self):
+        ops = []
+        for idx in range(self.args.subsystems):
+            ops.append({"op": "delete", "table": "Subsystem",
+                        "where": [["name", "==", "soak-{}".format(idx)]]})
+        self.transact(*ops)
+
+    # the number of sensors the subsystems added have
+    def sensor_count(self):
+        if self.args.hw_desc_dir is None:
+            return self.args.subsystems * self.args.sensors
+
+        def added():
+            memory = self.appctl_json("ops-tempd/memory")
+            return memory["subsystems"] == self.args.subsystems
+        self.wait_for(added, "the subsystems to be added")
+        return self.appctl_json("ops-tempd/memory")["sensors"]
+
+    # one add/remove cycle: returns the arena allocations made for the
+    # subsystems while they were present, their rows, and the rows left
+    # behind
+    def cycle(self):
+        self.add_subsystems()
+        n_rows = self.sensor_count()
+        self.wait_for(lambda: len(self.soak_rows()) == n_rows,
+                      "the sensor rows to be created")
+        allocs = self.appctl_json("ops-tempd/memory")["arena_allocs"]
+
+        self.remove_subsystems()
+        self.wait_for(
+            lambda: self.appctl_json("ops-tempd/memory")["subsystems"] == 0,
+            "the subsystems to be removed")
+        try:
+            self.wait_for(lambda: not self.soak_rows(),
+                          "the sensor rows to be deleted")
+        except RuntimeError:
+            if self.tempd_exited():
+                raise
+        return allocs, n_rows, len(self.soak_rows())
+
+
+def main():
+    args = parse_args()
+    workdir = tempfile.mkdtemp(prefix="tempd-soak-")
+    soak = Soak(args, workdir)
+    failures = []
+    orphaned = 0
+    rows_measured = 0
+    allocs_min = None
+    allocs_max = 0
+
+    try:
+        soak.start()
+        for cycle in range(args.cycles):
+            if cycle == args.warmup:
+                soak.appctl("ops-tempd/stats", "reset")
+                base_memory = soak.appctl_json("ops-tempd/memory")
+                base_rss = soak.rss_kb()
+
+            allocs, n_rows, left = soak.cycle()
+            orphaned += left
+            if left:
+                print("cycle {}: {} orphaned Temp_sensor rows".format(
+                    cycle, left))
+            if cycle < args.warmup:
+                continue
+
+            rows_measured += n_rows
+            allocs_min = allocs if allocs_min is None else min(allocs_min,
+                                                               allocs)
+            allocs_max = max(allocs_max, allocs)
+            if (cycle - args.warmup) % 20 == 0:
+                memory = soak.appctl_json("ops-tempd/memory")
+                print("cycle {}: rss {} KB, heap {} KB, {} arenas "
+                      "created".format(cycle, soak.rss_kb(),
+                                       memory["heap_in_use"] // 1024,
+                                       memory["arenas_created"]))
+
+        memory = soak.appctl_json("ops-tempd/memory")
+        stats = soak.appctl_json("ops-tempd/stats")
+        rss = soak.rss_kb()
+    except (RuntimeError, subprocess.CalledProcessError) as error:
+        print("soak test aborted: {}".format(error))
+        soak.stop()
+        print("logs kept in " + workdir)
+        return 1
+
+    soak.stop()
+
+    measured = args.cycles - args.warmup
+    rss_growth = rss - base_rss
+    heap_growth = (memory["heap_in_use"] - base_memory["heap_in_use"]) // 1024
+    arenas_per_cycle = float(memory["arenas_created"] -
+                             base_memory["arenas_created"]) / measured
+    hw_desc_loaded = memory["hw_desc_loaded"] - base_memory["hw_desc_loaded"]
+    rows_deleted = stats["counters"]["rows_deleted"]
+    reconfigure = stats["histograms"]["reconfigure"]
+    p99_ms = reconfigure["p99"] / 1000.0
+
+    print("cycles measured:      {}".format(measured))
+    print("RSS growth:           {} KB".format(rss_growth))
+    print("heap growth:          {} KB".format(heap_growth))
+    print("arenas per cycle:     {:.1f} ({} live)".format(
+        arenas_per_cycle, memory["arenas_live"]))
+    print("arena allocations:    {} to {} per cycle".format(allocs_min,
+                                                          allocs_max))
+    print("orphaned rows:        {}".format(orphaned))
+    print("rows deleted:         {} of {}".format(rows_deleted,
+                                                  rows_measured))
+    if args.hw_desc_dir is None:
+        print("h/w descriptions:     none loaded (simulated sensors)")
+    else:
+        # config-yaml can't free a subsystem's: they count against the
+        # heap limit
+        print("h/w descriptions:     {} loaded, never freed".format(
+            hw_desc_loaded))
+    print("reconfigure:          {} runs, p50 <= {} us, p99 <= {} us".format(
+        reconfigure["count"], reconfigure["p50"], reconfigure["p99"]))
+
+    if orphaned:
+        failures.append("{} Temp_sensor rows orphaned".format(orphaned))
+    if rows_deleted != rows_measured:
+        failures.append("ops-tempd deleted {} Temp_sensor rows, expected "
+                        "{}".format(rows_deleted, rows_measured))
+    if memory["arenas_live"] != base_memory["arenas_live"]:
+        failures.append("{} arenas leaked".format(
+            memory["arenas_live"] - base_memory["arenas_live"]))
+    if allocs_max != allocs_min:
+        failures.append("arena allocations per cycle vary from {} to "
+                        "{}".format(allocs_min, allocs_max))
+    if arenas_per_cycle > args.subsystems:
+        failures.append("{:.1f} arenas created per cycle, expected {}".format(
+            arenas_per_cycle, args.subsystems))
+    if rss_growth > args.max_rss_growth:
+        failures.append("RSS grew by {} KB (limit {} KB)".format(
+            rss_growth, args.max_rss_growth))
+    if heap_growth > args.max_heap_growth:
+        failures.append("heap grew by {} KB (limit {} KB)".format(
+            heap_growth, args.max_heap_growth))
+    if p99_ms > args.max_reconfigure_ms:
+        failures.append("reconfigure p99 {:.1f} ms (limit {:.1f} ms)".format(
+            p99_ms, args.max_reconfigure_ms))
+
+    for failure in failures:
+        print("FAIL: " + failure)
+    if failures:
+        print("logs kept in " + workdir)
+        return 1
+
+    print("PASS")
+    if not args.keep:
+        shutil.rmtree(workdir)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())